@@ -23,6 +23,7 @@ typedef struct gen_renderer_s *gen_renderer;
 
 #define MAX_CHARS_IN_CLASS 22
 #define CODE_START_LEVEL 3
+#define SKIP_START_LEVEL 4
 
 struct gen_state_s {
         gen_class_list classes;
@@ -916,6 +917,167 @@ void render_map_values(gen_rule r, uint8_t *bytes, gen_renderer map, int first_m
         render(map, "}");
 }
 
+// Rows of state_map kept for the byte class layout
+static uint8_t map_rows[0x80][256];
+static int map_row_count = 0;
+
+void add_map_row(gen_rule r, uint8_t *bytes)
+{
+        memcpy(map_rows[r->id], bytes, 256);
+        if(r->id >= map_row_count)
+                map_row_count = r->id + 1;
+}
+
+int same_column(int a, int b)
+{
+        for(int i = 0 ; i < map_row_count ; i++)
+                if(map_rows[i][a] != map_rows[i][b])
+                        return 0;
+        return 1;
+}
+
+/*
+ * Bytes with the same column in every row of state_map are equivalent,
+ * renders byte_class[] mapping each byte to its equivalence class and
+ * state_class_map[][] with one column per class
+ */
+void render_byte_classes(gen_renderer classes)
+{
+        uint8_t byte_class[256];
+        int first_byte[256];
+        int class_count = 0;
+        for(int b = 0 ; b < 256 ; b++) {
+                int c = 0;
+                while(c < class_count && !same_column(first_byte[c], b))
+                        c++;
+                if(c == class_count)
+                        first_byte[class_count++] = b;
+                byte_class[b] = c;
+        }
+
+        char count[32];
+        snprintf(count, sizeof(count), "%d", class_count);
+        render_indent(classes, "#define BYTE_CLASS_COUNT ");
+        render(classes, count);
+        render(classes, "\n");
+        render_indent(classes, "uint8_t byte_class[256] = {");
+        render_level(classes, 1);
+        for(int b = 0 ; b < 256 ; b++) {
+                if(b % 16 == 0)
+                        render_indent(classes, "");
+                render_x(classes, byte_class[b]);
+                if(b < 255)
+                        render(classes, (b % 16 == 15) ? "," : ", ");
+        }
+        render_level(classes, -1);
+        render_indent(classes, "};\n");
+        render_indent(classes, "uint8_t state_class_map[][BYTE_CLASS_COUNT] = {");
+        render_level(classes, 1);
+        for(int i = 0 ; i < map_row_count ; i++) {
+                render_indent(classes, "{");
+                for(int c = 0 ; c < class_count ; c++) {
+                        if(c)
+                                render(classes, ", ");
+                        render_x(classes, map_rows[i][first_byte[c]]);
+                }
+                render(classes, (i < map_row_count - 1) ? "}," : "}");
+        }
+        render_level(classes, -1);
+        render_indent(classes, "};");
+}
+
+// Bytes skipped by skip_whitespace() in jsonpg_simd.c
+#define SKIP_WHITESPACE_CHARS "\t\n\r "
+
+int self_loops(gen_rule r, uint8_t *bytes, char *chars)
+{
+        int len = strlen(chars);
+        for(int i = 0 ; i < len ; i++)
+                if(bytes[(uint8_t)chars[i]] != r->id)
+                        return 0;
+        return 1;
+}
+
+// scan_string() in jsonpg_simd.c skips 0x20-0x7F apart from
+// a backslash and one quote byte, so the state must loop on all of those
+// Returns the quote byte or -1 if the state does not qualify
+int self_loop_quote(gen_rule r, uint8_t *bytes)
+{
+        int quote = -1;
+        for(int i = 0x20 ; i < 0x80 ; i++) {
+                if(bytes[i] == r->id || i == '\\')
+                        continue;
+                if(quote != -1)
+                        return -1;
+                quote = i;
+        }
+        // a state that loops on every byte can use any quote
+        return quote == -1 ? '\\' : quote;
+}
+
+void render_skip_case(gen_rule r, gen_renderer skips)
+{
+        render_indent(skips, "case state_");
+        render(skips, r->name);
+        render(skips, ":");
+        render_level(skips, 1);
+        render_indent(skips, "p->current = ");
+}
+
+void render_skip_break(gen_renderer skips)
+{
+        render_indent(skips, "break;");
+        render_level(skips, -1);
+}
+
+// States that string states go to on a UTF-8 leader byte,
+// skip_utf8() in jsonpg_state.skel.c skips the rest of a run of
+// valid multi byte sequences from there
+static uint8_t utf8_leader_states[0x80];
+
+void add_utf8_leader_states(gen_rule r, uint8_t *bytes)
+{
+        for(int i = 0xC2 ; i <= 0xF4 ; i++)
+                if(bytes[i] < 0x80 && bytes[i] != r->id)
+                        utf8_leader_states[bytes[i]] = 1;
+}
+
+void render_utf8_skips(gen_state states, gen_renderer skips)
+{
+        int any = 0;
+        for(gen_rule_list rl = states->rules ; rl ; rl = rl->next) {
+                gen_rule r = rl->rule;
+                if(r->id < 0 || !utf8_leader_states[r->id])
+                        continue;
+                render_indent(skips, "case state_");
+                render(skips, r->name);
+                render(skips, ":");
+                any = 1;
+        }
+        if(any) {
+                render_level(skips, 1);
+                render_indent(skips, "skip_utf8(p, last);");
+                render_skip_break(skips);
+        }
+}
+
+void render_skip(gen_rule r, uint8_t *bytes, gen_renderer skips)
+{
+        int quote = self_loop_quote(r, bytes);
+        if(quote != -1) {
+                render_skip_case(r, skips);
+                render(skips, "scan_string(p->current, last, ");
+                render_x(skips, quote);
+                render(skips, ");");
+                render_skip_break(skips);
+                add_utf8_leader_states(r, bytes);
+        } else if(self_loops(r, bytes, SKIP_WHITESPACE_CHARS)) {
+                render_skip_case(r, skips);
+                render(skips, "skip_whitespace(p->current, last);");
+                render_skip_break(skips);
+        }
+}
+
 int is_if_command(gen_builtin command)
 {
         return 0 == strncmp("if", command->name, 2);
@@ -987,11 +1149,9 @@ void render_builtin(int is_virtual, gen_builtin command, gen_renderer code)
                 render(code, ");");
                 break;
         case CMD_POP_STATE:
-                // if(is_virtual)
-                //         render_indent(code, "incr = 0;");
+                // The popped state always processes the current byte
                 render_indent(code, "new_state = pop_state();");
-                render_indent(code, "goto L");
-                render(code, is_virtual ? "noinc;" : "inc;");
+                render_indent(code, "goto Lnoinc;");
                 break;
         case CMD_IF_CONFIG:
                 render_if(0, "if_config(config_", args, ")", code);
@@ -1312,6 +1472,7 @@ void render_rule(
                 gen_renderer gotos,
                 gen_renderer code, 
                 gen_renderer cases,
+                gen_renderer skips,
                 int first)
 {
         if(r->id < 0)
@@ -1357,6 +1518,64 @@ void render_rule(
                 ml = ml->next;
         }
         render_map_values(r, rule_states, map, first);
+        add_map_row(r, rule_states);
+        render_skip(r, rule_states, skips);
+}
+
+/*
+ * jsonpg_parse_next variants, specialized on the config flags that
+ * gate the JSON5 extensions, the last checks p->flags at runtime and
+ * is used for any other combination
+ */
+static struct gen_variant_s {
+        char *name;
+        char *flags;
+} gen_variants[] = {
+        { "strict", "0" },
+        { "comments", "config_comments" },
+        { "relaxed", "config_all" },
+        { "any", "p->flags" }
+};
+
+#define VARIANT_COUNT (sizeof(gen_variants) / sizeof(gen_variants[0]))
+
+void render_variant(struct gen_variant_s *v, gen_renderer variant)
+{
+        if(v != gen_variants) {
+                render_indent(variant, "#undef parse_variant");
+                render_indent(variant, "#undef if_config");
+        }
+        render_indent(variant, "#define parse_variant           parse_next_");
+        render(variant, v->name);
+        render_indent(variant, "#define if_config(X)            (");
+        render(variant, v->flags);
+        render(variant, " & (X))");
+}
+
+void render_select(gen_renderer select)
+{
+        render_indent(select, "static parse_next_fn parse_next_select(uint16_t flags)");
+        render_indent(select, "{");
+        render_level(select, 1);
+        render_indent(select, "switch(flags & config_all) {");
+        for(int i = 0 ; i < VARIANT_COUNT ; i++) {
+                struct gen_variant_s *v = &gen_variants[i];
+                if(i < VARIANT_COUNT - 1) {
+                        render_indent(select, "case ");
+                        render(select, v->flags);
+                        render(select, ":");
+                } else {
+                        render_indent(select, "default:");
+                }
+                render_level(select, 1);
+                render_indent(select, "return parse_next_");
+                render(select, v->name);
+                render(select, ";");
+                render_level(select, -1);
+        }
+        render_indent(select, "}");
+        render_level(select, -1);
+        render_indent(select, "}");
 }
 
 gen_renderer renderer_new(int level)
@@ -1364,7 +1583,7 @@ gen_renderer renderer_new(int level)
         gen_renderer r = fmalloc(sizeof(struct gen_renderer_s));
         r->level = level;
         r->startlevel = level;
-        r->sbuf = str_buf_new(0);
+        r->sbuf = str_buf_new(0, allocator_select(NULL));
         return r;
 }
 
@@ -1399,13 +1618,23 @@ void render_state(gen_state states)
         gen_renderer cases = renderer_new(1);
         gen_renderer gotos = renderer_new(CODE_START_LEVEL);
         gen_renderer code = renderer_new(CODE_START_LEVEL);
+        gen_renderer skips = renderer_new(SKIP_START_LEVEL);
+        gen_renderer classes = renderer_new(0);
 
+        render_indent(skips, "switch(current_state) {");
         int first = 1;
         while(rl) {
-                render_rule(rl->rule, map, enums, enum_names, gotos, code, cases, first);
+                render_rule(rl->rule, map, enums, enum_names, gotos, code, cases, skips, first);
                 first = 0;
                 rl = rl->next;
         }
+        render_utf8_skips(states, skips);
+        render_indent(skips, "default:");
+        render_level(skips, 1);
+        render_indent(skips, "break;");
+        render_level(skips, -1);
+        render_indent(skips, "}");
+        render_byte_classes(classes);
 
         // drop last comma from cases
         cases->sbuf->count--;
@@ -1418,12 +1647,32 @@ void render_state(gen_state states)
         if(!cfile)
                 fail("Failed to create %s", OUTPUT_FILE);
 
+        merge_renderer(skelfile, cfile, classes, "<= classes");
         merge_renderer(skelfile, cfile, map, "<= map");
         merge_renderer(skelfile, cfile, enums, "<= enums");
         merge_renderer(skelfile, cfile, enum_names, "<= enum_names");
         merge_renderer(skelfile, cfile, cases, "<= cases");
-        merge_renderer(skelfile, cfile, gotos, "<= gotos");
-        merge_renderer(skelfile, cfile, code, "<= code");
+
+        // The parser is repeated for each variant
+        copy_until(skelfile, cfile, "<= variant");
+        long variant_start = ftell(skelfile);
+        for(int i = 0 ; i < VARIANT_COUNT ; i++) {
+                gen_renderer variant = renderer_new(0);
+                render_variant(&gen_variants[i], variant);
+                if(i > 0) {
+                        fseek(skelfile, variant_start, SEEK_SET);
+                        fprintf(cfile, "\n");
+                }
+                write_renderer(cfile, variant);
+                merge_renderer(skelfile, cfile, gotos, "<= gotos");
+                merge_renderer(skelfile, cfile, skips, "<= skips");
+                merge_renderer(skelfile, cfile, code, "<= code");
+                copy_until(skelfile, cfile, "<= end_variant");
+        }
+
+        gen_renderer select = renderer_new(0);
+        render_select(select);
+        merge_renderer(skelfile, cfile, select, "<= select");
         copy_until(skelfile, cfile, NULL);
 
         fclose(cfile);
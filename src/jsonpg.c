@@ -9,11 +9,22 @@
 #include "jsonpg_alloc.c"
 #include "jsonpg_strbuf.c"
 #include "jsonpg_utf8.c"
+#include "jsonpg_simd.c"
 #include "jsonpg_config.c"
 #include "jsonpg_stack.c"
 #include "jsonpg_generate.c"
 #include "jsonpg_print.c"
 #include "jsonpg_error.c"
+#include "jsonpg_pow5.c"
+#include "jsonpg_number.c"
+#include "jsonpg_ring.c"
 #include "jsonpg_parse.c"
+#include "jsonpg_index.c"
 #include "jsonpg_state.c"
+#include "jsonpg_skip.c"
+#include "jsonpg_project.c"
+#include "jsonpg_query.c"
 #include "jsonpg_dom.c"
+#include "jsonpg_lines.c"
+#include "jsonpg_parallel.c"
+#include "jsonpg_validate.c"
@@ -8,6 +8,14 @@
 #define JSONPG_STACK_SIZE 1024
 #endif
 
+#ifndef JSONPG_BUFFER_SIZE
+#define JSONPG_BUFFER_SIZE 4096
+#endif
+
+#ifndef JSONPG_PRINT_BUFFER_SIZE
+#define JSONPG_PRINT_BUFFER_SIZE 65536
+#endif
+
 #define JSONPG_FLAG_COMMENTS                   0x01
 #define JSONPG_FLAG_TRAILING_COMMAS            0x02
 #define JSONPG_FLAG_SINGLE_QUOTES              0x04
@@ -17,6 +25,10 @@
 #define JSONPG_FLAG_OPTIONAL_COMMAS            0x40
 #define JSONPG_FLAG_IS_OBJECT                  0x80
 #define JSONPG_FLAG_IS_ARRAY                   0x100
+#define JSONPG_FLAG_STRUCTURAL_INDEX           0x200
+#define JSONPG_FLAG_ADAPTIVE_BUFFER            0x400
+#define JSONPG_FLAG_MIRRORED_BUFFER            0x800
+#define JSONPG_FLAG_DOCUMENT_SEQUENCE          0x1000
 
 typedef enum {
         JSONPG_NONE,
@@ -33,7 +45,9 @@ typedef enum {
         JSONPG_BEGIN_OBJECT,
         JSONPG_END_OBJECT,
         JSONPG_ERROR,
-        JSONPG_EOF
+        JSONPG_EOF,
+        JSONPG_NEED_MORE,
+        JSONPG_END_DOCUMENT
 } jsonpg_type;
 
 typedef enum {
@@ -45,7 +59,8 @@ typedef enum {
         JSONPG_ERROR_UTF8,
         JSONPG_ERROR_STACKUNDERFLOW,
         JSONPG_ERROR_STACKOVERFLOW,
-        JSONPG_ERROR_FILE_READ
+        JSONPG_ERROR_FILE_READ,
+        JSONPG_ERROR_BUFFER_LIMIT
 } jsonpg_error_code;
 
 typedef struct {
@@ -69,9 +84,24 @@ typedef union {
         jsonpg_error_val error;
 } jsonpg_value;
 
+typedef struct {
+        jsonpg_type type;
+        jsonpg_value value;
+} jsonpg_event;
+
+// Memory for a parser, generator, DOM or buffer, ctx is passed to each
+typedef struct {
+        void *(*alloc)(void *ctx, size_t size);
+        void *(*realloc)(void *ctx, void *ptr, size_t size);
+        void (*free)(void *ctx, void *ptr);
+        void *ctx;
+} jsonpg_allocator;
+
 typedef struct {
         size_t stack_size;
+        size_t buffer_size;
         int16_t flags;
+        jsonpg_allocator *allocator;    // NULL for jsonpg_set_allocators()
 } jsonpg_config;
 
 typedef struct {
@@ -86,6 +116,8 @@ typedef struct {
         int (*begin_object)(void *ctx);
         int (*end_object)(void *ctx);
         int (*error)(void *ctx, jsonpg_error_code code, int at);
+        int (*end_document)(void *ctx);
+        int (*flush)(void *ctx);        // writes out what is held back
 } jsonpg_callbacks;
 
 typedef struct jsonpg_reader_s *jsonpg_reader;
@@ -93,12 +125,33 @@ typedef struct jsonpg_reader_s *jsonpg_reader;
 struct jsonpg_reader_s {
         ssize_t (*read)(jsonpg_reader, void *, size_t);
         void *ctx;
+        jsonpg_allocator *allocator;    // frees it, NULL for jsonpg_set_allocators()
 };
 
 typedef struct jsonpg_parser_s *jsonpg_parser;
+typedef struct jsonpg_projection_s *jsonpg_projection;
+typedef struct jsonpg_query_s *jsonpg_query;
 typedef struct jsonpg_generator_s *jsonpg_generator;
 typedef struct dom_hdr_s *jsonpg_dom;
 typedef struct str_buf_s *jsonpg_buffer;
+typedef struct jsonpg_arena_s *jsonpg_arena;
+
+typedef struct {
+        jsonpg_dom dom;
+        size_t at;
+} jsonpg_cursor;
+
+typedef struct {
+        int threads;            // 0 for one per online CPU
+        int ordered;            // report records in input order
+        jsonpg_config *config;  // for each worker's parser, NULL for default
+        // Returns the generator for a worker, NULL to only validate
+        jsonpg_generator (*generator)(void *ctx, int worker);
+        // Reports a record, returns non-zero to stop
+        int (*record)(void *ctx, int worker, size_t index,
+                        jsonpg_type type, jsonpg_value *result);
+        void *ctx;
+} jsonpg_lines_config;
 
 
 void jsonpg_set_allocators(
@@ -106,16 +159,29 @@ void jsonpg_set_allocators(
                 void *(*realloc)(void *, size_t),
                 void (*free)(void *));
 
+jsonpg_arena jsonpg_arena_new(size_t);
+jsonpg_allocator *jsonpg_arena_allocator(jsonpg_arena);
+void jsonpg_arena_reset(jsonpg_arena);
+void jsonpg_arena_free(void *);
+
 jsonpg_config jsonpg_config_get();
 void jsonpg_config_set(jsonpg_config *);
 
 jsonpg_parser jsonpg_parser_new(jsonpg_config *);
 void jsonpg_parser_free(void *);
 
+jsonpg_projection jsonpg_projection_new(char **, int);
+void jsonpg_projection_free(void *);
+int jsonpg_parser_project(jsonpg_parser, jsonpg_projection);
+
+jsonpg_query jsonpg_query_new(char *, size_t);
+void jsonpg_query_free(void *);
+int jsonpg_parser_query(jsonpg_parser, jsonpg_query);
+
 jsonpg_type jsonpg_parse(
                 jsonpg_parser, 
                 uint8_t *, 
-                uint32_t,
+                size_t,
                 jsonpg_generator);
 
 jsonpg_type jsonpg_parse_str(
@@ -128,6 +194,11 @@ jsonpg_type jsonpg_parse_fd(
                 int,
                 jsonpg_generator);
 
+jsonpg_type jsonpg_parse_file(
+                jsonpg_parser,
+                char *,
+                jsonpg_generator);
+
 jsonpg_type jsonpg_parse_stream(
                 jsonpg_parser,
                 FILE *,
@@ -138,23 +209,68 @@ jsonpg_type jsonpg_parse_reader(
                 jsonpg_reader,
                 jsonpg_generator);
 
+jsonpg_type jsonpg_parse_feed(
+                jsonpg_parser,
+                uint8_t *,
+                size_t,
+                jsonpg_generator);
+
 jsonpg_type jsonpg_parse_next(jsonpg_parser);
 
+jsonpg_type jsonpg_skip(jsonpg_parser);
+
 jsonpg_value jsonpg_result(jsonpg_parser);
 
+int jsonpg_parse_batch(jsonpg_parser, jsonpg_event *, int);
+
+int jsonpg_parse_lines(uint8_t *, size_t, jsonpg_lines_config *);
+
+jsonpg_type jsonpg_parse_parallel(
+                jsonpg_parser,
+                uint8_t *,
+                size_t,
+                int,
+                jsonpg_generator);
+
+jsonpg_type jsonpg_validate_parallel(
+                jsonpg_parser,
+                uint8_t *,
+                size_t,
+                int);
+
 jsonpg_dom jsonpg_dom_new();
+jsonpg_dom jsonpg_dom_new_with(jsonpg_allocator *);
+int jsonpg_dom_input(jsonpg_dom, uint8_t *, size_t);
+int jsonpg_dom_own_input(jsonpg_dom);
 jsonpg_generator jsonpg_dom_generator(jsonpg_dom);
 jsonpg_type jsonpg_dom_parse(jsonpg_dom, jsonpg_generator);
 void jsonpg_dom_free(void *);
 
+jsonpg_cursor jsonpg_dom_cursor(jsonpg_dom);
+jsonpg_type jsonpg_cursor_type(jsonpg_cursor *);
+jsonpg_value jsonpg_cursor_value(jsonpg_cursor *);
+size_t jsonpg_cursor_count(jsonpg_cursor *);
+jsonpg_type jsonpg_cursor_next(jsonpg_cursor *);
+jsonpg_type jsonpg_cursor_down(jsonpg_cursor *);
+jsonpg_type jsonpg_cursor_end(jsonpg_cursor *);
+
+jsonpg_cursor jsonpg_dom_get_key(jsonpg_cursor *, uint8_t *, size_t);
+jsonpg_cursor jsonpg_dom_get_index(jsonpg_cursor *, size_t);
+jsonpg_cursor jsonpg_dom_pointer(jsonpg_dom, char *);
+
 jsonpg_generator jsonpg_generator_new(jsonpg_callbacks *, size_t, uint16_t);
+jsonpg_generator jsonpg_generator_new_with(jsonpg_callbacks *, size_t, uint16_t,
+                jsonpg_allocator *);
+int jsonpg_generator_flush(jsonpg_generator);
 void jsonpg_generator_free(void *);
 
 jsonpg_generator jsonpg_file_printer(int, int, int);
+jsonpg_generator jsonpg_file_printer_sized(int, int, int, size_t);
 jsonpg_generator jsonpg_stream_printer(FILE *, int, int);
 jsonpg_generator jsonpg_buffer_printer(jsonpg_buffer, int, int);
 
 jsonpg_buffer jsonpg_buffer_new(uint32_t);
+jsonpg_buffer jsonpg_buffer_new_with(uint32_t, jsonpg_allocator *);
 char *jsonpg_buffer_string(jsonpg_buffer);
 void jsonpg_buffer_free(void *);
 
@@ -172,4 +288,5 @@ int jsonpg_begin_array(jsonpg_generator);
 int jsonpg_end_array(jsonpg_generator);
 int jsonpg_begin_object(jsonpg_generator);
 int jsonpg_end_object(jsonpg_generator);
+int jsonpg_end_document(jsonpg_generator);
 
@@ -1,15 +1,287 @@
 #include <stdlib.h>
+#include <string.h>
 
-static void *(*pg_alloc)(size_t) = malloc;
-static void *(*pg_realloc)(void *, size_t) = realloc;
-static void (*pg_dealloc)(void *) = free;
+/*
+ * Parsers, generators, DOMs and buffers allocate through a
+ * jsonpg_allocator, the default one calls the functions given to
+ * jsonpg_set_allocators()
+ *
+ * Each call publishes a new snapshot that is never changed, objects
+ * keep the one they were made with so they free with the functions
+ * they allocated with, and threads never see half of a change
+ *
+ * Snapshots are never freed as any object may still point to one,
+ * each is allocated with the C library and linked to the one before
+ * so they stay reachable, one per call to jsonpg_set_allocators()
+ */
+
+struct default_allocator_s {
+        jsonpg_allocator allocator;
+        void *(*alloc)(size_t);
+        void *(*realloc)(void *, size_t);
+        void (*free)(void *);
+        struct default_allocator_s *previous;   // kept for older objects
+};
+
+static void *default_alloc(void *ctx, size_t size)
+{
+        struct default_allocator_s *d = ctx;
+        return d->alloc(size);
+}
+
+static void *default_realloc(void *ctx, void *ptr, size_t size)
+{
+        struct default_allocator_s *d = ctx;
+        return d->realloc(ptr, size);
+}
+
+static void default_free(void *ctx, void *ptr)
+{
+        struct default_allocator_s *d = ctx;
+        d->free(ptr);
+}
+
+static struct default_allocator_s system_allocator = {
+        .allocator = {
+                .alloc = default_alloc,
+                .realloc = default_realloc,
+                .free = default_free,
+                .ctx = &system_allocator
+        },
+        .alloc = malloc,
+        .realloc = realloc,
+        .free = free,
+        .previous = NULL
+};
+
+static struct default_allocator_s *default_allocator = &system_allocator;
 
 void jsonpg_set_allocators(
-                void *(*malloc)(size_t),
-                void *(*realloc)(void *, size_t),
-                void (*free)(void *))
+                void *(*alloc_fn)(size_t),
+                void *(*realloc_fn)(void *, size_t),
+                void (*free_fn)(void *))
+{
+        struct default_allocator_s *d = malloc(sizeof(struct default_allocator_s));
+        if(!d)
+                return;
+        d->allocator = (jsonpg_allocator) {
+                .alloc = default_alloc,
+                .realloc = default_realloc,
+                .free = default_free,
+                .ctx = d
+        };
+        d->alloc = alloc_fn;
+        d->realloc = realloc_fn;
+        d->free = free_fn;
+        d->previous = __atomic_exchange_n(&default_allocator, d, __ATOMIC_ACQ_REL);
+}
+
+static jsonpg_allocator *allocator_select(jsonpg_allocator *chosen)
+{
+        return chosen
+                ? chosen
+                : &__atomic_load_n(&default_allocator, __ATOMIC_ACQUIRE)->allocator;
+}
+
+static void *al_alloc(jsonpg_allocator *a, size_t size)
+{
+        return a->alloc(a->ctx, size);
+}
+
+static void *al_realloc(jsonpg_allocator *a, void *ptr, size_t size)
+{
+        return a->realloc(a->ctx, ptr, size);
+}
+
+static void al_dealloc(jsonpg_allocator *a, void *ptr)
+{
+        if(ptr)
+                a->free(a->ctx, ptr);
+}
+
+/*
+ * jsonpg_arena
+ *   a bump allocator for everything one request allocates
+ *
+ *   allocations are carved in turn from blocks taken from the default
+ *   allocator of when the arena was made, each after a header with its
+ *   size, freeing or growing the latest one moves the end of the block,
+ *   growing any other copies it and freeing it does nothing
+ *
+ *   jsonpg_arena_reset() frees everything allocated at once by going
+ *   back to the start of the first block, the blocks are kept for the
+ *   next request, parsers, generators, DOMs and buffers allocated from
+ *   the arena must not be used or freed after it
+ *
+ *   an arena is not safe to share between threads
+ */
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+struct arena_block_s {
+        struct arena_block_s *next;
+        size_t size;
+        size_t used;
+        uint8_t *bytes;
+};
+
+struct jsonpg_arena_s {
+        jsonpg_allocator allocator;
+        jsonpg_allocator *blocks;       // allocating the arena and its blocks
+        struct arena_block_s *first;
+        struct arena_block_s *block;    // allocating from
+        size_t block_size;
+        uint8_t *latest;                // allocation that can grow in place
+};
+
+// Allocations start ARENA_ALIGN bytes after their size
+static size_t arena_size(void *ptr)
+{
+        return *(size_t *)((uint8_t *)ptr - ARENA_ALIGN);
+}
+
+static size_t arena_round(size_t size)
+{
+        return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static struct arena_block_s *arena_block_new(jsonpg_arena a, size_t size)
+{
+        struct arena_block_s *b = al_alloc(a->blocks, sizeof(struct arena_block_s)
+                        + size + ARENA_ALIGN);
+        if(!b)
+                return NULL;
+        b->next = NULL;
+        b->size = size;
+        b->used = 0;
+        b->bytes = (uint8_t *)arena_round((size_t)(b + 1));
+        return b;
+}
+
+// Moves to a block with room for size bytes, reusing those after it
+static int arena_next_block(jsonpg_arena a, size_t size)
+{
+        struct arena_block_s *b = a->block;
+        while(b->next && b->next->size < size)
+                b = b->next;
+        if(b->next) {
+                // Blocks skipped over stay where they are for later resets
+                a->block = b->next;
+                a->block->used = 0;
+                return 0;
+        }
+
+        struct arena_block_s *n = arena_block_new(a, (size > a->block_size)
+                        ? size
+                        : a->block_size);
+        if(!n)
+                return -1;
+        b->next = n;
+        a->block = n;
+        return 0;
+}
+
+static void *arena_alloc(void *ctx, size_t size)
+{
+        jsonpg_arena a = ctx;
+        size_t need = ARENA_ALIGN + arena_round(size);
+        if(a->block->size - a->block->used < need && arena_next_block(a, need))
+                return NULL;
+
+        uint8_t *header = a->block->bytes + a->block->used;
+        a->block->used += need;
+        *(size_t *)header = size;
+        a->latest = header + ARENA_ALIGN;
+        return a->latest;
+}
+
+static void *arena_realloc(void *ctx, void *ptr, size_t size)
+{
+        jsonpg_arena a = ctx;
+        if(!ptr)
+                return arena_alloc(ctx, size);
+
+        size_t old = arena_size(ptr);
+        if(ptr == a->latest) {
+                // Grows or shrinks in place when the block has room
+                size_t start = (uint8_t *)ptr - a->block->bytes;
+                size_t end = start + arena_round(size);
+                if(end <= a->block->size) {
+                        a->block->used = end;
+                        *(size_t *)((uint8_t *)ptr - ARENA_ALIGN) = size;
+                        return ptr;
+                }
+        }
+
+        uint8_t *moved = arena_alloc(ctx, size);
+        if(!moved)
+                return NULL;
+        memcpy(moved, ptr, (old < size) ? old : size);
+        return moved;
+}
+
+static void arena_free(void *ctx, void *ptr)
+{
+        jsonpg_arena a = ctx;
+        if(ptr && ptr == a->latest) {
+                a->block->used = (uint8_t *)ptr - ARENA_ALIGN - a->block->bytes;
+                a->latest = NULL;
+        }
+}
+
+/*
+ * Creates an arena taking blocks of block_size bytes, 0 for
+ * ARENA_BLOCK_SIZE, larger allocations get a block of their own
+ *
+ * Returns NULL on failing to allocate the first block
+ */
+jsonpg_arena jsonpg_arena_new(size_t block_size)
+{
+        jsonpg_allocator *blocks = allocator_select(NULL);
+        jsonpg_arena a = al_alloc(blocks, sizeof(struct jsonpg_arena_s));
+        if(!a)
+                return NULL;
+        a->blocks = blocks;
+        a->block_size = block_size ? block_size : ARENA_BLOCK_SIZE;
+        a->first = a->block = arena_block_new(a, a->block_size);
+        if(!a->first) {
+                al_dealloc(blocks, a);
+                return NULL;
+        }
+        a->latest = NULL;
+        a->allocator = (jsonpg_allocator) {
+                .alloc = arena_alloc,
+                .realloc = arena_realloc,
+                .free = arena_free,
+                .ctx = a
+        };
+        return a;
+}
+
+// The allocator to give parsers, generators, DOMs and buffers
+jsonpg_allocator *jsonpg_arena_allocator(jsonpg_arena a)
+{
+        return &a->allocator;
+}
+
+// Frees everything allocated from the arena
+void jsonpg_arena_reset(jsonpg_arena a)
+{
+        a->block = a->first;
+        a->block->used = 0;
+        a->latest = NULL;
+}
+
+void jsonpg_arena_free(void *ptr)
 {
-        pg_alloc = malloc;
-        pg_realloc = realloc;
-        pg_dealloc = free;
+        jsonpg_arena a = ptr;
+        if(a) {
+                while(a->first) {
+                        struct arena_block_s *next = a->first->next;
+                        al_dealloc(a->blocks, a->first);
+                        a->first = next;
+                }
+                al_dealloc(a->blocks, a);
+        }
 }
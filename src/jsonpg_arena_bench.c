@@ -0,0 +1,106 @@
+/*
+ * jsonpg_arena_bench.c
+ *   building a DOM per request with the default allocator and an arena
+ *
+ *   gcc -O2 -march=native -o jsonpg_arena_bench jsonpg_arena_bench.c
+ *
+ *   jsonpg_arena_bench <json file> [requests]
+ *      for each request makes a parser, a DOM and a buffer, parses the
+ *      file into the DOM and prints it into the buffer, then frees them
+ *      one by one or resets the arena they came from, reporting requests
+ *      a second for each
+ */
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "jsonpg.c"
+
+static double seconds()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Returns the length printed or 0 on an error
+static size_t request(uint8_t *json, size_t length, jsonpg_allocator *allocator)
+{
+        jsonpg_config c = jsonpg_config_get();
+        c.allocator = allocator;
+        jsonpg_parser p = jsonpg_parser_new(&c);
+        jsonpg_dom dom = jsonpg_dom_new_with(allocator);
+        jsonpg_generator g = jsonpg_dom_generator(dom);
+        jsonpg_buffer b = jsonpg_buffer_new_with(0, allocator);
+        jsonpg_generator printer = jsonpg_buffer_printer(b, 0, 0);
+
+        size_t printed = 0;
+        if(JSONPG_ERROR != jsonpg_parse(p, json, length, g)
+                        && JSONPG_ERROR != jsonpg_dom_parse(dom, printer))
+                printed = strlen(jsonpg_buffer_string(b));
+
+        // An arena frees them all at once
+        if(!allocator) {
+                jsonpg_generator_free(printer);
+                jsonpg_buffer_free(b);
+                jsonpg_generator_free(g);
+                jsonpg_dom_free(dom);
+                jsonpg_parser_free(p);
+        }
+        return printed;
+}
+
+static void report(char *name, uint8_t *json, size_t length, int requests,
+                jsonpg_arena arena)
+{
+        size_t printed = 0;
+        double start = seconds();
+        for(int i = 0 ; i < requests ; i++) {
+                printed = request(json, length,
+                                arena ? jsonpg_arena_allocator(arena) : NULL);
+                if(arena)
+                        jsonpg_arena_reset(arena);
+        }
+        double elapsed = seconds() - start;
+
+        printf("%-8s %10.0f requests/s %8.1f MB/s %10zu bytes printed\n",
+                        name, requests / elapsed,
+                        (double)length * requests / elapsed / 1e6, printed);
+}
+
+int main(int argc, char *argv[])
+{
+        if(argc < 2) {
+                printf("Usage: jsonpg_arena_bench <json file> [requests]\n");
+                exit(1);
+        }
+        int requests = (argc > 2) ? atoi(argv[2]) : 1000;
+
+        int fd = open(argv[1], O_RDONLY);
+        struct stat st;
+        if(fd == -1 || fstat(fd, &st) == -1 || st.st_size == 0) {
+                perror("Failed to open file");
+                exit(1);
+        }
+        uint8_t *json = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(json == MAP_FAILED) {
+                perror("Failed to map file");
+                exit(1);
+        }
+        close(fd);
+
+        jsonpg_arena arena = jsonpg_arena_new(0);
+        if(!arena) {
+                printf("Failed to create arena\n");
+                exit(1);
+        }
+
+        printf("%s: %zu bytes, %d requests\n", argv[1], (size_t)st.st_size, requests);
+        report("malloc", json, st.st_size, requests, NULL);
+        report("arena", json, st.st_size, requests, arena);
+
+        jsonpg_arena_free(arena);
+        munmap(json, st.st_size);
+}
@@ -0,0 +1,200 @@
+/*
+ * jsonpg_bench.c
+ *   parse throughput benchmarks
+ *
+ *   gcc -O2 -march=native -o jsonpg_bench jsonpg_bench.c
+ *
+ *   jsonpg_bench <json file> [times]
+ *      compares minified and pretty printed versions
+ *      of the same document with the table driven
+ *      and structural index engines and batched events
+ *
+ *   the table driven engine uses a state x byte transition table,
+ *   to compare with the state x byte class layout build again with
+ *
+ *   gcc -O2 -march=native -DJSONPG_BYTE_CLASSES -o jsonpg_bench jsonpg_bench.c
+ *
+ *   on Linux L1 data cache read misses per KB of input are reported
+ *   when the kernel exposes hardware counters (perf_event_paranoid)
+ */
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "jsonpg.c"
+
+#ifdef JSONPG_BYTE_CLASSES
+#define STATE_LAYOUT    "byte class"
+#define STATE_TABLES    (sizeof(byte_class) + sizeof(state_class_map))
+#else
+#define STATE_LAYOUT    "byte"
+#define STATE_TABLES    sizeof(state_map)
+#endif
+
+static double seconds()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static str_buf print_dom(jsonpg_dom dom, int pretty)
+{
+        str_buf sbuf = jsonpg_buffer_new(0);
+        if(!sbuf)
+                return NULL;
+        jsonpg_generator g = jsonpg_buffer_printer(sbuf, pretty, 0);
+        if(!g || JSONPG_EOF != jsonpg_dom_parse(dom, g)) {
+                jsonpg_buffer_free(sbuf);
+                sbuf = NULL;
+        }
+        jsonpg_generator_free(g);
+        return sbuf;
+}
+
+// Returns a counter of L1 data cache read misses or -1 if unavailable
+static int cache_misses_open()
+{
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_L1D
+                | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+        return -1;
+#endif
+}
+
+static long long cache_misses(int fd)
+{
+        long long count = 0;
+        if(fd == -1 || sizeof(count) != read(fd, &count, sizeof(count)))
+                return -1;
+        return count;
+}
+
+static int misses_fd = -1;
+static double misses_per_kb;
+
+// Returns MB/s pulling every event from the buffer, or -1 on error
+static double parse_rate(jsonpg_parser p, str_buf sbuf, int times)
+{
+        long long misses = cache_misses(misses_fd);
+        double start = seconds();
+        for(int i = 0 ; i < times ; i++) {
+                jsonpg_type t = jsonpg_parse(p, sbuf->bytes, sbuf->count, NULL);
+                while(t != JSONPG_EOF && t != JSONPG_ERROR)
+                        t = jsonpg_parse_next(p);
+                if(t == JSONPG_ERROR)
+                        return -1;
+        }
+        double elapsed = seconds() - start;
+        if(misses != -1)
+                misses_per_kb = (cache_misses(misses_fd) - misses)
+                        / ((double)sbuf->count * times / 1024);
+        return (double)sbuf->count * times / elapsed / 1e6;
+}
+
+// Returns MB/s pulling events a batch at a time, or -1 on error
+static double parse_batch_rate(jsonpg_parser p, str_buf sbuf, int times)
+{
+        static jsonpg_event events[256];
+        long long misses = cache_misses(misses_fd);
+        double start = seconds();
+        for(int i = 0 ; i < times ; i++) {
+                jsonpg_parse(p, sbuf->bytes, sbuf->count, NULL);
+                jsonpg_type t = JSONPG_NONE;
+                while(t != JSONPG_EOF && t != JSONPG_ERROR) {
+                        int count = jsonpg_parse_batch(p, events, 256);
+                        t = events[count - 1].type;
+                }
+                if(t == JSONPG_ERROR)
+                        return -1;
+        }
+        double elapsed = seconds() - start;
+        if(misses != -1)
+                misses_per_kb = (cache_misses(misses_fd) - misses)
+                        / ((double)sbuf->count * times / 1024);
+        return (double)sbuf->count * times / elapsed / 1e6;
+}
+
+static void report(char *name, char *engine, str_buf sbuf, double rate)
+{
+        if(rate < 0)
+                printf("%-10s %-6s %10u bytes      parse error\n",
+                                name, engine, sbuf->count);
+        else
+                printf("%-10s %-6s %10u bytes %8.1f MB/s",
+                                name, engine, sbuf->count, rate);
+        if(rate >= 0 && misses_fd != -1)
+                printf(" %8.2f L1d misses/KB", misses_per_kb);
+        printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+        if(argc != 2 && argc != 3) {
+                printf("Usage: jsonpg_bench <json file> [times]\n");
+                exit(1);
+        }
+        int times = (argc == 3) ? atoi(argv[2]) : 10;
+
+        int fd = open(argv[1], O_RDONLY);
+        if(fd == -1) {
+                perror("Failed to open file");
+                exit(1);
+        }
+
+        jsonpg_parser p = jsonpg_parser_new(NULL);
+        jsonpg_dom dom = jsonpg_dom_new();
+        jsonpg_generator g = jsonpg_dom_generator(dom);
+        if(!p || !g || JSONPG_EOF != jsonpg_parse_fd(p, fd, g)) {
+                printf("Failed to load %s\n", argv[1]);
+                exit(1);
+        }
+        jsonpg_generator_free(g);
+
+        str_buf minified = print_dom(dom, 0);
+        str_buf pretty = print_dom(dom, 1);
+        if(!minified || !pretty) {
+                printf("Failed to print %s\n", argv[1]);
+                exit(1);
+        }
+
+        jsonpg_config c = jsonpg_config_get();
+        c.flags = JSONPG_FLAG_STRUCTURAL_INDEX;
+        jsonpg_parser ip = jsonpg_parser_new(&c);
+        if(!ip) {
+                printf("Failed to create parser\n");
+                exit(1);
+        }
+
+        misses_fd = cache_misses_open();
+        printf("state tables: %s layout, %zu bytes%s\n", STATE_LAYOUT,
+                        STATE_TABLES, misses_fd == -1
+                                ? ", no cache counters" : "");
+
+        report("minified", "table", minified, parse_rate(p, minified, times));
+        report("minified", "index", minified, parse_rate(ip, minified, times));
+        report("minified", "batch", minified, parse_batch_rate(p, minified, times));
+        report("pretty", "table", pretty, parse_rate(p, pretty, times));
+        report("pretty", "index", pretty, parse_rate(ip, pretty, times));
+        report("pretty", "batch", pretty, parse_batch_rate(p, pretty, times));
+
+        jsonpg_buffer_free(minified);
+        jsonpg_buffer_free(pretty);
+        jsonpg_dom_free(dom);
+        jsonpg_parser_free(ip);
+        jsonpg_parser_free(p);
+}
@@ -0,0 +1,181 @@
+/*
+ * jsonpg_buffer_bench.c
+ *   reader input buffer size benchmarks
+ *
+ *   gcc -O2 -march=native -o jsonpg_buffer_bench jsonpg_buffer_bench.c
+ *
+ *   jsonpg_buffer_bench <json file> [times]
+ *      parses the file through a reader, from the file itself and
+ *      from a pipe fed by a child process, sweeping buffer_size
+ *      from 1 KB to 1 MB, with an adaptive buffer from 4 KB and
+ *      with mirrored ring buffers
+ *
+ *      reports MB/s, read() calls per parse and the size the
+ *      input buffer ended at
+ */
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "jsonpg.c"
+
+static double seconds()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long reads;
+
+static ssize_t read_counted(jsonpg_reader r, void *buf, size_t count)
+{
+        reads++;
+        return read_fd(r, buf, count);
+}
+
+// Returns a pipe read end with a child writing json to the other end
+static int pipe_open(uint8_t *json, size_t length)
+{
+        int fds[2];
+        if(pipe(fds) == -1)
+                return -1;
+        pid_t pid = fork();
+        if(pid == -1) {
+                close(fds[0]);
+                close(fds[1]);
+                return -1;
+        }
+        if(pid == 0) {
+                close(fds[0]);
+                while(length > 0) {
+                        ssize_t l = write(fds[1], json, length);
+                        if(l <= 0)
+                                _exit(1);
+                        json += l;
+                        length -= l;
+                }
+                _exit(0);
+        }
+        close(fds[1]);
+        return fds[0];
+}
+
+static int parse_reader(jsonpg_parser p, int fd)
+{
+        jsonpg_reader r = jsonpg_file_reader(fd);
+        if(!r)
+                return -1;
+        r->read = read_counted;
+        jsonpg_type t = jsonpg_parse_reader(p, r, NULL);
+        while(t != JSONPG_EOF && t != JSONPG_ERROR)
+                t = jsonpg_parse_next(p);
+        return (t == JSONPG_ERROR) ? -1 : 0;
+}
+
+/*
+ * Parses the file, or json through a pipe, times times
+ *
+ * Returns MB/s or -1 on error
+ */
+static double parse_rate(jsonpg_parser p, char *name,
+                uint8_t *json, size_t length, int from_pipe, int times)
+{
+        int fd = from_pipe ? -1 : open(name, O_RDONLY);
+        double elapsed = 0;
+        for(int i = 0 ; i < times ; i++) {
+                if(from_pipe)
+                        fd = pipe_open(json, length);
+                else
+                        lseek(fd, 0, SEEK_SET);
+                if(fd == -1)
+                        return -1;
+
+                double start = seconds();
+                int error = parse_reader(p, fd);
+                elapsed += seconds() - start;
+
+                if(from_pipe) {
+                        close(fd);
+                        wait(NULL);
+                }
+                if(error)
+                        return -1;
+        }
+        if(!from_pipe)
+                close(fd);
+        return (double)length * times / elapsed / 1e6;
+}
+
+static void sweep(char *source, char *name,
+                uint8_t *json, size_t length, int from_pipe, int times)
+{
+        static struct {
+                char *name;
+                size_t size;
+                int16_t flags;
+        } buffers[] = {
+                { "1K", 1 << 10, 0 },
+                { "4K", 1 << 12, 0 },
+                { "16K", 1 << 14, 0 },
+                { "64K", 1 << 16, 0 },
+                { "256K", 1 << 18, 0 },
+                { "1M", 1 << 20, 0 },
+                { "adaptive", 1 << 12, JSONPG_FLAG_ADAPTIVE_BUFFER },
+                { "ring 4K", 1 << 12, JSONPG_FLAG_MIRRORED_BUFFER },
+                { "ring 64K", 1 << 16, JSONPG_FLAG_MIRRORED_BUFFER }
+        };
+        for(size_t i = 0 ; i < sizeof(buffers) / sizeof(buffers[0]) ; i++) {
+                jsonpg_config c = jsonpg_config_get();
+                c.buffer_size = buffers[i].size;
+                c.flags |= buffers[i].flags;
+                jsonpg_parser p = jsonpg_parser_new(&c);
+                if(!p) {
+                        printf("Failed to create parser\n");
+                        exit(1);
+                }
+
+                reads = 0;
+                double rate = parse_rate(p, name, json, length, from_pipe, times);
+                if(rate < 0)
+                        printf("%-5s %-8s      parse error\n",
+                                        source, buffers[i].name);
+                else
+                        printf("%-5s %-8s %8.1f MB/s %10ld reads %8zu buffer%s\n",
+                                        source, buffers[i].name, rate,
+                                        reads / times, p->input_size,
+                                        p->input_is_ring ? " (ring)" : "");
+                jsonpg_parser_free(p);
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        if(argc != 2 && argc != 3) {
+                printf("Usage: jsonpg_buffer_bench <json file> [times]\n");
+                exit(1);
+        }
+        int times = (argc == 3) ? atoi(argv[2]) : 10;
+
+        FILE *fh = fopen(argv[1], "rb");
+        if(!fh) {
+                perror("Failed to open file");
+                exit(1);
+        }
+        fseek(fh, 0L, SEEK_END);
+        size_t length = ftell(fh);
+        rewind(fh);
+        uint8_t *json = malloc(length ? length : 1);
+        if(!json || length != fread(json, 1, length, fh)) {
+                printf("Failed to read %s\n", argv[1]);
+                exit(1);
+        }
+        fclose(fh);
+
+        printf("%s: %zu bytes\n", argv[1], length);
+        sweep("file", argv[1], json, length, 0, times);
+        sweep("pipe", argv[1], json, length, 1, times);
+
+        free(json);
+}
@@ -8,7 +8,7 @@
  * individual fields can then be set
  *
  * json_config_set() will overwrite the default config
- * used for all future calls
+ * used for all future calls, parsers already made keep theirs
  *
  * jsonpg_new() can be called with a custom config or NULL 
  * to use the default config
@@ -33,6 +33,19 @@
  *    memory used is (stack_size/8) bytes
  *    default: JSONPG_STACK_SIZE=1024
  *
+ * buffer_size
+ *    size of the input buffer filled by readers, jsonpg_parse_fd()
+ *    and the like, larger buffers mean fewer reads and fewer tokens
+ *    copied forward across refills
+ *    default: JSONPG_BUFFER_SIZE=4096
+ *
+ * allocator
+ *    allocates the parser and everything it keeps, its buffers,
+ *    index and the state of projections and queries, such as
+ *    jsonpg_arena_allocator() for an arena to reset after each
+ *    request, the allocator must outlive the parser
+ *    default: NULL for the functions given to jsonpg_set_allocators()
+ *
  *
  * Flags:
  *
@@ -94,12 +107,51 @@
  *    treats the input as being surrounded by [ ]
  *
  *  Note: a configuration with both is_object and is_array will enable neither 
+ *
+ *  structural_index
+ *    parses buffers passed to jsonpg_parse() with the structural index
+ *    engine, stage 1 finds the structural characters in a block of input
+ *    using bit mask arithmetic, stage 2 walks them to produce events
+ *
+ *    only used for strict JSON, any of the flags above or input from
+ *    a reader select the table driven engine
+ *
+ *  adaptive_buffer
+ *    doubles the reader input buffer, up to JSONPG_BUF_ADAPTIVE_MAX,
+ *    when reads keep filling it or tokens keep straddling refills
+ *
+ *  mirrored_buffer
+ *    reader input goes into a ring buffer mapped twice in a row
+ *    so tokens crossing a refill stay where they are, strings
+ *    are not copied unless they have escapes, buffer_size is
+ *    rounded up to whole pages
+ *
+ *    Linux only, elsewhere a plain buffer is used
+ *
+ *  document_sequence
+ *    the input is any number of JSON values one after another,
+ *    separated by whitespace or nothing where that is unambiguous,
+ *    JSONPG_END_DOCUMENT follows each and JSONPG_EOF the last
+ *
+ *    the parser carries on with the same input buffer, reader and
+ *    string buffer, only a value split across a refill is copied
+ *
+ *    ignored with is_object or is_array
  */
 
 #include <string.h>
 
+#include <pthread.h>
+
+/*
+ * The defaults are held by value, jsonpg_config_set() writes them
+ * while config_version is odd and readers copy them again if the
+ * version was odd or moved while they copied, so threads can make
+ * parsers while another sets the defaults without allocating
+ */
 static jsonpg_config config_defaults = {
         .stack_size = JSONPG_STACK_SIZE,
+        .buffer_size = JSONPG_BUFFER_SIZE,
         .flags = 0x0
 #ifdef JSONPG_REPLACE_ILLFORMED_UTF8
                 | JSONPG_FLAG_REPLACE_ILLFORMED_UTF8
@@ -131,37 +183,89 @@ static jsonpg_config config_defaults = {
 #ifdef JSONPG_IS_ARRAY
                 | JSONPG_FLAG_IS_ARRAY
 #endif
+#ifdef JSONPG_STRUCTURAL_INDEX
+                | JSONPG_FLAG_STRUCTURAL_INDEX
+#endif
+#ifdef JSONPG_ADAPTIVE_BUFFER
+                | JSONPG_FLAG_ADAPTIVE_BUFFER
+#endif
+#ifdef JSONPG_MIRRORED_BUFFER
+                | JSONPG_FLAG_MIRRORED_BUFFER
+#endif
+#ifdef JSONPG_DOCUMENT_SEQUENCE
+                | JSONPG_FLAG_DOCUMENT_SEQUENCE
+#endif
 };
 
+static unsigned config_version = 0;
+static pthread_mutex_t config_lock = PTHREAD_MUTEX_INITIALIZER;
 
-jsonpg_config jsonpg_config_get()
+// Field by field with atomic loads and stores as the other may be shared
+static void config_copy(jsonpg_config *to, jsonpg_config *from)
 {
-        jsonpg_config config = {
-                .stack_size = config_defaults.stack_size,
-                .flags = config_defaults.flags
-        };
+        __atomic_store_n(&to->stack_size,
+                        __atomic_load_n(&from->stack_size, __ATOMIC_RELAXED),
+                        __ATOMIC_RELAXED);
+        __atomic_store_n(&to->buffer_size,
+                        __atomic_load_n(&from->buffer_size, __ATOMIC_RELAXED),
+                        __ATOMIC_RELAXED);
+        __atomic_store_n(&to->flags,
+                        __atomic_load_n(&from->flags, __ATOMIC_RELAXED),
+                        __ATOMIC_RELAXED);
+        __atomic_store_n(&to->allocator,
+                        __atomic_load_n(&from->allocator, __ATOMIC_RELAXED),
+                        __ATOMIC_RELAXED);
+}
 
+static jsonpg_config config_current()
+{
+        jsonpg_config config;
+        unsigned version;
+        do {
+                version = __atomic_load_n(&config_version, __ATOMIC_ACQUIRE);
+                config_copy(&config, &config_defaults);
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while((version & 1)
+                        || version != __atomic_load_n(&config_version,
+                                __ATOMIC_RELAXED));
         return config;
 }
 
+
+jsonpg_config jsonpg_config_get()
+{
+        return config_current();
+}
+
 void jsonpg_config_set(jsonpg_config *config) {
-        config_defaults.stack_size = config->stack_size;
-        config_defaults.flags = config->flags;
+        pthread_mutex_lock(&config_lock);
+        __atomic_store_n(&config_version, config_version + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        config_copy(&config_defaults, config);
+        __atomic_store_n(&config_version, config_version + 1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&config_lock);
 }
 
 static jsonpg_config config_select(jsonpg_config *chosen_config) {
         jsonpg_config config = {
                 .stack_size = JSONPG_STACK_SIZE,
+                .buffer_size = JSONPG_BUFFER_SIZE,
                 .flags = 0
         };
 
+        jsonpg_config defaults = config_current();
         jsonpg_config *source_config = chosen_config 
                 ? chosen_config 
-                : &config_defaults;
+                : &defaults;
 
         if(source_config->stack_size >= 0)
                 config.stack_size = source_config->stack_size;
 
+        if(source_config->buffer_size > 0)
+                config.buffer_size = source_config->buffer_size;
+
+        config.allocator = allocator_select(source_config->allocator);
+
 
         uint16_t incompatible_flags = JSONPG_FLAG_IS_OBJECT | JSONPG_FLAG_IS_ARRAY;
         if(incompatible_flags == 
@@ -171,5 +275,9 @@ static jsonpg_config config_select(jsonpg_config *chosen_config) {
         else
                 config.flags = source_config->flags;
 
+        // A single wrapped value cannot be followed by another
+        if(config.flags & incompatible_flags)
+                config.flags &= ~JSONPG_FLAG_DOCUMENT_SEQUENCE;
+
         return config;
 }
@@ -0,0 +1,129 @@
+/*
+ * jsonpg_difftest.c
+ *   differential test of the structural index engine
+ *   against the table driven engine
+ *
+ *   gcc -O2 -march=native -o jsonpg_difftest jsonpg_difftest.c
+ *
+ *   jsonpg_difftest <json file>...
+ *      parses each file with both engines and compares every
+ *      event, value and error, e.g. on the JSONTestSuite
+ *      test_parsing files
+ *
+ *   the parser reports errors on stderr, redirect to ignore them
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "jsonpg.c"
+
+static uint8_t *read_file(char *name, uint32_t *length)
+{
+        FILE *fh = fopen(name, "rb");
+        if(!fh)
+                return NULL;
+        fseek(fh, 0L, SEEK_END);
+        long l = ftell(fh);
+        rewind(fh);
+        if(l < 0) {
+                fclose(fh);
+                return NULL;
+        }
+        // nul terminated for number conversion at end of input
+        uint8_t *buf = calloc(l + 1, 1);
+        if(buf && (size_t)l != fread(buf, 1, l, fh)) {
+                free(buf);
+                buf = NULL;
+        }
+        fclose(fh);
+        *length = l;
+        return buf;
+}
+
+static int same_result(jsonpg_type t, jsonpg_value *a, jsonpg_value *b)
+{
+        switch(t) {
+        case JSONPG_INTEGER:
+                return a->number.integer == b->number.integer;
+        case JSONPG_REAL:
+                return 0 == memcmp(&a->number.real, &b->number.real, sizeof(double));
+        case JSONPG_STRING:
+        case JSONPG_KEY:
+                return a->string.length == b->string.length
+                        && 0 == memcmp(a->string.bytes, b->string.bytes,
+                                        a->string.length);
+        case JSONPG_ERROR:
+                return a->error.code == b->error.code
+                        && a->error.at == b->error.at;
+        default:
+                return 1;
+        }
+}
+
+/*
+ * Returns 0 if both parsers produce the same events for the input
+ */
+static int compare(char *name, jsonpg_parser table, jsonpg_parser index,
+                uint8_t *json, uint32_t length)
+{
+        jsonpg_parse(table, json, length, NULL);
+        jsonpg_parse(index, json, length, NULL);
+
+        for(int event = 0 ; ; event++) {
+                jsonpg_type t1 = jsonpg_parse_next(table);
+                jsonpg_type t2 = jsonpg_parse_next(index);
+                jsonpg_value v1 = jsonpg_result(table);
+                jsonpg_value v2 = jsonpg_result(index);
+
+                if(t1 != t2 || !same_result(t1, &v1, &v2)) {
+                        printf("%s: event %d differs, table %d, index %d\n",
+                                        name, event, t1, t2);
+                        if(t1 == JSONPG_ERROR)
+                                printf("  table error %d at %zu\n",
+                                                v1.error.code, v1.error.at);
+                        if(t2 == JSONPG_ERROR)
+                                printf("  index error %d at %zu\n",
+                                                v2.error.code, v2.error.at);
+                        return 1;
+                }
+                if(t1 == JSONPG_EOF || t1 == JSONPG_ERROR)
+                        return 0;
+        }
+}
+
+int main(int argc, char *argv[])
+{
+        if(argc < 2) {
+                printf("Usage: jsonpg_difftest <json file>...\n");
+                exit(2);
+        }
+
+        jsonpg_config c = jsonpg_config_get();
+        c.flags = 0;
+        jsonpg_parser table = jsonpg_parser_new(&c);
+        c.flags = JSONPG_FLAG_STRUCTURAL_INDEX;
+        jsonpg_parser index = jsonpg_parser_new(&c);
+        if(!table || !index) {
+                printf("Failed to create parsers\n");
+                exit(2);
+        }
+
+        int failed = 0;
+        for(int i = 1 ; i < argc ; i++) {
+                uint32_t length;
+                uint8_t *json = read_file(argv[i], &length);
+                if(!json) {
+                        printf("%s: cannot read\n", argv[i]);
+                        failed++;
+                        continue;
+                }
+                failed += compare(argv[i], table, index, json, length);
+                free(json);
+        }
+        printf("%d files, %d differ\n", argc - 1, failed);
+
+        jsonpg_parser_free(table);
+        jsonpg_parser_free(index);
+        return failed ? 1 : 0;
+}
@@ -1,22 +1,63 @@
+/*
+ * jsonpg_dom.c
+ *   the DOM is a tape, a single array of 8 byte nodes holding the
+ *   events in document order
+ *
+ *   each node starts with a type node, scalars and strings follow it
+ *   with their value, begin nodes follow it with the tape offset of
+ *   the matching end node and keep their child count in the type node
+ *   so a cursor can step over a whole container at once
+ *
+ *   lookups by key or index in large containers build an index for
+ *   that container the first time, kept by the header until freed
+ *
+ *   given the caller's input with jsonpg_dom_input() strings that lie
+ *   in it are stored as an offset into it rather than copied, the
+ *   input must then outlive the DOM or be copied by jsonpg_dom_own_input()
+ */
 #include <stdint.h>
 
-#define DOM_MIN_SIZE 8192
+#define DOM_MIN_NODES 1024
 #define NODE_SIZE (sizeof(struct dom_node_s))
+#define DOM_NONE ((size_t)-1)
+#define DOM_INDEX_MIN 16        // children before a container is indexed
+
+#define DOM_FLAG_REF 0x01       // string bytes are at an offset in the input
 
 typedef struct dom_hdr_s *dom_hdr;
 typedef struct dom_node_s *dom_node;
 typedef struct dom_type_s dom_type;
+typedef struct dom_index_s *dom_index;
 
 
 struct dom_hdr_s {
-        dom_hdr next;
-        dom_hdr current;
-        unsigned count;
-        unsigned size;
+        dom_node nodes;
+        size_t count;
+        size_t size;
+        size_t open;    // innermost begin node without its end node
+        dom_index *indexes;
+        size_t index_count;
+        size_t index_size;
+        uint8_t *input;
+        size_t input_length;
+        size_t input_refs;
+        int input_is_ours;
+        jsonpg_allocator *allocator;
+};
+
+/*
+ * Index of a container, for an array the offset of each value and
+ * for an object a hash table of key offsets
+ */
+struct dom_index_s {
+        size_t begin;
+        size_t size;
+        size_t slots[];
 };
 
 struct dom_type_s {
-        jsonpg_type type;
+        uint16_t type;
+        uint16_t flags;
         unsigned count;
 };
 
@@ -25,6 +66,7 @@ struct dom_node_s {
                 dom_type type;
                 double real;
                 long integer;
+                size_t offset;
                 uint8_t bytes[8];
         } is;
 };
@@ -36,64 +78,69 @@ static unsigned dom_size_align(unsigned size)
         return NODE_SIZE * (1 + ((size - 1) / NODE_SIZE));
 }
 
-// Ensure minimum size
-static unsigned dom_node_size(unsigned size)
+static dom_hdr dom_hdr_new(jsonpg_allocator *allocator)
 {
-        size = size < DOM_MIN_SIZE 
-                ? DOM_MIN_SIZE 
-                : size;
-        return dom_size_align(size);
-}
-
-static dom_hdr dom_hdr_new(unsigned size)
-{
-        size = dom_node_size(size + sizeof(struct dom_hdr_s));
-
-        dom_hdr hdr = pg_alloc(size);
-
+        dom_hdr hdr = al_alloc(allocator, sizeof(struct dom_hdr_s));
         if(!hdr)
                 return NULL;
 
-        hdr->next = NULL;
-        hdr->current = NULL;
-        hdr->size = size;
-        hdr->count = sizeof(struct dom_hdr_s);
+        hdr->allocator = allocator;
+        hdr->nodes = NULL;
+        hdr->count = 0;
+        hdr->size = 0;
+        hdr->open = DOM_NONE;
+        hdr->indexes = NULL;
+        hdr->index_count = 0;
+        hdr->index_size = 0;
+        hdr->input = NULL;
+        hdr->input_length = 0;
+        hdr->input_refs = 0;
+        hdr->input_is_ours = 0;
 
         return hdr;
 }
 
-static dom_node dom_node_next(dom_hdr root, unsigned count)
+// Returns 0 if there is room for required more nodes or -1
+static int dom_node_room(dom_hdr root, size_t required)
 {
-        unsigned required = dom_size_align(count + NODE_SIZE);
-        dom_hdr hdr = root->current;
-        if(required > hdr->size - hdr->count) {
-                // Should we always make new or sometimes realloc
-                // to avoid lots of wasted space?
-                // can't realloc root due to risk of invalidating ptr
-                // handed to us.
-                // Leave for now and accept memory loss
-                dom_hdr new = dom_hdr_new(required);
-
-                if(!new)
-                        return NULL;
-
-                hdr->next = new;
-                root->current = new;
-                hdr = new;
+        if(required > root->size - root->count) {
+                size_t size = root->size ? 2 * root->size : DOM_MIN_NODES;
+                while(size - root->count < required)
+                        size *= 2;
+                dom_node nodes = al_realloc(root->allocator, root->nodes,
+                                size * NODE_SIZE);
+                if(!nodes)
+                        return -1;
+                root->nodes = nodes;
+                root->size = size;
         }
-        unsigned offset = hdr->count;
-        hdr->count += required;
-        return (dom_node)(offset + (void *)hdr);
-
+        return 0;
+}
 
+// Returns the tape offset of room for a type node and count bytes
+static size_t dom_node_next(dom_hdr root, unsigned count)
+{
+        size_t required = 1 + (count ? dom_size_align(count) / NODE_SIZE : 0);
+        if(dom_node_room(root, required))
+                return DOM_NONE;
+        size_t offset = root->count;
+        root->count += required;
+        return offset;
 }
 
 static dom_node dom_add_type(dom_hdr root, jsonpg_type type, unsigned count)
 {
-        dom_node node = dom_node_next(root, count);
-        if(!node)
+        size_t offset = dom_node_next(root, count);
+        if(offset == DOM_NONE)
                 return NULL;
+
+        // A value, but not a key, is a child of the open container
+        if(type != JSONPG_KEY && root->open != DOM_NONE)
+                root->nodes[root->open].is.type.count++;
+
+        dom_node node = &root->nodes[offset];
         node->is.type.type = type;
+        node->is.type.flags = 0;
         node->is.type.count = count;
 
         return node;
@@ -135,6 +182,66 @@ static dom_node dom_add_bytes(dom_hdr root, jsonpg_type type, uint8_t *bytes, un
         return node;
 }
 
+static dom_node dom_add_ref(dom_hdr root, jsonpg_type type, uint8_t *bytes, unsigned count)
+{
+        dom_node node = dom_add_type(root, type, NODE_SIZE);
+        if(!node)
+                return NULL;
+
+        node->is.type.flags = DOM_FLAG_REF;
+        node->is.type.count = count;
+        node[1].is.offset = bytes - root->input;
+        root->input_refs++;
+
+        return node;
+}
+
+// Strings in the input are referenced rather than copied
+static dom_node dom_add_string(dom_hdr root, jsonpg_type type, uint8_t *bytes, unsigned count)
+{
+        if(root->input && bytes >= root->input
+                        && bytes + count <= root->input + root->input_length)
+                return dom_add_ref(root, type, bytes, count);
+        return dom_add_bytes(root, type, bytes, count);
+}
+
+static dom_node dom_add_begin(dom_hdr root, jsonpg_type type)
+{
+        dom_node node = dom_add_type(root, type, NODE_SIZE);
+        if(!node)
+                return NULL;
+
+        // Until the end node is added link to the enclosing container
+        node->is.type.count = 0;
+        node[1].is.offset = root->open;
+        root->open = node - root->nodes;
+
+        return node;
+}
+
+static dom_node dom_add_end(dom_hdr root, jsonpg_type type)
+{
+        size_t begin = root->open;
+        if(begin == DOM_NONE)
+                return NULL;
+
+        // Not a child of the container it ends
+        size_t offset = dom_node_next(root, 0);
+        if(offset == DOM_NONE)
+                return NULL;
+
+        dom_node node = &root->nodes[offset];
+        node->is.type.type = type;
+        node->is.type.flags = 0;
+        node->is.type.count = 0;
+
+        dom_node begin_node = &root->nodes[begin];
+        root->open = begin_node[1].is.offset;
+        begin_node[1].is.offset = offset;
+
+        return node;
+}
+
 static int dom_boolean(void *ctx, int is_true)
 {
         dom_hdr root = ctx;
@@ -162,37 +269,37 @@ static int dom_real(void *ctx, double real)
 static int dom_string(void *ctx, uint8_t *bytes, size_t count)
 {
         dom_hdr root = ctx;
-        return !dom_add_bytes(root, JSONPG_STRING, bytes, count);
+        return !dom_add_string(root, JSONPG_STRING, bytes, count);
 }
 
 static int dom_key(void *ctx, uint8_t *bytes, size_t count)
 {
         dom_hdr root = ctx;
-        return !dom_add_bytes(root, JSONPG_KEY, bytes, count);
+        return !dom_add_string(root, JSONPG_KEY, bytes, count);
 }
 
 static int dom_begin_array(void *ctx)
 {
         dom_hdr root = ctx;
-        return !dom_add_type(root, JSONPG_BEGIN_ARRAY, 0);
+        return !dom_add_begin(root, JSONPG_BEGIN_ARRAY);
 }
 
 static int dom_end_array(void *ctx)
 {
         dom_hdr root = ctx;
-        return !dom_add_type(root, JSONPG_END_ARRAY, 0);
+        return !dom_add_end(root, JSONPG_END_ARRAY);
 }
 
 static int dom_begin_object(void *ctx)
 {
         dom_hdr root = ctx;
-        return !dom_add_type(root, JSONPG_BEGIN_OBJECT, 0);
+        return !dom_add_begin(root, JSONPG_BEGIN_OBJECT);
 }
 
 static int dom_end_object(void *ctx)
 {
         dom_hdr root = ctx;
-        return !dom_add_type(root, JSONPG_END_OBJECT, 0);
+        return !dom_add_end(root, JSONPG_END_OBJECT);
 }
 
 
@@ -211,76 +318,551 @@ static jsonpg_callbacks dom_callbacks = {
 
 jsonpg_dom jsonpg_dom_new()
 {
-        jsonpg_dom dom = dom_hdr_new(0);
-        if(!dom)
-                return NULL;
+        return dom_hdr_new(allocator_select(NULL));
+}
 
-        dom->current = dom;
-        return dom;
+// A DOM allocating with allocator, NULL for the default
+jsonpg_dom jsonpg_dom_new_with(jsonpg_allocator *allocator)
+{
+        return dom_hdr_new(allocator_select(allocator));
 }
 
 void jsonpg_dom_free(void *p)
 {
         jsonpg_dom dom = p;
-        jsonpg_dom next;
-        while(dom) {
-                next = dom->next;
-                pg_dealloc(dom);
-                dom = next;
+        if(dom) {
+                for(size_t i = 0 ; i < dom->index_size ; i++)
+                        al_dealloc(dom->allocator, dom->indexes[i]);
+                al_dealloc(dom->allocator, dom->indexes);
+                if(dom->input_is_ours)
+                        al_dealloc(dom->allocator, dom->input);
+                al_dealloc(dom->allocator, dom->nodes);
+                al_dealloc(dom->allocator, dom);
         }
 }
 
+/*
+ * Strings and keys later added to the DOM that lie in the input are
+ * stored as references to it rather than copied, for a DOM built by
+ * jsonpg_parse() from input held in memory. The input must not change
+ * or be freed before the DOM unless copied by jsonpg_dom_own_input()
+ *
+ * Returns 0 on success or -1 if the DOM already refers to other input
+ */
+int jsonpg_dom_input(jsonpg_dom dom, uint8_t *input, size_t length)
+{
+        if(dom->input_refs && (input != dom->input || length < dom->input_length))
+                return -1;
+        if(dom->input_is_ours && input != dom->input) {
+                al_dealloc(dom->allocator, dom->input);
+                dom->input_is_ours = 0;
+        }
+        dom->input = input;
+        dom->input_length = length;
+        return 0;
+}
+
+/*
+ * Copies the input the DOM refers to so the caller can free it,
+ * strings added after this are copied as usual
+ *
+ * Returns 0 on success or -1 if the copy cannot be allocated
+ */
+int jsonpg_dom_own_input(jsonpg_dom dom)
+{
+        if(dom->input_is_ours || !dom->input)
+                return 0;
+        if(!dom->input_refs) {
+                dom->input = NULL;
+                dom->input_length = 0;
+                return 0;
+        }
+        uint8_t *input = al_alloc(dom->allocator, dom->input_length);
+        if(!input)
+                return -1;
+        memcpy(input, dom->input, dom->input_length);
+        dom->input = input;
+        dom->input_is_ours = 1;
+        return 0;
+}
+
 jsonpg_generator jsonpg_dom_generator(jsonpg_dom dom)
 {
         if(!dom)
                 return NULL;
 
-        jsonpg_generator g = jsonpg_generator_new(&dom_callbacks, 0, 0);
+        jsonpg_generator g = jsonpg_generator_new_with(&dom_callbacks, 0, 0,
+                        dom->allocator);
         if(g)
                 g->ctx = dom;
         return g;
 }
 
+static uint8_t *dom_string_bytes(jsonpg_dom dom, dom_node node)
+{
+        return (node->is.type.flags & DOM_FLAG_REF)
+                ? dom->input + node[1].is.offset
+                : node[1].is.bytes;
+}
+
+// Returns the type of the node at offset and sets its value
+static jsonpg_type dom_node_value(jsonpg_dom dom, size_t offset, jsonpg_value *result)
+{
+        dom_node node = &dom->nodes[offset];
+        jsonpg_type type = node->is.type.type;
+        unsigned count = node->is.type.count;
+        result->string.bytes = NULL;
+        result->string.length = 0;
+        switch(type) {
+        case JSONPG_INTEGER:
+                result->number.integer = node[1].is.integer;
+                break;
+        case JSONPG_REAL:
+                result->number.real = node[1].is.real;
+                break;
+        case JSONPG_STRING:
+        case JSONPG_KEY:
+                result->string.bytes = dom_string_bytes(dom, node);
+                result->string.length = count;
+                break;
+        default:
+                break;
+        }
+        return type;
+}
+
+// Returns the tape offset of the node after the one at offset
+static size_t dom_node_skip(jsonpg_dom dom, size_t offset)
+{
+        dom_node node = &dom->nodes[offset];
+        unsigned count = node->is.type.count;
+        switch(node->is.type.type) {
+        case JSONPG_INTEGER:
+        case JSONPG_REAL:
+        case JSONPG_BEGIN_ARRAY:
+        case JSONPG_BEGIN_OBJECT:
+                return offset + 2;
+        case JSONPG_STRING:
+        case JSONPG_KEY:
+                if(node->is.type.flags & DOM_FLAG_REF)
+                        return offset + 2;
+                return offset + 1 + (count ? dom_size_align(count) / NODE_SIZE : 0);
+        default:
+                return offset + 1;
+        }
+}
+
+// Returns the number of values at the top of the tape of part
+static size_t dom_values(dom_hdr part)
+{
+        size_t values = 0;
+        int depth = 0;
+        for(size_t offset = 0 ; offset < part->count ;
+                        offset = dom_node_skip(part, offset)) {
+                switch(part->nodes[offset].is.type.type) {
+                case JSONPG_BEGIN_ARRAY:
+                case JSONPG_BEGIN_OBJECT:
+                        values += (depth++ == 0);
+                        break;
+                case JSONPG_END_ARRAY:
+                case JSONPG_END_OBJECT:
+                        depth--;
+                        break;
+                case JSONPG_KEY:
+                        break;
+                default:
+                        values += (depth == 0);
+                }
+        }
+        return values;
+}
+
+/*
+ * Appends the complete values on the tape of part as children of the
+ * open container, moving its end offsets along. Strings part refers
+ * to in its input must lie in the same input of root
+ *
+ * Returns 0 on success or -1 if there is no room
+ */
+static int dom_splice(dom_hdr root, dom_hdr part)
+{
+        if(dom_node_room(root, part->count))
+                return -1;
+
+        size_t base = root->count;
+        dom_node nodes = root->nodes + base;
+        memcpy(nodes, part->nodes, part->count * NODE_SIZE);
+
+        for(size_t offset = 0 ; offset < part->count ;
+                        offset = dom_node_skip(part, offset)) {
+                int type = nodes[offset].is.type.type;
+                if(type == JSONPG_BEGIN_ARRAY || type == JSONPG_BEGIN_OBJECT)
+                        nodes[offset + 1].is.offset += base;
+        }
+        unsigned children = dom_values(part);
+
+        if(root->open != DOM_NONE)
+                root->nodes[root->open].is.type.count += children;
+        root->count += part->count;
+        root->input_refs += part->input_refs;
+        return 0;
+}
+
 jsonpg_type jsonpg_dom_parse(jsonpg_dom dom, jsonpg_generator g)
 {
         int abort = 0;
-        jsonpg_dom hdr = dom;
-        while(!abort && hdr) {
-                unsigned offset = sizeof(struct dom_hdr_s);
-                while(!abort && offset < hdr->count) {
-                        dom_node node = (dom_node)(offset + (void *)hdr);
-                        jsonpg_value result;
-                        result.string.bytes = NULL;
-                        result.string.length = 0;
-                        offset += NODE_SIZE;
-                        jsonpg_type type = node->is.type.type;
-                        unsigned count = node->is.type.count;
-                        switch(type) {
-                        case JSONPG_INTEGER:
-                                node++;
-                                offset += NODE_SIZE;
-                                result.number.integer = node->is.integer;
-                                break;
-                        case JSONPG_REAL:
-                                node++;
-                                offset += NODE_SIZE;
-                                result.number.real = node->is.real;
-                                break;
-                        case JSONPG_STRING:
-                        case JSONPG_KEY:
-                                node++;
-                                offset += dom_size_align(count);
-                                result.string.bytes = node->is.bytes;
-                                result.string.length = count;
-                                break;
-                        default:
-                        }
-                        abort = generate(g, type, &result);
-                }
-                hdr = hdr->next;
+        size_t offset = 0;
+        while(!abort && offset < dom->count) {
+                jsonpg_value result;
+                jsonpg_type type = dom_node_value(dom, offset, &result);
+                offset = dom_node_skip(dom, offset);
+                abort = generate(g, type, &result);
         }
         if(abort)
                 return JSONPG_ERROR;
         else
                 return JSONPG_EOF;
 }
+
+/*
+ * Cursor over the tape, each move is constant time
+ *
+ * Values returned for strings point into the DOM and are valid
+ * until more is added to it
+ */
+jsonpg_cursor jsonpg_dom_cursor(jsonpg_dom dom)
+{
+        jsonpg_cursor c = { .dom = dom, .at = 0 };
+        return c;
+}
+
+/*
+ * Returns the type at the cursor, JSONPG_EOF past the end of the DOM
+ * or JSONPG_NONE for a failed lookup
+ */
+jsonpg_type jsonpg_cursor_type(jsonpg_cursor *c)
+{
+        if(c->at == DOM_NONE)
+                return JSONPG_NONE;
+        return (c->at < c->dom->count)
+                ? c->dom->nodes[c->at].is.type.type
+                : JSONPG_EOF;
+}
+
+jsonpg_value jsonpg_cursor_value(jsonpg_cursor *c)
+{
+        jsonpg_value result = { 0 };
+        if(c->at < c->dom->count)
+                dom_node_value(c->dom, c->at, &result);
+        return result;
+}
+
+// Returns the number of values in an array or members in an object
+size_t jsonpg_cursor_count(jsonpg_cursor *c)
+{
+        switch(jsonpg_cursor_type(c)) {
+        case JSONPG_BEGIN_ARRAY:
+        case JSONPG_BEGIN_OBJECT:
+                return c->dom->nodes[c->at].is.type.count;
+        default:
+                return 0;
+        }
+}
+
+/*
+ * Moves into the container at the cursor to its first child, or to
+ * its end if it is empty
+ *
+ * Returns the type at the new position or JSONPG_NONE if the cursor
+ * is not at the beginning of a container
+ */
+jsonpg_type jsonpg_cursor_down(jsonpg_cursor *c)
+{
+        switch(jsonpg_cursor_type(c)) {
+        case JSONPG_BEGIN_ARRAY:
+        case JSONPG_BEGIN_OBJECT:
+                c->at = dom_node_skip(c->dom, c->at);
+                return jsonpg_cursor_type(c);
+        default:
+                return JSONPG_NONE;
+        }
+}
+
+/*
+ * Moves from the beginning of a container to its end
+ *
+ * Returns the type at the new position or JSONPG_NONE if the cursor
+ * is not at the beginning of a complete container
+ */
+jsonpg_type jsonpg_cursor_end(jsonpg_cursor *c)
+{
+        switch(jsonpg_cursor_type(c)) {
+        case JSONPG_BEGIN_ARRAY:
+        case JSONPG_BEGIN_OBJECT: {
+                // An open container still links back to its parent
+                size_t end = c->dom->nodes[c->at + 1].is.offset;
+                if(end == DOM_NONE || end < c->at)
+                        return JSONPG_NONE;
+                c->at = end;
+                return jsonpg_cursor_type(c);
+        }
+        default:
+                return JSONPG_NONE;
+        }
+}
+
+/*
+ * Moves past the value at the cursor, skipping a whole container,
+ * to its next sibling or to the end of the enclosing container
+ *
+ * Returns the type at the new position
+ */
+jsonpg_type jsonpg_cursor_next(jsonpg_cursor *c)
+{
+        switch(jsonpg_cursor_type(c)) {
+        case JSONPG_NONE:
+        case JSONPG_EOF:
+                return jsonpg_cursor_type(c);
+        case JSONPG_BEGIN_ARRAY:
+        case JSONPG_BEGIN_OBJECT:
+                if(jsonpg_cursor_end(c) == JSONPG_NONE)
+                        return JSONPG_NONE;
+                // fallthrough
+        default:
+                c->at = dom_node_skip(c->dom, c->at);
+                return jsonpg_cursor_type(c);
+        }
+}
+
+// FNV-1a
+static size_t dom_hash(uint8_t *bytes, size_t length)
+{
+        uint64_t hash = 0xCBF29CE484222325ULL;
+        for(size_t i = 0 ; i < length ; i++)
+                hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+        return (size_t)hash;
+}
+
+static int dom_key_equal(jsonpg_dom dom, size_t key, uint8_t *bytes, size_t length)
+{
+        dom_node node = &dom->nodes[key];
+        return node->is.type.count == length
+                && 0 == memcmp(dom_string_bytes(dom, node), bytes, length);
+}
+
+// Returns the slot for the index of the container at begin
+static dom_index *dom_index_slot(jsonpg_dom dom, size_t begin)
+{
+        size_t mask = dom->index_size - 1;
+        size_t i = (begin * 0x9E3779B97F4A7C15ULL) & mask;
+        while(dom->indexes[i] && dom->indexes[i]->begin != begin)
+                i = (i + 1) & mask;
+        return &dom->indexes[i];
+}
+
+static int dom_index_add(jsonpg_dom dom, dom_index index)
+{
+        if(2 * (dom->index_count + 1) > dom->index_size) {
+                size_t size = dom->index_size ? 2 * dom->index_size : 16;
+                dom_index *indexes = al_alloc(dom->allocator, size * sizeof(dom_index));
+                if(!indexes)
+                        return -1;
+                memset(indexes, 0, size * sizeof(dom_index));
+
+                dom_index *old = dom->indexes;
+                size_t old_size = dom->index_size;
+                dom->indexes = indexes;
+                dom->index_size = size;
+                for(size_t i = 0 ; i < old_size ; i++)
+                        if(old[i])
+                                *dom_index_slot(dom, old[i]->begin) = old[i];
+                al_dealloc(dom->allocator, old);
+        }
+        *dom_index_slot(dom, index->begin) = index;
+        dom->index_count++;
+        return 0;
+}
+
+static dom_index dom_index_build(jsonpg_dom dom, size_t begin)
+{
+        dom_node node = &dom->nodes[begin];
+        size_t count = node->is.type.count;
+        int is_object = (node->is.type.type == JSONPG_BEGIN_OBJECT);
+
+        // Objects use a hash table at most half full
+        size_t size = count;
+        if(is_object)
+                for(size = 1 ; size < 2 * count ; size *= 2)
+                        ;
+        dom_index index = al_alloc(dom->allocator, sizeof(struct dom_index_s) + size * sizeof(size_t));
+        if(!index)
+                return NULL;
+        index->begin = begin;
+        index->size = size;
+
+        size_t at = begin + 2;
+        if(is_object) {
+                for(size_t i = 0 ; i < size ; i++)
+                        index->slots[i] = DOM_NONE;
+                for(size_t n = 0 ; n < count ; n++) {
+                        dom_node key = &dom->nodes[at];
+                        size_t i = dom_hash(dom_string_bytes(dom, key), key->is.type.count) & (size - 1);
+                        while(index->slots[i] != DOM_NONE)
+                                i = (i + 1) & (size - 1);
+                        index->slots[i] = at;
+                        jsonpg_cursor c = { .dom = dom, .at = dom_node_skip(dom, at) };
+                        jsonpg_cursor_next(&c);
+                        at = c.at;
+                }
+        } else {
+                for(size_t n = 0 ; n < count ; n++) {
+                        index->slots[n] = at;
+                        jsonpg_cursor c = { .dom = dom, .at = at };
+                        jsonpg_cursor_next(&c);
+                        at = c.at;
+                }
+        }
+
+        if(dom_index_add(dom, index)) {
+                al_dealloc(dom->allocator, index);
+                return NULL;
+        }
+        return index;
+}
+
+/*
+ * Returns the index of the complete container at begin, building it
+ * if the container is large enough, or NULL to scan its children
+ */
+static dom_index dom_index_get(jsonpg_dom dom, size_t begin)
+{
+        if(dom->nodes[begin].is.type.count < DOM_INDEX_MIN)
+                return NULL;
+        if(dom->index_size) {
+                dom_index index = *dom_index_slot(dom, begin);
+                if(index)
+                        return index;
+        }
+        return dom_index_build(dom, begin);
+}
+
+// Returns 0 if the cursor is at the beginning of a complete container of type
+static int dom_is_container(jsonpg_cursor *c, jsonpg_type type)
+{
+        if(jsonpg_cursor_type(c) != type)
+                return -1;
+        size_t end = c->dom->nodes[c->at + 1].is.offset;
+        return (end == DOM_NONE || end < c->at) ? -1 : 0;
+}
+
+/*
+ * Returns a cursor at the first value in the object at c with the key,
+ * or a cursor with type JSONPG_NONE if there is none
+ */
+jsonpg_cursor jsonpg_dom_get_key(jsonpg_cursor *c, uint8_t *key, size_t length)
+{
+        jsonpg_cursor result = { .dom = c->dom, .at = DOM_NONE };
+        if(dom_is_container(c, JSONPG_BEGIN_OBJECT))
+                return result;
+
+        jsonpg_dom dom = c->dom;
+        dom_index index = dom_index_get(dom, c->at);
+        if(index) {
+                size_t mask = index->size - 1;
+                size_t i = dom_hash(key, length) & mask;
+                for( ; index->slots[i] != DOM_NONE ; i = (i + 1) & mask) {
+                        if(dom_key_equal(dom, index->slots[i], key, length)) {
+                                result.at = dom_node_skip(dom, index->slots[i]);
+                                break;
+                        }
+                }
+                return result;
+        }
+
+        jsonpg_cursor member = *c;
+        jsonpg_type type = jsonpg_cursor_down(&member);
+        while(type == JSONPG_KEY) {
+                int found = dom_key_equal(dom, member.at, key, length);
+                jsonpg_cursor_next(&member);
+                if(found) {
+                        result.at = member.at;
+                        break;
+                }
+                type = jsonpg_cursor_next(&member);
+        }
+        return result;
+}
+
+/*
+ * Returns a cursor at the value at position i in the array at c,
+ * or a cursor with type JSONPG_NONE if there is none
+ */
+jsonpg_cursor jsonpg_dom_get_index(jsonpg_cursor *c, size_t i)
+{
+        jsonpg_cursor result = { .dom = c->dom, .at = DOM_NONE };
+        if(dom_is_container(c, JSONPG_BEGIN_ARRAY)
+                        || i >= jsonpg_cursor_count(c))
+                return result;
+
+        dom_index index = dom_index_get(c->dom, c->at);
+        if(index) {
+                result.at = index->slots[i];
+                return result;
+        }
+
+        result = *c;
+        jsonpg_cursor_down(&result);
+        while(i--)
+                jsonpg_cursor_next(&result);
+        return result;
+}
+
+/*
+ * Returns a cursor at the value an RFC 6901 JSON Pointer, such as
+ * "/a/0/b", refers to or a cursor with type JSONPG_NONE if there is none
+ */
+jsonpg_cursor jsonpg_dom_pointer(jsonpg_dom dom, char *pointer)
+{
+        jsonpg_cursor c = jsonpg_dom_cursor(dom);
+        if(*pointer && *pointer != '/')
+                c.at = DOM_NONE;
+
+        while(*pointer == '/' && c.at != DOM_NONE) {
+                uint8_t *token = (uint8_t *)++pointer;
+                size_t length = strcspn(pointer, "/");
+                pointer += length;
+
+                if(jsonpg_cursor_type(&c) == JSONPG_BEGIN_ARRAY) {
+                        size_t i = number_index(token, length);
+                        if(i == NUMBER_NO_INDEX)
+                                c.at = DOM_NONE;
+                        else
+                                c = jsonpg_dom_get_index(&c, i);
+                        continue;
+                }
+
+                // ~1 is '/' and ~0 is '~'
+                uint8_t *escaped = memchr(token, '~', length);
+                uint8_t *key = token;
+                if(escaped) {
+                        key = al_alloc(dom->allocator, length);
+                        if(!key) {
+                                c.at = DOM_NONE;
+                                break;
+                        }
+                        size_t j = 0;
+                        for(size_t i = 0 ; i < length ; i++) {
+                                if(token[i] == '~' && i + 1 < length
+                                                && (token[i + 1] == '0' || token[i + 1] == '1'))
+                                        key[j++] = (token[++i] == '0') ? '~' : '/';
+                                else
+                                        key[j++] = token[i];
+                        }
+                        length = j;
+                }
+                c = jsonpg_dom_get_key(&c, key, length);
+                if(escaped)
+                        al_dealloc(dom->allocator, key);
+        }
+        return c;
+}
@@ -25,6 +25,10 @@ static jsonpg_type set_result_error(jsonpg_parser p, jsonpg_error_code code)
         p->result.error.code = code;
         p->result.error.at = p->current - p->input;
 
+        // Nothing more can be fed to this document
+        if(p->input_is_fed)
+                p->seen_eof = 1;
+
         dump_p(p);
 
         return JSONPG_ERROR;
@@ -1,16 +1,20 @@
 #include <assert.h>
 
-jsonpg_generator jsonpg_generator_new(
+// A generator allocating with allocator, NULL for the default
+jsonpg_generator jsonpg_generator_new_with(
                 jsonpg_callbacks *callbacks, 
                 size_t ctx_size,
-                uint16_t stack_size)
+                uint16_t stack_size,
+                jsonpg_allocator *allocator)
 {
-        jsonpg_generator g = pg_alloc(sizeof(struct jsonpg_generator_s)
+        allocator = allocator_select(allocator);
+        jsonpg_generator g = al_alloc(allocator, sizeof(struct jsonpg_generator_s)
                         + ctx_size
                         + (stack_size >> 3));
         if(!g)
                 return NULL;
         g->callbacks = callbacks;
+        g->allocator = allocator;
         g->ctx = ((void *)g) + sizeof(struct jsonpg_generator_s);
 
         g->key_next = 0;
@@ -25,9 +29,28 @@ jsonpg_generator jsonpg_generator_new(
         return g;
 }
 
+jsonpg_generator jsonpg_generator_new(
+                jsonpg_callbacks *callbacks, 
+                size_t ctx_size,
+                uint16_t stack_size)
+{
+        return jsonpg_generator_new_with(callbacks, ctx_size, stack_size, NULL);
+}
+
+// Returns non-zero if what the generator held back failed to write
+int jsonpg_generator_flush(jsonpg_generator g)
+{
+        return g->callbacks->flush
+                && g->callbacks->flush(g->ctx);
+}
+
 void jsonpg_generator_free(void *p)
 {
-        pg_dealloc(p);
+        jsonpg_generator g = p;
+        if(g) {
+                jsonpg_generator_flush(g);
+                al_dealloc(g->allocator, g);
+        }
 }
 
 static int cannot_value(jsonpg_generator g)
@@ -160,6 +183,16 @@ int jsonpg_end_object(jsonpg_generator g)
                         && g->callbacks->end_object(g->ctx));
 }
 
+// Between the values of a document sequence, the next starts at the
+// root even if an error left containers open
+int jsonpg_end_document(jsonpg_generator g)
+{
+        g->key_next = 0;
+        g->stack.ptr = g->stack.ptr_min;
+        return g->callbacks->end_document
+                && g->callbacks->end_document(g->ctx);
+}
+
 static int gen_error(jsonpg_generator g, int code, int at)
 {
         (void)(g->callbacks->error 
@@ -191,6 +224,8 @@ static int generate(jsonpg_generator g, jsonpg_type type, jsonpg_value *value)
                 return jsonpg_begin_object(g);
         case JSONPG_END_OBJECT:
                 return jsonpg_end_object(g);
+        case JSONPG_END_DOCUMENT:
+                return jsonpg_end_document(g);
         case JSONPG_ERROR:
                 return gen_error(g, value->error.code, value->error.at);
         default:
@@ -12,6 +12,7 @@ typedef struct jsonpg_generator_s *jsonpg_generator;
 struct jsonpg_generator_s {
         jsonpg_callbacks *callbacks;
         void *ctx;
+        jsonpg_allocator *allocator;
         int key_next;
         int error;
         struct stack_s stack;
@@ -0,0 +1,579 @@
+/*
+ * jsonpg - a JSON parser/generator
+ * © 2025 Bob Davison (see also: LICENSE)
+ *
+ * jsonpg_index.c
+ *   structural index parse engine for strict JSON held in memory
+ *
+ *   stage 1 classifies 64 byte blocks of input into bit masks and
+ *   records the position of every structural character ({ } [ ] , :),
+ *   quote and start of a literal or number
+ *   quotes inside strings and characters escaped by backslashes are
+ *   found with bit arithmetic so strings are never scanned a byte at a time
+ *   blocks where a string holds escapes or control characters are marked,
+ *   strings that avoid them need no more checks, other than validating
+ *   multi byte UTF-8 in bulk if their blocks are marked as holding it
+ *
+ *   stage 2 walks the recorded positions and produces the same
+ *   events, values and errors as the table driven jsonpg_parse_next
+ *
+ *   stage 1 runs over INDEX_CHUNK bytes at a time, when stage 2 has used
+ *   those positions the next chunk is indexed, this keeps the index
+ *   small and in cache
+ */
+#include <stdint.h>
+#include <string.h>
+
+#define INDEX_BLOCK     64
+#define INDEX_CHUNK     (INDEX_BLOCK * 256)
+
+#define EVEN_BITS       0x5555555555555555ULL
+
+// Flags for string bytes in a block
+#define DIRTY_ESCAPE    1       // backslash or control character
+#define DIRTY_UTF8      2       // multi byte UTF-8
+
+struct index_s {
+        uint8_t *base;          // start of indexed chunk
+        uint8_t *scanned;       // end of indexed input
+        uint32_t count;
+        uint32_t next;
+        uint64_t prev_escaped;  // carried from one block to the next
+        uint64_t prev_in_string;
+        uint64_t prev_atom;
+        uint16_t positions[INDEX_CHUNK]; // offsets from base
+        uint8_t dirty[INDEX_CHUNK / INDEX_BLOCK]; // DIRTY_ flags
+};
+
+// Stage 2 states are held in p->state
+typedef enum {
+        expect_value,
+        expect_value_or_close,
+        expect_key,
+        expect_key_or_close,
+        expect_colon,
+        expect_comma_or_close
+} index_expect;
+
+/*
+ * Returns a mask of the bytes escaped by a backslash
+ *
+ * In a run of backslashes each escapes the next so only odd length
+ * runs escape the byte after the run. Adding the start of each run
+ * that begins on an odd bit to the backslash mask carries through
+ * the run and leaves a mask that flips the even/odd sense for them
+ *
+ * prev_escaped carries an escape of the first byte of the next block
+ */
+static uint64_t index_escaped(uint64_t *prev_escaped, uint64_t backslash)
+{
+        backslash &= ~*prev_escaped;
+        uint64_t follows_escape = (backslash << 1) | *prev_escaped;
+        uint64_t odd_starts = backslash & ~EVEN_BITS & ~follows_escape;
+        uint64_t even_starts;
+        *prev_escaped = __builtin_add_overflow(
+                        odd_starts, backslash, &even_starts);
+
+        return (EVEN_BITS ^ (even_starts << 1)) & follows_escape;
+}
+
+/*
+ * Stage 1 for one block
+ * Returns a mask of the structural positions in the block and
+ * sets dirty flags for string bytes that need checking by stage 2
+ */
+static uint64_t index_block(struct index_s *x, const uint8_t *block, uint8_t *dirty)
+{
+        struct block_masks m;
+        classify_block(block, &m);
+
+        uint64_t quote = m.quote & ~index_escaped(&x->prev_escaped, m.backslash);
+
+        // Set from an opening quote up to, not including, its closing quote
+        uint64_t in_string = prefix_xor(quote) ^ x->prev_in_string;
+        x->prev_in_string = (uint64_t)((int64_t)in_string >> 63);
+
+        // Bytes of literals and numbers (and anything invalid)
+        uint64_t atom = ~(in_string | quote | m.whitespace | m.op);
+        uint64_t atom_start = atom & ~((atom << 1) | x->prev_atom);
+        x->prev_atom = atom >> 63;
+
+        *dirty = ((in_string & (m.backslash | m.control)) ? DIRTY_ESCAPE : 0)
+                | ((in_string & m.high) ? DIRTY_UTF8 : 0);
+
+        return (m.op & ~in_string) | quote | atom_start;
+}
+
+/*
+ * Stage 1 for the next chunk of input
+ */
+static void index_scan(jsonpg_parser p)
+{
+        struct index_s *x = p->index;
+        uint8_t *base = x->scanned;
+        size_t length = p->last - base;
+        if(length > INDEX_CHUNK)
+                length = INDEX_CHUNK;
+
+        x->base = base;
+        x->count = 0;
+        x->next = 0;
+
+        uint8_t tail[INDEX_BLOCK];
+        for(size_t offset = 0 ; offset < length ; offset += INDEX_BLOCK) {
+                const uint8_t *block = base + offset;
+                if(length - offset < INDEX_BLOCK) {
+                        // Pad the last block with whitespace
+                        memset(tail, ' ', INDEX_BLOCK);
+                        memcpy(tail, block, length - offset);
+                        block = tail;
+                }
+                uint64_t s = index_block(x, block,
+                                &x->dirty[offset / INDEX_BLOCK]);
+                while(s) {
+                        x->positions[x->count++] = offset + __builtin_ctzll(s);
+                        s &= s - 1;
+                }
+        }
+        x->scanned = base + length;
+}
+
+// Indexes on from outside a string at from, dropping the positions held
+static void index_restart(struct index_s *x, uint8_t *from)
+{
+        x->base = x->scanned = from;
+        x->count = x->next = 0;
+        x->prev_escaped = x->prev_in_string = x->prev_atom = 0;
+}
+
+static int index_start(jsonpg_parser p)
+{
+        if(!p->index) {
+                p->index = al_alloc(p->allocator, sizeof(struct index_s));
+                if(!p->index)
+                        return -1;
+        }
+        index_restart(p->index, p->current);
+
+        p->state = expect_value;
+        return 0;
+}
+
+/*
+ * Returns the start of the next token or NULL at the end of input
+ */
+static uint8_t *index_next_token(jsonpg_parser p)
+{
+        struct index_s *x = p->index;
+
+        // Bytes straight after a literal or number
+        // are only in the index when they start a new token
+        uint8_t *current = (p->current < p->last && !whitespace_byte(*p->current))
+                ? p->current
+                : NULL;
+
+        while(1) {
+                while(x->next < x->count) {
+                        uint8_t *pos = x->base + x->positions[x->next];
+                        if(pos < p->current) {
+                                x->next++;
+                                continue;
+                        }
+                        if(current && pos != current)
+                                return current;
+                        x->next++;
+                        return pos;
+                }
+                if(x->scanned >= p->last)
+                        return current;
+                index_scan(p);
+        }
+}
+
+/*
+ * Returns the closing quote for the opening quote at p->current
+ * if stage 1 found no escapes or control characters in the string
+ * and any multi byte UTF-8 in it is valid
+ */
+static uint8_t *index_plain_string(jsonpg_parser p)
+{
+        struct index_s *x = p->index;
+        if(x->next == x->count)
+                return NULL;
+
+        size_t open = p->current - x->base;
+        size_t close = x->positions[x->next];
+        if(x->base[close] != '"')
+                return NULL;
+        uint8_t dirty = 0;
+        for(size_t block = open / INDEX_BLOCK ; block <= close / INDEX_BLOCK ; block++)
+                dirty |= x->dirty[block];
+        if((dirty & DIRTY_ESCAPE)
+                        || ((dirty & DIRTY_UTF8)
+                                && !valid_utf8(x->base + open + 1, close - open - 1)))
+                return NULL;
+
+        x->next++;
+        return x->base + close;
+}
+
+static jsonpg_type index_literal(jsonpg_parser p, char *literal, jsonpg_type type)
+{
+        for( ; *literal ; literal++, p->current++) {
+                if(p->current == p->last || *p->current != *literal)
+                        return parse_error(p);
+        }
+        return type;
+}
+
+static int is_digit(uint8_t c)
+{
+        return c >= '0' && c <= '9';
+}
+
+static jsonpg_type index_number(jsonpg_parser p)
+{
+        struct token_s t = { .type = token_integer, .pos = p->current };
+        uint8_t *pos = p->current;
+        const uint8_t *last = p->last;
+
+        if(*pos == '-')
+                pos++;
+        if(pos < last && *pos == '0') {
+                pos++;
+        } else if(pos < last && is_digit(*pos)) {
+                while(pos < last && is_digit(*pos))
+                        pos++;
+        } else {
+                p->current = pos;
+                return parse_error(p);
+        }
+
+        if(pos < last && *pos == '.') {
+                t.type = token_real;
+                if(++pos == last || !is_digit(*pos)) {
+                        p->current = pos;
+                        return parse_error(p);
+                }
+                while(pos < last && is_digit(*pos))
+                        pos++;
+        }
+
+        if(pos < last && (*pos == 'e' || *pos == 'E')) {
+                t.type = token_real;
+                if(++pos < last && (*pos == '+' || *pos == '-'))
+                        pos++;
+                if(pos == last || !is_digit(*pos)) {
+                        p->current = pos;
+                        return parse_error(p);
+                }
+                while(pos < last && is_digit(*pos))
+                        pos++;
+        }
+
+        p->current = pos;
+        return (t.type == token_real)
+                ? accept_real(p, &t)
+                : accept_integer(p, &t);
+}
+
+/*
+ * Returns the length of the valid UTF-8 sequence at pos
+ * or 0 after setting p->current to the byte that makes it invalid
+ */
+static int index_utf8(jsonpg_parser p, uint8_t *pos)
+{
+        uint8_t c = *pos;
+        uint8_t lo = 0x80;
+        uint8_t hi = 0xBF;
+        int cont;
+
+        if(c >= 0xC2 && c <= 0xDF) {
+                cont = 1;
+        } else if(c >= 0xE0 && c <= 0xEF) {
+                cont = 2;
+                if(c == 0xE0)
+                        lo = 0xA0;
+                else if(c == 0xED)
+                        hi = 0x9F;
+        } else if(c >= 0xF0 && c <= 0xF4) {
+                cont = 3;
+                if(c == 0xF0)
+                        lo = 0x90;
+                else if(c == 0xF4)
+                        hi = 0x8F;
+        } else {
+                p->current = pos;
+                return 0;
+        }
+
+        for(int i = 1 ; i <= cont ; i++) {
+                if(pos + i == p->last || pos[i] < lo || pos[i] > hi) {
+                        p->current = pos + i;
+                        return 0;
+                }
+                lo = 0x80;
+                hi = 0xBF;
+        }
+        return cont + 1;
+}
+
+static int hex_value(uint8_t c)
+{
+        if(is_digit(c))
+                return c - '0';
+        if(c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+        if(c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+        return -1;
+}
+
+/*
+ * \uXXXX or a surrogate pair \uXXXX\uXXXX
+ * u points to the first "u"
+ *
+ * Returns a pointer to after the escape, or NULL on error
+ */
+static uint8_t *index_escape_u(jsonpg_parser p, uint8_t *u)
+{
+        int cp[2];
+        int low = 0;
+        uint8_t *hex = u + 1;
+        while(1) {
+                cp[low] = 0;
+                for(int i = 0 ; i < 4 ; i++) {
+                        p->current = hex + i;
+                        int v = (p->current == p->last) ? -1 : hex_value(hex[i]);
+                        if(v < 0
+                                        || (i == 0 && low && v != 0xD)
+                                        || (i == 1 && cp[low] == 0xD
+                                                && (low ? v < 0xC : v >= 0xC))) {
+                                parse_error(p);
+                                return NULL;
+                        }
+                        cp[low] = (cp[low] << 4) | v;
+                }
+                hex += 4;
+                if(low || !IS_1ST_SURROGATE(cp[0]))
+                        break;
+
+                // High surrogate must be followed by \u and low surrogate
+                for(char *s = "\\u" ; *s ; s++, hex++) {
+                        p->current = hex;
+                        if(hex == p->last || *hex != *s) {
+                                parse_error(p);
+                                return NULL;
+                        }
+                }
+                low = 1;
+        }
+
+        int codepoint = low
+                ? surrogate_pair_to_codepoint(cp[0], cp[1])
+                : cp[0];
+        if(write_utf8_codepoint(codepoint, p->write_buf)) {
+                alloc_error(p);
+                return NULL;
+        }
+        return hex;
+}
+
+/*
+ * Decodes the escape sequence at pos (a backslash) into write_buf
+ *
+ * Returns a pointer to after the escape, or NULL on error
+ */
+static uint8_t *index_escape(jsonpg_parser p, uint8_t *pos)
+{
+        static char *escapes = "bfnrt\"\\/";
+
+        p->current = ++pos;
+        if(pos == p->last) {
+                parse_error(p);
+                return NULL;
+        }
+
+        char *c = *pos ? strchr(escapes, *pos) : NULL;
+        if(c) {
+                if(write_c("\b\f\n\r\t\"\\/"[c - escapes])) {
+                        alloc_error(p);
+                        return NULL;
+                }
+                return pos + 1;
+        } else if(*pos == 'u') {
+                return index_escape_u(p, pos);
+        }
+        parse_error(p);
+        return NULL;
+}
+
+/*
+ * String or key starting at the opening quote at p->current
+ */
+static jsonpg_type index_string(jsonpg_parser p, jsonpg_type type)
+{
+        uint8_t *start = p->current + 1;
+        uint8_t *pos = index_plain_string(p);
+        const uint8_t *last = p->last;
+
+        if(pos) {
+                p->current = pos + 1;
+                p->result.string.bytes = start;
+                p->result.string.length = pos - start;
+                return type;
+        }
+
+        pos = start;
+        while(1) {
+                pos = scan_string(pos, last, '"');
+                if(pos == last) {
+                        p->current = pos;
+                        return parse_error(p);
+                }
+                if(*pos == '"')
+                        break;
+
+                if(*pos == '\\') {
+                        if(write_b(start, pos - start))
+                                return alloc_error(p);
+                        pos = index_escape(p, pos);
+                        if(!pos)
+                                return JSONPG_ERROR;
+                        start = pos;
+                } else if(*pos >= 0x80) {
+                        // Runs of multi byte sequences are validated together,
+                        // index_utf8() finds the position of an invalid one
+                        uint8_t *end = scan_utf8(pos, last);
+                        if(end == pos) {
+                                index_utf8(p, pos);
+                                return parse_error(p);
+                        }
+                        pos = end;
+                } else {
+                        // control character
+                        p->current = pos;
+                        return parse_error(p);
+                }
+        }
+
+        p->current = pos + 1;
+        if(p->write_buf->count) {
+                if(write_b(start, pos - start))
+                        return alloc_error(p);
+                p->result.string.length = get_content(&p->result.string.bytes);
+        } else {
+                p->result.string.bytes = start;
+                p->result.string.length = pos - start;
+        }
+        return type;
+}
+
+static jsonpg_type index_value(jsonpg_parser p)
+{
+        jsonpg_type type;
+
+        p->state = expect_comma_or_close;
+        switch(*p->current) {
+        case '"':
+                return index_string(p, JSONPG_STRING);
+        case 't':
+                return index_literal(p, "true", JSONPG_TRUE);
+        case 'f':
+                return index_literal(p, "false", JSONPG_FALSE);
+        case 'n':
+                return index_literal(p, "null", JSONPG_NULL);
+        case '[':
+                p->state = expect_value_or_close;
+                type = begin_array(p);
+                break;
+        case '{':
+                p->state = expect_key_or_close;
+                type = begin_object(p);
+                break;
+        default:
+                return (*p->current == '-' || is_digit(*p->current))
+                        ? index_number(p)
+                        : parse_error(p);
+        }
+        if(type != JSONPG_ERROR)
+                p->current++;
+        return type;
+}
+
+static jsonpg_type index_close(jsonpg_parser p)
+{
+        jsonpg_type type;
+        int in = peek_stack(&p->stack);
+
+        if(*p->current == '}' && in == STACK_OBJECT)
+                type = end_object(p);
+        else if(*p->current == ']' && in == STACK_ARRAY)
+                type = end_array(p);
+        else
+                return parse_error(p);
+
+        p->current++;
+        p->state = expect_comma_or_close;
+        return type;
+}
+
+/*
+ * Stage 2, called by jsonpg_parse_next() when p->use_index is set
+ */
+static jsonpg_type index_parse_next(jsonpg_parser p)
+{
+        if(p->state == JSONPG_STATE_INITIAL && index_start(p))
+                return alloc_error(p);
+
+        str_buf_reset(p->write_buf);
+
+        while(1) {
+                uint8_t *pos = index_next_token(p);
+                if(!pos) {
+                        p->current = p->last;
+                        return (p->state == expect_comma_or_close
+                                        && p->stack.ptr == p->stack.ptr_min)
+                                ? JSONPG_EOF
+                                : parse_error(p);
+                }
+
+                p->current = pos;
+                switch(p->state) {
+                case expect_colon:
+                        if(*pos != ':')
+                                return parse_error(p);
+                        p->current++;
+                        p->state = expect_value;
+                        break;
+                case expect_comma_or_close:
+                        if(p->stack.ptr == p->stack.ptr_min)
+                                // Only whitespace after top level value
+                                return parse_error(p);
+                        if(*pos != ',')
+                                return index_close(p);
+                        p->current++;
+                        p->state = (peek_stack(&p->stack) == STACK_OBJECT)
+                                ? expect_key
+                                : expect_value;
+                        break;
+                case expect_key_or_close:
+                        if(*pos == '}')
+                                return index_close(p);
+                        // fall through
+                case expect_key:
+                        if(*pos != '"')
+                                return parse_error(p);
+                        p->state = expect_colon;
+                        return index_string(p, JSONPG_KEY);
+                case expect_value_or_close:
+                        if(*pos == ']')
+                                return index_close(p);
+                        // fall through
+                case expect_value:
+                        return index_value(p);
+                default:
+                        return parse_error(p);
+                }
+        }
+}
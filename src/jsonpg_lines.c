@@ -0,0 +1,237 @@
+/*
+ * jsonpg_lines.c
+ *   JSON Lines, one JSON value per line, parsed by a pool of threads
+ *
+ *   workers claim runs of whole lines from the input, each parses its
+ *   lines with its own parser into its own generator and reports each
+ *   record with its index, the line number counting from 0
+ *
+ *   unordered workers claim LINES_BLOCK bytes at a time and report
+ *   records as they finish, ordered workers claim a line at a time
+ *   and wait for their turn to report, so slow records hold up the rest
+ *
+ *   empty lines are not reported, a trailing \r is ignored, a generator
+ *   ends a document after each line, empty or not, so a printer prints
+ *   a record per line
+ *
+ *   uses POSIX threads, link with -pthread
+ */
+#include <pthread.h>
+#include <unistd.h>
+
+#define LINES_BLOCK (64 * 1024)
+
+struct lines_s {
+        jsonpg_lines_config *config;
+        uint8_t *next;          // start of the next unclaimed line
+        uint8_t *last;
+        size_t next_index;
+        size_t delivered;       // ordered, records reported so far
+        int stop;               // 1 stopped by a record, -1 failed
+        pthread_mutex_t lock;
+        pthread_cond_t turn;
+};
+
+struct lines_worker_s {
+        struct lines_s *s;
+        int worker;
+        pthread_t thread;
+};
+
+static size_t lines_count(uint8_t *start, uint8_t *end)
+{
+        size_t count = 0;
+        while(start < end && (start = memchr(start, '\n', end - start))) {
+                start++;
+                count++;
+        }
+        return count;
+}
+
+/*
+ * Claims whole lines from at least size bytes of the remaining input
+ *
+ * Returns 0 when there are none left or the workers are stopping
+ */
+static int lines_claim(struct lines_s *s, size_t size,
+                uint8_t **start, uint8_t **end, size_t *index)
+{
+        pthread_mutex_lock(&s->lock);
+        int claimed = (!s->stop && s->next < s->last);
+        if(claimed) {
+                *start = s->next;
+                *index = s->next_index;
+
+                uint8_t *pos = (size < (size_t)(s->last - s->next))
+                        ? s->next + size - 1
+                        : s->last - 1;
+                uint8_t *eol = memchr(pos, '\n', s->last - pos);
+                *end = eol ? eol + 1 : s->last;
+
+                s->next = *end;
+                s->next_index += (size == 1) ? 1 : lines_count(*start, *end);
+        }
+        pthread_mutex_unlock(&s->lock);
+        return claimed;
+}
+
+static void lines_stop(struct lines_s *s, int stop)
+{
+        pthread_mutex_lock(&s->lock);
+        if(!s->stop)
+                s->stop = stop;
+        pthread_cond_broadcast(&s->turn);
+        pthread_mutex_unlock(&s->lock);
+}
+
+/*
+ * Reports a record, a type of JSONPG_NONE is an empty line that is
+ * not reported but still takes its turn when ordered
+ *
+ * Returns non-zero to stop
+ */
+static int lines_deliver(struct lines_s *s, int worker, size_t index,
+                jsonpg_type type, jsonpg_value *result)
+{
+        jsonpg_lines_config *c = s->config;
+        if(!c->ordered)
+                return type != JSONPG_NONE && c->record
+                        && c->record(c->ctx, worker, index, type, result);
+
+        pthread_mutex_lock(&s->lock);
+        while(s->delivered != index && !s->stop)
+                pthread_cond_wait(&s->turn, &s->lock);
+        int stop = s->stop;
+        pthread_mutex_unlock(&s->lock);
+        if(stop)
+                return stop;
+
+        // Nobody else reports until delivered moves on
+        stop = type != JSONPG_NONE && c->record
+                && c->record(c->ctx, worker, index, type, result);
+
+        pthread_mutex_lock(&s->lock);
+        s->delivered++;
+        if(stop && !s->stop)
+                s->stop = 1;
+        pthread_cond_broadcast(&s->turn);
+        pthread_mutex_unlock(&s->lock);
+        return stop;
+}
+
+/*
+ * Returns JSONPG_NONE for an empty line, the generator still ends a
+ * document for it so printed records keep to their lines
+ */
+static jsonpg_type lines_parse(jsonpg_parser p,
+                uint8_t *line, size_t length, jsonpg_generator g)
+{
+        jsonpg_type type = length
+                ? jsonpg_parse(p, line, length, g)
+                : JSONPG_NONE;
+        if(!g) {
+                while(type != JSONPG_EOF && type != JSONPG_ERROR)
+                        type = jsonpg_parse_next(p);
+                return type;
+        }
+
+        // Also closes what an error left open before the next record
+        if(jsonpg_end_document(g) && type == JSONPG_EOF) {
+                p->result.error.code = JSONPG_ERROR_NONE;
+                p->result.error.at = length;
+                type = JSONPG_ERROR;
+        }
+        return type;
+}
+
+static void *lines_worker(void *arg)
+{
+        struct lines_worker_s *w = arg;
+        struct lines_s *s = w->s;
+        jsonpg_lines_config *c = s->config;
+
+        jsonpg_parser p = jsonpg_parser_new(c->config);
+        jsonpg_generator g = (p && c->generator)
+                ? c->generator(c->ctx, w->worker)
+                : NULL;
+        if(!p || (c->generator && !g)) {
+                lines_stop(s, -1);
+                jsonpg_parser_free(p);
+                return NULL;
+        }
+
+        uint8_t *start, *end;
+        size_t index;
+        size_t size = c->ordered ? 1 : LINES_BLOCK;
+        int stop = 0;
+        while(!stop && lines_claim(s, size, &start, &end, &index)) {
+                for( ; !stop && start < end ; index++) {
+                        uint8_t *eol = memchr(start, '\n', end - start);
+                        uint8_t *line_end = eol ? eol : end;
+                        size_t length = line_end - start;
+                        if(length && line_end[-1] == '\r')
+                                length--;
+
+                        jsonpg_type type = lines_parse(p, start, length, g);
+                        stop = lines_deliver(s, w->worker, index, type,
+                                        &p->result);
+                        start = line_end + 1;
+                }
+        }
+        if(stop)
+                lines_stop(s, stop);
+
+        jsonpg_parser_free(p);
+        return NULL;
+}
+
+/*
+ * Parses each line of input as a separate JSON value using
+ * config->threads workers, one per online CPU if 0
+ *
+ * Returns 0 when every record has been reported, 1 if a record
+ * callback stopped the workers or -1 if a worker could not start
+ */
+int jsonpg_parse_lines(uint8_t *input, size_t length, jsonpg_lines_config *config)
+{
+        int threads = config->threads;
+        if(threads <= 0)
+                threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if(threads <= 0)
+                threads = 1;
+
+        jsonpg_allocator *allocator = allocator_select(NULL);
+        struct lines_worker_s *workers = al_alloc(allocator,
+                        threads * sizeof(struct lines_worker_s));
+        if(!workers)
+                return -1;
+
+        struct lines_s s = {
+                .config = config,
+                .next = input,
+                .last = input + length,
+                .next_index = 0,
+                .delivered = 0,
+                .stop = 0
+        };
+        pthread_mutex_init(&s.lock, NULL);
+        pthread_cond_init(&s.turn, NULL);
+
+        // The calling thread is worker 0, carry on with fewer if need be
+        int started;
+        for(started = 0 ; started < threads ; started++) {
+                workers[started].s = &s;
+                workers[started].worker = started;
+                if(started > 0 && pthread_create(&workers[started].thread,
+                                        NULL, lines_worker, &workers[started]))
+                        break;
+        }
+        lines_worker(&workers[0]);
+        for(int i = 1 ; i < started ; i++)
+                pthread_join(workers[i].thread, NULL);
+
+        pthread_cond_destroy(&s.turn);
+        pthread_mutex_destroy(&s.lock);
+        al_dealloc(allocator, workers);
+        return s.stop;
+}
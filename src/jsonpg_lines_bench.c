@@ -0,0 +1,120 @@
+/*
+ * jsonpg_lines_bench.c
+ *   JSON Lines throughput against the number of threads
+ *
+ *   gcc -O2 -march=native -pthread -o jsonpg_lines_bench jsonpg_lines_bench.c
+ *
+ *   jsonpg_lines_bench <json lines file> [times]
+ *      parses every line of the file with 1, 2, 4... threads up
+ *      to the number of online CPUs, unordered and ordered,
+ *      reporting MB/s of wall time, records and errors
+ *
+ *   a file with one large array can be turned into JSON Lines
+ *   with jq -c '.[]'
+ */
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "jsonpg.c"
+
+#define MAX_THREADS 256
+
+struct counts_s {
+        size_t records;
+        size_t errors;
+        char pad[64];   // one cache line each
+};
+
+static double seconds()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int count_record(void *ctx, int worker, size_t index,
+                jsonpg_type type, jsonpg_value *result)
+{
+        (void)index;
+        (void)result;
+        struct counts_s *counts = ctx;
+        counts[worker].records++;
+        counts[worker].errors += (type == JSONPG_ERROR);
+        return 0;
+}
+
+static void report(uint8_t *json, size_t length, int threads, int ordered, int times)
+{
+        static struct counts_s counts[MAX_THREADS];
+        memset(counts, 0, sizeof(counts));
+        jsonpg_lines_config c = {
+                .threads = threads,
+                .ordered = ordered,
+                .config = NULL,
+                .generator = NULL,
+                .record = count_record,
+                .ctx = counts
+        };
+
+        double start = seconds();
+        for(int i = 0 ; i < times ; i++) {
+                if(jsonpg_parse_lines(json, length, &c)) {
+                        printf("%3d threads %-9s failed\n", threads,
+                                        ordered ? "ordered" : "unordered");
+                        return;
+                }
+        }
+        double elapsed = seconds() - start;
+
+        size_t records = 0, errors = 0;
+        for(int i = 0 ; i < threads ; i++) {
+                records += counts[i].records;
+                errors += counts[i].errors;
+        }
+        printf("%3d threads %-9s %8.1f MB/s %10zu records %6zu errors\n",
+                        threads, ordered ? "ordered" : "unordered",
+                        (double)length * times / elapsed / 1e6,
+                        records / times, errors / times);
+}
+
+int main(int argc, char *argv[])
+{
+        if(argc != 2 && argc != 3) {
+                printf("Usage: jsonpg_lines_bench <json lines file> [times]\n");
+                exit(1);
+        }
+        int times = (argc == 3) ? atoi(argv[2]) : 10;
+
+        int fd = open(argv[1], O_RDONLY);
+        struct stat st;
+        if(fd == -1 || fstat(fd, &st) == -1 || st.st_size == 0) {
+                perror("Failed to open file");
+                exit(1);
+        }
+        uint8_t *json = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(json == MAP_FAILED) {
+                perror("Failed to map file");
+                exit(1);
+        }
+        close(fd);
+
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if(cpus < 1)
+                cpus = 1;
+        else if(cpus > MAX_THREADS)
+                cpus = MAX_THREADS;
+        printf("%s: %zu bytes, %ld CPUs\n", argv[1], (size_t)st.st_size, cpus);
+        for(int threads = 1 ; ; threads *= 2) {
+                if(threads > cpus)
+                        threads = cpus;
+                report(json, st.st_size, threads, 0, times);
+                report(json, st.st_size, threads, 1, times);
+                if(threads == cpus)
+                        break;
+        }
+
+        munmap(json, st.st_size);
+}
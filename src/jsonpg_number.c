@@ -0,0 +1,292 @@
+/*
+ * jsonpg - a JSON parser/generator
+ * © 2025 Bob Davison (see also: LICENSE)
+ *
+ * jsonpg_number.c
+ *   converting the bytes of a JSON number into a long or double
+ *
+ *   numbers are converted from the exact span the parser matched,
+ *   nothing past the end of the span is read so input need not be
+ *   nul terminated, errno plays no part and the locale only matters
+ *   for the rare strtod() fallback
+ *
+ *   reals use Clinger's fast path when the digits and power of ten are
+ *   both exact doubles, otherwise the Eisel-Lemire algorithm with the
+ *   table in jsonpg_pow5.c, both are correctly rounded. Only reals
+ *   with more than 19 significant digits that lie too close to halfway
+ *   between two doubles fall back to strtod()
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <locale.h>
+#include <math.h>
+
+#define NUMBER_MAX_DIGITS       19      // always fit in a uint64_t
+#define NUMBER_NO_INDEX         SIZE_MAX
+#define NUMBER_MAX_EXPONENT     100000  // far beyond any double
+
+// Exactly representable powers of ten
+static const double exact_pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+#define EXACT_POW10_MAX         22
+#define EXACT_MANTISSA_MAX      (1ULL << 53)
+
+// binary64
+#define MANTISSA_BITS           52
+#define EXPONENT_BIAS           1023
+#define EXPONENT_INFINITE       0x7FF
+
+/*
+ * Converts the integer in [pos, end), already matched as
+ * -?(0|[1-9][0-9]*), into *value
+ *
+ * Returns 0 on success or -1 if the value does not fit in a long
+ */
+static int number_integer(const uint8_t *pos, const uint8_t *end, long *value)
+{
+        int negative = (*pos == '-');
+        pos += negative;
+        if(end - pos > NUMBER_MAX_DIGITS)
+                return -1;
+
+        uint64_t u = 0;
+        for( ; pos < end ; pos++)
+                u = u * 10 + (*pos - '0');
+
+        if(u > (uint64_t)LONG_MAX + negative)
+                return -1;
+        *value = negative ? (long)(0 - u) : (long)u;
+        return 0;
+}
+
+/*
+ * Converts a JSON Pointer array index, digits without leading zeros,
+ * for DOM lookups, projections and queries alike
+ *
+ * Returns the index or NUMBER_NO_INDEX if the token is not one
+ */
+static size_t number_index(const uint8_t *token, size_t length)
+{
+        size_t i = 0;
+        size_t digits = 0;
+        while(digits < length && token[digits] >= '0' && token[digits] <= '9')
+                i = i * 10 + (token[digits++] - '0');
+        if(digits == 0 || digits != length || digits > 18
+                        || (token[0] == '0' && length > 1))
+                return NUMBER_NO_INDEX;
+        return i;
+}
+
+/*
+ * A double as its mantissa bits and biased exponent
+ */
+struct number_binary {
+        uint64_t mantissa;
+        int exponent;
+};
+
+static void multiply_64(uint64_t a, uint64_t b, uint64_t *high, uint64_t *low)
+{
+        unsigned __int128 r = (unsigned __int128)a * b;
+        *high = (uint64_t)(r >> 64);
+        *low = (uint64_t)r;
+}
+
+/*
+ * Eisel-Lemire: w * 10^q with w > 0 and enough bits of the
+ * truncated product of w and 5^q to round correctly
+ */
+static struct number_binary number_eisel_lemire(uint64_t w, int q)
+{
+        struct number_binary b = { 0, 0 };
+        if(q < POW5_MIN_EXPONENT)
+                return b;
+        if(q > POW5_MAX_EXPONENT) {
+                b.exponent = EXPONENT_INFINITE;
+                return b;
+        }
+
+        int lz = __builtin_clzll(w);
+        w <<= lz;
+
+        // 55 bits give the mantissa, a rounding bit and a sticky bit
+        const uint64_t *pow5 = pow5_128[q - POW5_MIN_EXPONENT];
+        const uint64_t precision_mask = UINT64_MAX >> 55;
+        uint64_t high, low;
+        multiply_64(w, pow5[0], &high, &low);
+        if((high & precision_mask) == precision_mask) {
+                // The low bits could carry into the mantissa
+                uint64_t high2, low2;
+                multiply_64(w, pow5[1], &high2, &low2);
+                low += high2;
+                if(high2 > low)
+                        high++;
+        }
+
+        int upper_bit = (int)(high >> 63);
+        int shift = upper_bit + 64 - MANTISSA_BITS - 3;
+        b.mantissa = high >> shift;
+        // floor(log2(10^q)) via 217706 / 2^16 ~ log2(10)
+        b.exponent = (((217706 * q) >> 16) + 63) + upper_bit - lz + EXPONENT_BIAS;
+
+        if(b.exponent <= 0) {
+                // subnormal
+                if(-b.exponent + 1 >= 64) {
+                        b.mantissa = 0;
+                        b.exponent = 0;
+                        return b;
+                }
+                b.mantissa >>= -b.exponent + 1;
+                b.mantissa += b.mantissa & 1;
+                b.mantissa >>= 1;
+                b.exponent = (b.mantissa < (1ULL << MANTISSA_BITS)) ? 0 : 1;
+                return b;
+        }
+
+        // An exact halfway value, only possible for small q,
+        // rounds to even rather than up
+        if(low <= 1 && q >= -4 && q <= 23 && (b.mantissa & 3) == 1
+                        && (b.mantissa << shift) == high)
+                b.mantissa &= ~1ULL;
+
+        b.mantissa += b.mantissa & 1;
+        b.mantissa >>= 1;
+        if(b.mantissa >= (2ULL << MANTISSA_BITS)) {
+                b.mantissa = 1ULL << MANTISSA_BITS;
+                b.exponent++;
+        }
+        b.mantissa &= ~(1ULL << MANTISSA_BITS);
+        if(b.exponent >= EXPONENT_INFINITE) {
+                b.mantissa = 0;
+                b.exponent = EXPONENT_INFINITE;
+        }
+        return b;
+}
+
+static double number_to_double(struct number_binary b, int negative)
+{
+        uint64_t bits = b.mantissa
+                | ((uint64_t)b.exponent << MANTISSA_BITS)
+                | ((uint64_t)negative << 63);
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        return d;
+}
+
+/*
+ * Slow path for reals with too many digits to decide, the span is
+ * copied to be nul terminated and to use the locale's decimal point
+ */
+static int number_strtod(const uint8_t *pos, const uint8_t *end, str_buf buf, double *value)
+{
+        size_t length = end - pos;
+        str_buf_reset(buf);
+        if(str_buf_append(buf, (uint8_t *)pos, length)
+                        || str_buf_append_c(buf, '\0'))
+                return -1;
+
+        char *s = (char *)buf->bytes;
+        char *point = memchr(s, '.', length);
+        if(point)
+                *point = *localeconv()->decimal_point;
+
+        *value = strtod(s, NULL);
+        str_buf_reset(buf);
+        return 0;
+}
+
+/*
+ * Converts the real in [pos, end), already matched as JSON, into *value
+ * buf is scratch space for the slow path
+ *
+ * Returns 0 on success or -1 if the value is not a normal double
+ * (overflows or underflows) or buf cannot grow
+ */
+static int number_real(const uint8_t *pos, const uint8_t *end, str_buf buf, double *value)
+{
+        const uint8_t *start = pos;
+        int negative = (*pos == '-');
+        pos += negative;
+
+        // Up to 19 significant digits, w * 10^q
+        uint64_t w = 0;
+        int64_t q = 0;
+        int digits = 0;
+        int truncated = 0;
+        int fraction = 0;
+        for( ; pos < end ; pos++) {
+                uint8_t c = *pos;
+                if(c == '.') {
+                        fraction = 1;
+                        continue;
+                } else if(c < '0' || c > '9') {
+                        break;
+                }
+                if(w == 0 && c == '0') {
+                        // leading zero
+                        q -= fraction;
+                } else if(digits < NUMBER_MAX_DIGITS) {
+                        w = w * 10 + (c - '0');
+                        digits++;
+                        q -= fraction;
+                } else {
+                        truncated |= (c != '0');
+                        q += !fraction;
+                }
+        }
+
+        if(pos < end) {
+                // exponent
+                int exp_negative = 0;
+                int64_t exponent = 0;
+                pos++;
+                if(*pos == '-' || *pos == '+')
+                        exp_negative = (*pos++ == '-');
+                for( ; pos < end ; pos++)
+                        if(exponent < NUMBER_MAX_EXPONENT)
+                                exponent = exponent * 10 + (*pos - '0');
+                q += exp_negative ? -exponent : exponent;
+        }
+
+        if(w == 0) {
+                *value = negative ? -0.0 : 0.0;
+                return 0;
+        }
+        if(q < -NUMBER_MAX_EXPONENT)
+                q = -NUMBER_MAX_EXPONENT;
+        else if(q > NUMBER_MAX_EXPONENT)
+                q = NUMBER_MAX_EXPONENT;
+
+        double d;
+        if(!truncated && w <= EXACT_MANTISSA_MAX
+                        && q >= -EXACT_POW10_MAX && q <= EXACT_POW10_MAX) {
+                // Clinger: one correctly rounded operation on exact values
+                d = (double)w;
+                d = (q < 0) ? d / exact_pow10[-q] : d * exact_pow10[q];
+                d = negative ? -d : d;
+        } else {
+                struct number_binary b = number_eisel_lemire(w, (int)q);
+                if(truncated) {
+                        // The dropped digits lie between w and w + 1
+                        struct number_binary b1 = number_eisel_lemire(w + 1, (int)q);
+                        if(b.mantissa != b1.mantissa || b.exponent != b1.exponent) {
+                                if(number_strtod(start, end, buf, &d))
+                                        return -1;
+                                goto check;
+                        }
+                }
+                d = number_to_double(b, negative);
+        }
+
+check:
+        // zero here is an underflow
+        if(!isnormal(d))
+                return -1;
+        *value = d;
+        return 0;
+}
@@ -0,0 +1,531 @@
+/*
+ * jsonpg_parallel.c
+ *   one large top level array held in memory parsed by a pool of threads
+ *
+ *   the array is cut into chunks of whole elements at commas guessed
+ *   from the shape of its first element, each chunk is parsed as a run
+ *   of elements (is_array) into a DOM of its own, then the chunks are
+ *   spliced onto the DOM of a DOM generator, or replayed to any other
+ *   generator, in order
+ *
+ *   guesses are checked as they are used, the first chunk starts after
+ *   the [ and a chunk that starts where it should and parses to its end
+ *   must end between elements, so the next starts where it should too.
+ *   A chunk that fails is parsed again together with the next and if
+ *   that fails the parser carries on from the start of the chunk as
+ *   jsonpg_parse() would, skipping the elements before it, so misplaced
+ *   cuts only cost time and errors are found where jsonpg_parse() finds
+ *   them after the same events
+ *
+ *   uses POSIX threads, link with -pthread
+ */
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define PARALLEL_CHUNK_MIN      (1 << 20)
+#define PARALLEL_CHUNKS         4       // per thread, to even out the work
+#define PARALLEL_WINDOW         (1 << 18) // searched for a cut, at most a chunk
+
+// Flags that leave commas between elements as they are in strict JSON
+#define PARALLEL_FLAGS  (JSONPG_FLAG_TRAILING_COMMAS | JSONPG_FLAG_SINGLE_QUOTES)
+
+enum {
+        CHUNK_WAITING,
+        CHUNK_PARSING,
+        CHUNK_DONE
+};
+
+struct chunk_s {
+        uint8_t *start;
+        uint8_t *end;           // the comma after the last element or the ]
+        jsonpg_dom dom;
+        int state;
+        int ok;
+};
+
+// What the first element starts and ends with, elements are alike
+struct shape_s {
+        uint8_t first;
+        uint8_t last;           // 0 for a scalar
+        uint8_t *key;           // first key of an object, with its quotes
+        size_t key_length;
+};
+
+struct parallel_s {
+        uint8_t *input;
+        size_t length;
+        jsonpg_config config;
+        jsonpg_allocator *allocator;    // the caller's parser's
+        jsonpg_allocator locked;        // it under alloc_lock for the threads
+        struct chunk_s *chunks;
+        size_t count;
+        size_t next;            // next chunk to claim
+        int stop;
+        pthread_mutex_t lock;
+        pthread_cond_t done;
+        pthread_mutex_t alloc_lock;
+};
+
+static uint8_t *skip_space(uint8_t *pos, uint8_t *end)
+{
+        while(pos < end && (*pos == ' ' || *pos == '\t'
+                                || *pos == '\n' || *pos == '\r'))
+                pos++;
+        return pos;
+}
+
+// Numbers and booleans match any of their kind
+static uint8_t shape_class(uint8_t c)
+{
+        if(c == '-' || (c >= '0' && c <= '9'))
+                return '0';
+        if(c == 'f')
+                return 't';
+        return c;
+}
+
+static int is_escaped(uint8_t *input, uint8_t *pos)
+{
+        uint8_t *b = pos;
+        while(b > input && b[-1] == '\\')
+                b--;
+        return (pos - b) & 1;
+}
+
+// Returns the closing quote of the string starting at pos or NULL
+static uint8_t *string_end(uint8_t *input, uint8_t *pos, uint8_t *end)
+{
+        while(++pos < end)
+                if(*pos == '"' && !is_escaped(input, pos))
+                        return pos;
+        return NULL;
+}
+
+static void shape_of(struct shape_s *shape, uint8_t *input, uint8_t *first, uint8_t *end)
+{
+        shape->first = shape_class(*first);
+        shape->last = (*first == '{') ? '}'
+                : (*first == '[') ? ']'
+                : (*first == '"') ? '"'
+                : 0;
+        shape->key = NULL;
+        shape->key_length = 0;
+        if(*first == '{') {
+                uint8_t *key = skip_space(first + 1, end);
+                uint8_t *key_end = (key < end && *key == '"')
+                        ? string_end(input, key, end)
+                        : NULL;
+                if(key_end) {
+                        shape->key = key;
+                        shape->key_length = key_end + 1 - key;
+                }
+        }
+}
+
+// Whether the comma at pos looks to be between elements like the first
+static int shape_splits(struct shape_s *shape, uint8_t *input, uint8_t *pos, uint8_t *end)
+{
+        uint8_t *before = pos;
+        while(before > input && (before[-1] == ' ' || before[-1] == '\t'
+                                || before[-1] == '\n' || before[-1] == '\r'))
+                before--;
+        if(before == input || (shape->last && before[-1] != shape->last))
+                return 0;
+
+        uint8_t *next = skip_space(pos + 1, end);
+        if(next == end || shape_class(*next) != shape->first)
+                return 0;
+        if(!shape->key)
+                return 1;
+
+        next = skip_space(next + 1, end);
+        if((size_t)(end - next) < shape->key_length
+                        || memcmp(next, shape->key, shape->key_length))
+                return 0;
+        next = skip_space(next + shape->key_length, end);
+        return next < end && *next == ':';
+}
+
+/*
+ * Returns a comma in [from, limit) that looks to be between elements,
+ * or NULL
+ *
+ * from may be inside a string, the first quote tells, a closing quote
+ * is followed by : , } or ] and an opening one is not. Nor is the depth
+ * known, but elements lie at the least depth reached so the first comma
+ * at the least depth that any is found at is taken
+ */
+static uint8_t *split_find(struct shape_s *shape, uint8_t *input,
+                uint8_t *from, uint8_t *limit, uint8_t *end)
+{
+        uint8_t *quote = from;
+        while(quote < limit && (*quote != '"' || is_escaped(input, quote)))
+                quote++;
+        if(quote < limit) {
+                uint8_t *next = skip_space(quote + 1, end);
+                if(next < end && (*next == ':' || *next == ','
+                                        || *next == '}' || *next == ']'))
+                        from = quote + 1;
+        }
+
+        uint8_t *split = NULL;
+        int in_string = 0;
+        long depth = 0;
+        long split_depth = LONG_MAX;
+        for(uint8_t *pos = from ; pos < limit ; pos++) {
+                switch(*pos) {
+                case '"':
+                        if(!is_escaped(input, pos))
+                                in_string = !in_string;
+                        break;
+                case '{':
+                case '[':
+                        depth += !in_string;
+                        break;
+                case '}':
+                case ']':
+                        depth -= !in_string;
+                        break;
+                case ',':
+                        if(!in_string && depth < split_depth
+                                        && shape_splits(shape, input, pos, end)) {
+                                split = pos;
+                                split_depth = depth;
+                        }
+                }
+        }
+        return split;
+}
+
+/*
+ * Cuts the elements in [first, close) into chunks of about size bytes
+ *
+ * Returns the number of chunks
+ */
+static size_t split_chunks(struct chunk_s *chunks, uint8_t *input,
+                uint8_t *first, uint8_t *close, size_t size)
+{
+        struct shape_s shape;
+        shape_of(&shape, input, first, close);
+
+        size_t count = 0;
+        chunks[0].start = first;
+        for(uint8_t *target = first + size ; target < close ; target += size) {
+                uint8_t *limit = (size_t)(close - target) > PARALLEL_WINDOW
+                        ? target + PARALLEL_WINDOW
+                        : close;
+                uint8_t *comma = split_find(&shape, input, target, limit, close);
+                if(comma) {
+                        chunks[count++].end = comma;
+                        chunks[count].start = comma + 1;
+                }
+        }
+        chunks[count++].end = close;
+
+        for(size_t i = 0 ; i < count ; i++) {
+                chunks[i].dom = NULL;
+                chunks[i].state = CHUNK_WAITING;
+                chunks[i].ok = 0;
+        }
+        return count;
+}
+
+// The parser's allocator need not be safe for threads, an arena is not
+static void *locked_alloc(void *ctx, size_t size)
+{
+        struct parallel_s *s = ctx;
+        pthread_mutex_lock(&s->alloc_lock);
+        void *ptr = al_alloc(s->allocator, size);
+        pthread_mutex_unlock(&s->alloc_lock);
+        return ptr;
+}
+
+static void *locked_realloc(void *ctx, void *ptr, size_t size)
+{
+        struct parallel_s *s = ctx;
+        pthread_mutex_lock(&s->alloc_lock);
+        ptr = al_realloc(s->allocator, ptr, size);
+        pthread_mutex_unlock(&s->alloc_lock);
+        return ptr;
+}
+
+static void locked_free(void *ctx, void *ptr)
+{
+        struct parallel_s *s = ctx;
+        pthread_mutex_lock(&s->alloc_lock);
+        al_dealloc(s->allocator, ptr);
+        pthread_mutex_unlock(&s->alloc_lock);
+}
+
+// Parses the elements in [start, end) into a new DOM for the chunk
+static void chunk_parse(struct parallel_s *s, jsonpg_parser p,
+                struct chunk_s *c, uint8_t *start, uint8_t *end)
+{
+        jsonpg_dom_free(c->dom);
+        c->dom = jsonpg_dom_new_with(p->allocator);
+        jsonpg_generator g = jsonpg_dom_generator(c->dom);
+        jsonpg_type type = JSONPG_NONE;
+        if(g && 0 == jsonpg_dom_input(c->dom, s->input, s->length))
+                type = jsonpg_parse(p, start, end - start, g);
+        jsonpg_generator_free(g);
+        c->ok = (type == JSONPG_EOF);
+}
+
+// Returns the index of a chunk claimed for parsing or count if none
+static size_t chunk_claim(struct parallel_s *s)
+{
+        size_t i = s->count;
+        if(!s->stop && s->next < s->count) {
+                i = s->next++;
+                s->chunks[i].state = CHUNK_PARSING;
+        }
+        return i;
+}
+
+// Called with the lock held, returns with it held
+static void chunk_parse_claimed(struct parallel_s *s, jsonpg_parser p, size_t i)
+{
+        pthread_mutex_unlock(&s->lock);
+        struct chunk_s *c = &s->chunks[i];
+        chunk_parse(s, p, c, c->start, c->end);
+        pthread_mutex_lock(&s->lock);
+        c->state = CHUNK_DONE;
+        pthread_cond_broadcast(&s->done);
+}
+
+static void *parallel_worker(void *arg)
+{
+        struct parallel_s *s = arg;
+        jsonpg_parser p = jsonpg_parser_new(&s->config);
+
+        // Without a parser leave the chunks to the others
+        pthread_mutex_lock(&s->lock);
+        size_t i;
+        while(p && (i = chunk_claim(s)) < s->count)
+                chunk_parse_claimed(s, p, i);
+        pthread_mutex_unlock(&s->lock);
+
+        jsonpg_parser_free(p);
+        return NULL;
+}
+
+// Parses chunks until chunk i is done
+static void parallel_wait(struct parallel_s *s, jsonpg_parser p, size_t i)
+{
+        pthread_mutex_lock(&s->lock);
+        while(s->chunks[i].state != CHUNK_DONE) {
+                size_t claimed = chunk_claim(s);
+                if(claimed < s->count)
+                        chunk_parse_claimed(s, p, claimed);
+                else
+                        pthread_cond_wait(&s->done, &s->lock);
+        }
+        pthread_mutex_unlock(&s->lock);
+}
+
+// The generator stopped at offset, there is no error to report
+static jsonpg_type parallel_stopped(jsonpg_parser p, size_t at)
+{
+        p->result.error.code = JSONPG_ERROR_NONE;
+        p->result.error.at = at;
+        return JSONPG_ERROR;
+}
+
+// Returns non-zero with why in jsonpg_result(p) if it fails
+static int parallel_deliver(struct parallel_s *s, jsonpg_parser p,
+                struct chunk_s *c, jsonpg_generator g)
+{
+        // Straight onto the tape if the strings are where the DOM expects
+        jsonpg_dom dom = g->ctx;
+        if(g->callbacks == &dom_callbacks
+                        && (!c->dom->input_refs || (dom->input == s->input
+                                        && dom->input_length >= s->length))) {
+                if(0 == dom_splice(dom, c->dom))
+                        return 0;
+                p->result.error.code = JSONPG_ERROR_ALLOC;
+                p->result.error.at = c->start - s->input;
+                return -1;
+        }
+        if(JSONPG_EOF == jsonpg_dom_parse(c->dom, g))
+                return 0;
+        parallel_stopped(p, c->start - s->input);
+        return -1;
+}
+
+/*
+ * Parses the input on from element elements of the array with p as
+ * jsonpg_parse() would, the [ and the elements before already generated
+ */
+static jsonpg_type parallel_resume(struct parallel_s *s, jsonpg_parser p,
+                size_t elements, jsonpg_generator g)
+{
+        jsonpg_parse(p, s->input, s->length, NULL);
+        jsonpg_type type = jsonpg_parse_next(p);
+        while(elements-- && type != JSONPG_ERROR) {
+                type = jsonpg_parse_next(p);
+                if(type == JSONPG_BEGIN_ARRAY || type == JSONPG_BEGIN_OBJECT)
+                        type = jsonpg_skip(p);
+        }
+
+        while(type != JSONPG_ERROR) {
+                type = jsonpg_parse_next(p);
+                if(type == JSONPG_EOF)
+                        return JSONPG_EOF;
+                if(type != JSONPG_ERROR && generate(g, type, &p->result))
+                        return parallel_stopped(p, p->current - p->input);
+        }
+        gen_error(g, p->result.error.code, p->result.error.at);
+        return JSONPG_ERROR;
+}
+
+static jsonpg_type parallel_parse(struct parallel_s *s, jsonpg_parser p,
+                jsonpg_parser cp, uint8_t *open, uint8_t *close,
+                jsonpg_generator g)
+{
+        if(jsonpg_begin_array(g))
+                return parallel_stopped(p, open - s->input);
+
+        size_t elements = 0;
+        for(size_t i = 0 ; i < s->count ; i++) {
+                parallel_wait(s, cp, i);
+                struct chunk_s *c = &s->chunks[i];
+
+                // A misplaced cut, again up to the next cut
+                if(!c->ok && i + 1 < s->count)
+                        chunk_parse(s, cp, c, c->start, s->chunks[++i].end);
+                if(!c->ok) {
+                        // An error or cuts far out, the rest in one go
+                        // once chunks being parsed no longer allocate
+                        pthread_mutex_lock(&s->lock);
+                        s->stop = 1;
+                        for(size_t j = i + 1 ; j < s->count ; j++)
+                                while(s->chunks[j].state == CHUNK_PARSING)
+                                        pthread_cond_wait(&s->done, &s->lock);
+                        pthread_mutex_unlock(&s->lock);
+                        return parallel_resume(s, p, elements, g);
+                }
+
+                elements += dom_values(c->dom);
+                if(parallel_deliver(s, p, c, g))
+                        return JSONPG_ERROR;
+                jsonpg_dom_free(c->dom);
+                c->dom = NULL;
+        }
+
+        if(jsonpg_end_array(g))
+                return parallel_stopped(p, close - s->input);
+        return JSONPG_EOF;
+}
+
+/*
+ * Parses input held in memory that is one large array with threads
+ * parsers, one per online CPU if 0, and generates the same events as
+ * jsonpg_parse() in the same order. Given a DOM generator the elements
+ * are spliced onto its DOM without replaying them
+ *
+ * Uses jsonpg_parse() for input too small to share out, that is not an
+ * array, or for a parser with flags other than trailing_commas and
+ * single_quotes
+ *
+ * The threads allocate from the parser's allocator one at a time, so
+ * it may be an arena, but not one the generator allocates from too
+ *
+ * Returns JSONPG_EOF, or JSONPG_ERROR for a parse error, with the
+ * error in jsonpg_result(p) as jsonpg_parse() finds it, or if the
+ * generator stops, with JSONPG_ERROR_NONE at where it stopped
+ */
+jsonpg_type jsonpg_parse_parallel(
+                jsonpg_parser p,
+                uint8_t *json,
+                size_t length,
+                int threads,
+                jsonpg_generator g)
+{
+        if(threads <= 0)
+                threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+        uint8_t *end = json + length;
+        uint8_t *open = skip_space(json + bom_bytes(json, length), end);
+        uint8_t *first = (open < end) ? skip_space(open + 1, end) : end;
+        uint8_t *close = end;
+        while(close > first && (close[-1] == ' ' || close[-1] == '\t'
+                                || close[-1] == '\n' || close[-1] == '\r'))
+                close--;
+        close--;
+
+        size_t size = length / ((size_t)threads * PARALLEL_CHUNKS);
+        if(size < PARALLEL_CHUNK_MIN)
+                size = PARALLEL_CHUNK_MIN;
+        if(!g || threads <= 1 || length < 2 * size
+                        || (p->flags & config_all & ~PARALLEL_FLAGS)
+                        || (p->flags & (JSONPG_FLAG_IS_OBJECT
+                                        | JSONPG_FLAG_IS_ARRAY
+                                        | JSONPG_FLAG_DOCUMENT_SEQUENCE))
+                        || open == end || *open != '['
+                        || close <= first || *close != ']')
+                return jsonpg_parse(p, json, length, g);
+
+        struct parallel_s s = {
+                .input = json,
+                .length = length,
+                .config = {
+                        .stack_size = p->stack.size,
+                        .buffer_size = p->buffer_size,
+                        .flags = (p->flags & PARALLEL_FLAGS) | JSONPG_FLAG_IS_ARRAY
+                },
+                .allocator = p->allocator,
+                .next = 0,
+                .stop = 0
+        };
+        s.locked = (jsonpg_allocator) {
+                .alloc = locked_alloc,
+                .realloc = locked_realloc,
+                .free = locked_free,
+                .ctx = &s
+        };
+        s.config.allocator = &s.locked;
+        pthread_mutex_init(&s.alloc_lock, NULL);
+
+        // Before the threads start and after they end so not locked
+        s.chunks = al_alloc(p->allocator,
+                        (length / size + 1) * sizeof(struct chunk_s));
+        pthread_t *workers = al_alloc(p->allocator, threads * sizeof(pthread_t));
+        jsonpg_parser cp = jsonpg_parser_new(&s.config);
+        if(!s.chunks || !workers || !cp) {
+                al_dealloc(p->allocator, s.chunks);
+                al_dealloc(p->allocator, workers);
+                jsonpg_parser_free(cp);
+                pthread_mutex_destroy(&s.alloc_lock);
+                p->result.error.code = JSONPG_ERROR_ALLOC;
+                p->result.error.at = 0;
+                return JSONPG_ERROR;
+        }
+        s.count = split_chunks(s.chunks, json, first, close, size);
+        pthread_mutex_init(&s.lock, NULL);
+        pthread_cond_init(&s.done, NULL);
+
+        // The calling thread parses too while it waits for chunks in order
+        int started;
+        for(started = 1 ; started < threads ; started++)
+                if(pthread_create(&workers[started], NULL, parallel_worker, &s))
+                        break;
+
+        jsonpg_type type = parallel_parse(&s, p, cp, open, close, g);
+
+        pthread_mutex_lock(&s.lock);
+        s.stop = 1;
+        pthread_mutex_unlock(&s.lock);
+        for(int i = 1 ; i < started ; i++)
+                pthread_join(workers[i], NULL);
+
+        for(size_t i = 0 ; i < s.count ; i++)
+                jsonpg_dom_free(s.chunks[i].dom);
+        pthread_cond_destroy(&s.done);
+        pthread_mutex_destroy(&s.lock);
+        jsonpg_parser_free(cp);
+        pthread_mutex_destroy(&s.alloc_lock);
+        al_dealloc(p->allocator, workers);
+        al_dealloc(p->allocator, s.chunks);
+        return type;
+}
@@ -0,0 +1,135 @@
+/*
+ * jsonpg_parallel_bench.c
+ *   parallel parsing of one large array against the number of threads
+ *
+ *   gcc -O2 -march=native -pthread -o jsonpg_parallel_bench jsonpg_parallel_bench.c
+ *
+ *   jsonpg_parallel_bench <json array file> [times]
+ *      parses the file into a DOM with jsonpg_parse() and with
+ *      jsonpg_parse_parallel() using 1, 2, 4... threads up to the
+ *      number of online CPUs, reporting MB/s of wall time, then
+ *      validates it the same way with jsonpg_validate_parallel()
+ *
+ *   arrays of small alike elements split best, chunks of at least
+ *   1 MB are shared out so the file should be several MB a thread
+ */
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "jsonpg.c"
+
+static double seconds()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Returns MB/s or -1 on error, threads 0 for jsonpg_parse()
+static double parse_rate(jsonpg_parser p, uint8_t *json, size_t length,
+                int threads, int times, size_t *count)
+{
+        double elapsed = 0;
+        for(int i = 0 ; i < times ; i++) {
+                jsonpg_dom dom = jsonpg_dom_new();
+                jsonpg_generator g = jsonpg_dom_generator(dom);
+                if(!g || jsonpg_dom_input(dom, json, length))
+                        return -1;
+
+                double start = seconds();
+                jsonpg_type type = threads
+                        ? jsonpg_parse_parallel(p, json, length, threads, g)
+                        : jsonpg_parse(p, json, length, g);
+                elapsed += seconds() - start;
+
+                jsonpg_cursor c = jsonpg_dom_cursor(dom);
+                *count = jsonpg_cursor_count(&c);
+                jsonpg_generator_free(g);
+                jsonpg_dom_free(dom);
+                if(type != JSONPG_EOF)
+                        return -1;
+        }
+        return (double)length * times / elapsed / 1e6;
+}
+
+// Returns MB/s or -1 if invalid, threads 0 for jsonpg_parse()
+static double validate_rate(jsonpg_parser p, uint8_t *json, size_t length,
+                int threads, int times)
+{
+        double start = seconds();
+        for(int i = 0 ; i < times ; i++) {
+                jsonpg_type type = threads
+                        ? jsonpg_validate_parallel(p, json, length, threads)
+                        : validate(p, json, length);
+                if(type != JSONPG_EOF)
+                        return -1;
+        }
+        return (double)length * times / (seconds() - start) / 1e6;
+}
+
+static void report(jsonpg_parser p, uint8_t *json, size_t length,
+                int threads, int times)
+{
+        size_t count = 0;
+        double rate = parse_rate(p, json, length, threads, times, &count);
+        double valid = validate_rate(p, json, length, threads, times);
+        if(threads)
+                printf("%3d threads", threads);
+        else
+                printf("sequential ");
+        if(rate < 0)
+                printf("      parse error");
+        else
+                printf(" %8.1f MB/s %10zu elements", rate, count);
+        if(valid < 0)
+                printf("      invalid\n");
+        else
+                printf(" %8.1f MB/s validating\n", valid);
+}
+
+int main(int argc, char *argv[])
+{
+        if(argc != 2 && argc != 3) {
+                printf("Usage: jsonpg_parallel_bench <json array file> [times]\n");
+                exit(1);
+        }
+        int times = (argc == 3) ? atoi(argv[2]) : 10;
+
+        int fd = open(argv[1], O_RDONLY);
+        struct stat st;
+        if(fd == -1 || fstat(fd, &st) == -1 || st.st_size == 0) {
+                perror("Failed to open file");
+                exit(1);
+        }
+        uint8_t *json = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(json == MAP_FAILED) {
+                perror("Failed to map file");
+                exit(1);
+        }
+        close(fd);
+
+        jsonpg_parser p = jsonpg_parser_new(NULL);
+        if(!p) {
+                printf("Failed to create parser\n");
+                exit(1);
+        }
+
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if(cpus < 1)
+                cpus = 1;
+        printf("%s: %zu bytes, %ld CPUs\n", argv[1], (size_t)st.st_size, cpus);
+        report(p, json, st.st_size, 0, times);
+        for(int threads = 1 ; ; threads *= 2) {
+                if(threads > cpus)
+                        threads = cpus;
+                report(p, json, st.st_size, threads, times);
+                if(threads == cpus)
+                        break;
+        }
+
+        jsonpg_parser_free(p);
+        munmap(json, st.st_size);
+}
@@ -1,5 +1,7 @@
-#include <math.h>
-#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 // TODO function naming is a mess!
 
@@ -15,7 +17,7 @@
 #define get_content(X)  (str_buf_content(p->write_buf, (X)))
 
 // must be same size and order as token_type
-static int token_type_info[] = {
+static const int token_type_info[] = {
         TOKEN_INFO_DEFAULT,
         TOKEN_INFO_DEFAULT,
         TOKEN_INFO_DEFAULT,
@@ -40,9 +42,20 @@ typedef enum {
         config_unquoted_keys = JSONPG_FLAG_UNQUOTED_KEYS,
         config_unquoted_strings = JSONPG_FLAG_UNQUOTED_STRINGS,
         config_escape_characters = JSONPG_FLAG_ESCAPE_CHARACTERS,
-        config_optional_commas = JSONPG_FLAG_OPTIONAL_COMMAS
+        config_optional_commas = JSONPG_FLAG_OPTIONAL_COMMAS,
+        config_all = 0x7F,
+        config_buffers = JSONPG_FLAG_ADAPTIVE_BUFFER | JSONPG_FLAG_MIRRORED_BUFFER
 } config_flags;
 
+// The jsonpg_parse_next variant for the config flags, in jsonpg_state.c
+static parse_next_fn parse_next_select(uint16_t flags);
+// Frees a parser's projection and finds the key it holds back, in jsonpg_project.c
+static void project_free(struct project_s *s);
+static uint8_t *project_held_key(jsonpg_parser p);
+// Frees a parser's query and finds the strings it keeps, in jsonpg_query.c
+static void query_free(struct query_s *s);
+static int query_holds(jsonpg_parser p, uint8_t *bytes);
+
 static int push_token(jsonpg_parser p, token_type type)
 {
         assert(p->token_ptr < JSONPG_TOKEN_MAX && "Token stack overflow");
@@ -51,14 +64,14 @@ static int push_token(jsonpg_parser p, token_type type)
         t->type = type;
         t->pos = p->current;
 
-        if(token_type_info[type] & TOKEN_INFO_HAS_QUOTE ) {
+        if((token_type_info[type] & TOKEN_INFO_HAS_QUOTE) == TOKEN_INFO_HAS_QUOTE) {
                 // Quoted string/key starts after quote
                 t->pos++;
         } else if(token_type_info[type] & TOKEN_INFO_IS_ESCAPE) {
                 // Copy previous bytes from enclosing string
-                assert(p->token_ptr > 0 && "Push escape token with no enclosing string");
+                assert(p->token_ptr > 1 && "Push escape token with no enclosing string");
 
-                uint8_t *start = p->tokens[p->token_ptr - 1].pos;
+                uint8_t *start = p->tokens[p->token_ptr - 2].pos;
                 if(write_b(start, p->current - start))
                         return -1;
 
@@ -104,25 +117,15 @@ static jsonpg_type end_array(jsonpg_parser p)
 
 static jsonpg_type accept_integer(jsonpg_parser p, token t)
 {
-        errno = 0;
-        long integer = strtol((char *)t->pos, NULL, 10);
-        if(errno) 
+        if(number_integer(t->pos, p->current, &p->result.number.integer))
                 return number_error(p);
-        p->result.number.integer = integer;
         return JSONPG_INTEGER;
 }
 
 static jsonpg_type accept_real(jsonpg_parser p, token t)
 {
-        errno = 0;
-        double real = strtod((char *)t->pos, NULL);
-        if(errno) 
-                return number_error(p);
-
-        if(!(real == 0 || isnormal(real))) 
+        if(number_real(t->pos, p->current, p->write_buf, &p->result.number.real))
                 return number_error(p);
-
-        p->result.number.real = real;
         return JSONPG_REAL;
 }
 
@@ -218,10 +221,11 @@ static int process_escape_u(jsonpg_parser p, token t)
         return 0;
 }
 
-static int input_read(jsonpg_parser p, uint8_t *start)
+static int input_read(jsonpg_parser p, uint8_t *start, uint8_t *end)
 {
        uint8_t *pos = start;
-       int max = p->input_size - (start - p->input);
+       size_t max = end - start;
+       int reads = 0;
        while(max) {
                int l = p->reader->read(p->reader, pos, max);
                if(l < 0)
@@ -230,16 +234,120 @@ static int input_read(jsonpg_parser p, uint8_t *start)
                        break;
                pos += l;
                max -= l;
+               reads++;
        }
        p->last = pos;
        p->current = start;
+
+       // One read filling the buffer means more input was waiting
+       if(reads == 1 && max == 0)
+               p->buffer_pressure++;
        
        return max == 0;
 }
 
+// Returns the oldest input byte a pending token still needs
+static uint8_t *input_keep(jsonpg_parser p)
+{
+        if(p->token_ptr == 0)
+                return p->last;
+        token t = &p->tokens[p->token_ptr - 1];
+        if(token_type_info[t->type] & TOKEN_INFO_IS_SURROGATE)
+                // the entire escape sequence
+                t = &p->tokens[p->token_ptr - 2];
+        return t->pos;
+}
+
+/*
+ * Moves the bytes still needed to the start of a new ring
+ * of at least size bytes
+ */
+static int ring_resize(jsonpg_parser p, size_t size)
+{
+        uint8_t *ring = ring_new(&size);
+        if(!ring)
+                return -1;
+        uint8_t *keep = input_keep(p);
+        memcpy(ring, keep, p->last - keep);
+        for(int i = 0 ; i < p->token_ptr ; i++)
+                p->tokens[i].pos = ring + (p->tokens[i].pos - keep);
+        p->current = ring + (p->current - keep);
+        p->last = ring + (p->last - keep);
+
+        ring_free(p->input, p->input_size);
+        p->input = ring;
+        p->input_size = size;
+        return 0;
+}
+
+/*
+ * Resizes the input buffer keeping its contents and
+ * moving the tokens and positions that point into it
+ */
+static int input_resize(jsonpg_parser p, size_t size)
+{
+        if(p->input_is_ring)
+                return ring_resize(p, size);
+
+        size_t offsets[JSONPG_TOKEN_MAX];
+        for(int i = 0 ; i < p->token_ptr ; i++)
+                offsets[i] = p->tokens[i].pos - p->input;
+        size_t current = p->current - p->input;
+        size_t last = p->last - p->input;
+
+        uint8_t *input = al_realloc(p->allocator, p->input, size);
+        if(!input)
+                return -1;
+        p->input = input;
+        p->input_size = size;
+        for(int i = 0 ; i < p->token_ptr ; i++)
+                p->tokens[i].pos = input + offsets[i];
+        p->current = input + current;
+        p->last = input + last;
+        return 0;
+}
+
+// Full reads or straddling tokens before an adaptive buffer doubles
+#define BUFFER_PRESSURE_MAX 8
+
 static int parser_read_next(jsonpg_parser p)
 {
-        assert(p->input_is_ours && "Cannot write to user supplied buffer");
+        assert((p->input_is_ours || p->input_is_ring)
+                        && "Cannot write to user supplied buffer");
+
+        if(p->token_ptr > 0)
+                p->buffer_pressure++;
+        if((p->flags & JSONPG_FLAG_ADAPTIVE_BUFFER)
+                        && p->buffer_pressure >= BUFFER_PRESSURE_MAX
+                        && p->input_size < JSONPG_BUF_ADAPTIVE_MAX) {
+                if(input_resize(p, 2 * p->input_size))
+                        return -1;
+                p->buffer_pressure = 0;
+        }
+
+        if(p->input_is_ring) {
+                // Pending tokens stay where they are and
+                // input is read on from the end of the last
+                uint8_t *keep = input_keep(p);
+                if(keep >= p->input + p->input_size) {
+                        // Use the first mapping of the same bytes
+                        for(int i = 0 ; i < p->token_ptr ; i++)
+                                if(p->tokens[i].pos >= keep)
+                                        p->tokens[i].pos -= p->input_size;
+                        keep -= p->input_size;
+                        p->last -= p->input_size;
+                }
+                if((size_t)(p->last - keep) == p->input_size) {
+                        // token fills the ring so make it bigger
+                        if(input_resize(p, 2 * p->input_size))
+                                return -1;
+                        keep = p->input;
+                }
+                int l = input_read(p, p->last, keep + p->input_size);
+                if(l >= 0)
+                        p->seen_eof = (l == 0);
+                return l;
+        }
 
         uint8_t *start = p->input;
         if(p->token_ptr > 0) {
@@ -251,19 +359,26 @@ static int parser_read_next(jsonpg_parser p)
                 if(tinfo & TOKEN_INFO_COPY_FORWARD) {
                         // copy bytes from current input needed
                         // for parsing next input
-                        uint8_t *tpos;
+                        token from = t;
                         if(tinfo & TOKEN_INFO_IS_SURROGATE) {
                                 // sub-token of escape_u
                                 // and we need to copy entire escape sequence
                                 assert(p->token_ptr > 1 
                                                 && "Surrogate token without parent");
-                                tpos = p->tokens[p->token_ptr - 2].pos;
-                        } else {
-                                tpos = t->pos;
+                                from = &p->tokens[p->token_ptr - 2];
                         }
-                        while(tpos < p->last)
-                                *start++ = *tpos++;
-                        
+                        size_t count = p->last - from->pos;
+                        size_t offset = t->pos - from->pos;
+                        memmove(start, from->pos, count);
+                        // token fills the buffer so make it bigger
+                        if(count == p->input_size
+                                        && input_resize(p, 2 * p->input_size))
+                                return -1;
+                        // the copied tokens now start at the buffer start
+                        from->pos = p->input;
+                        t->pos = p->input + offset;
+                        start = p->input + count;
+
                 } else if(tinfo & TOKEN_INFO_IS_STRING) {
                         // write string bytes as we are still in a string
                         if(write_b(t->pos, p->last - t->pos))
@@ -271,20 +386,129 @@ static int parser_read_next(jsonpg_parser p)
                         // And adjust token to start of string continuation
                         t->pos = start;
 
+                } else if(tinfo & TOKEN_INFO_IS_ESCAPE) {
+                        // backslash ended the input so the
+                        // escaped character starts the next input
+                        t->pos = start;
                 }
         }
-        int l = input_read(p, start);
+        int l = input_read(p, start, p->input + p->input_size);
         if(l >= 0)
                 p->seen_eof = (l == 0);
 
         return l;
 }
 
+/*
+ * Called when fed input runs out, the bytes of a pending token
+ * that need to be contiguous are kept in feed_buf, string bytes
+ * go to write_buf as with a reader
+ */
+static jsonpg_type feed_park(jsonpg_parser p)
+{
+        str_buf fb = p->feed_buf;
+        uint8_t *start = fb->bytes;
+        size_t count = 0;
+        if(p->token_ptr > 0) {
+                token t = &p->tokens[p->token_ptr - 1];
+                int tinfo = token_type_info[t->type];
+                if(tinfo & TOKEN_INFO_COPY_FORWARD) {
+                        token from = t;
+                        if(tinfo & TOKEN_INFO_IS_SURROGATE)
+                                from = &p->tokens[p->token_ptr - 2];
+                        count = p->last - from->pos;
+                        size_t offset = t->pos - from->pos;
+                        if(p->input == fb->bytes) {
+                                // already kept, the token moves down
+                                memmove(fb->bytes, from->pos, count);
+                                fb->count = count;
+                        } else if(str_buf_append(str_buf_reset(fb), from->pos, count)) {
+                                p->feed_buf = NULL;
+                                return alloc_error(p);
+                        }
+                        start = fb->bytes;
+                        from->pos = start;
+                        t->pos = start + offset;
+
+                } else {
+                        if((tinfo & TOKEN_INFO_IS_STRING)
+                                        && write_b(t->pos, p->last - t->pos))
+                                return alloc_error(p);
+                        // Until the next chunk
+                        t->pos = start;
+                }
+        }
+        fb->count = count;
+        p->input = start;
+        p->input_size = count;
+        p->current = p->last = start + count;
+        return JSONPG_NEED_MORE;
+}
+
 static ssize_t read_fd(jsonpg_reader r, void *buf, size_t count)
 {
         return read(CTX_TO_INT(r->ctx), buf, count);
 }
 
+/*
+ * String values copied out of write_buf by jsonpg_parse_batch(),
+ * blocks are never moved so values stay valid until the next batch
+ */
+#define BATCH_BLOCK_SIZE 4096
+
+struct batch_block_s {
+        struct batch_block_s *next;
+        size_t size;
+        size_t used;
+        uint8_t bytes[];
+};
+
+static uint8_t *batch_copy(jsonpg_parser p, uint8_t *bytes, size_t length)
+{
+        struct batch_block_s *b = p->batch;
+        while(b && b->size - b->used < length)
+                b = b->next;
+        if(!b) {
+                size_t size = (length > BATCH_BLOCK_SIZE) ? length : BATCH_BLOCK_SIZE;
+                b = al_alloc(p->allocator, sizeof(struct batch_block_s) + size);
+                if(!b)
+                        return NULL;
+                b->size = size;
+                b->used = 0;
+                b->next = p->batch;
+                p->batch = b;
+        }
+        uint8_t *copy = b->bytes + b->used;
+        memcpy(copy, bytes, length);
+        b->used += length;
+        return copy;
+}
+
+// Whether a string is in a buffer the next event can overwrite
+static int batch_transient(jsonpg_parser p, jsonpg_string_val *string)
+{
+        if(p->write_buf->count && string->bytes == p->write_buf->bytes)
+                return 1;
+        return string->length
+                && (string->bytes == project_held_key(p)
+                        || query_holds(p, string->bytes));
+}
+
+static void batch_reset(jsonpg_parser p)
+{
+        for(struct batch_block_s *b = p->batch ; b ; b = b->next)
+                b->used = 0;
+}
+
+static void batch_free(jsonpg_parser p)
+{
+        while(p->batch) {
+                struct batch_block_s *next = p->batch->next;
+                al_dealloc(p->allocator, p->batch);
+                p->batch = next;
+        }
+}
+
 jsonpg_parser jsonpg_parser_new(jsonpg_config *config)
 {
         jsonpg_config c = config_select(config); 
@@ -292,19 +516,34 @@ jsonpg_parser jsonpg_parser_new(jsonpg_config *config)
         size_t struct_bytes = sizeof(struct jsonpg_parser_s);
         // 1-8 => 1, 9-16 => 2, etc
         size_t stack_bytes = (c.stack_size + 7) / 8;
-        jsonpg_parser p = pg_alloc(struct_bytes + stack_bytes);
+        jsonpg_parser p = al_alloc(c.allocator, struct_bytes + stack_bytes);
         if(p) {
-                p->write_buf = str_buf_empty();
+                p->allocator = c.allocator;
+                p->write_buf = str_buf_empty(p->allocator);
                 if(!p->write_buf) {
-                        pg_dealloc(p);
+                        al_dealloc(p->allocator, p);
                         return NULL;
                 }
                 p->reader = NULL;
+                p->index = NULL;
+                p->batch = NULL;
+                p->project = NULL;
+                p->query = NULL;
+                p->use_index = 0;
+                p->no_refill = 0;
+                p->skipping = 0;
                 p->input = NULL;
                 p->input_is_ours = 0;
+                p->input_is_mapped = 0;
+                p->input_is_ring = 0;
+                p->input_is_fed = 0;
+                p->feed_buf = NULL;
+                p->input_fd = -1;
+                p->buffer_size = c.buffer_size;
                 p->stack.size = c.stack_size;
                 p->stack.stack = (uint8_t *)(((void *)p) + struct_bytes);
                 p->flags = c.flags;
+                p->parse_next = parse_next_select(c.flags);
 
                 if(c.flags & JSONPG_FLAG_IS_OBJECT) {
                         p->stack.ptr = 0;
@@ -321,14 +560,47 @@ jsonpg_parser jsonpg_parser_new(jsonpg_config *config)
         return p;
 }
 
+static void input_close(jsonpg_parser p)
+{
+        if(p->input_fd != -1) {
+                close(p->input_fd);
+                p->input_fd = -1;
+        }
+}
+
+// Releases input owned by the parser from a previous parse
+static void input_release(jsonpg_parser p)
+{
+        if(p->input_is_ours) {
+                al_dealloc(p->allocator, p->input);
+                p->input = NULL;
+                p->input_is_ours = 0;
+        } else if(p->input_is_mapped) {
+                munmap(p->input, p->input_size);
+                // Nothing more is read from it
+                p->current = p->last;
+                p->input = NULL;
+                p->input_is_mapped = 0;
+        } else if(p->input_is_ring) {
+                ring_free(p->input, p->input_size);
+                p->input = NULL;
+                p->input_is_ring = 0;
+        }
+        input_close(p);
+}
+
 void jsonpg_parser_free(void *ptr) 
 {
         if(ptr) {
                 jsonpg_parser p = ptr;
-                if(p->input_is_ours)
-                        pg_dealloc(p->input);
+                input_release(p);
+                al_dealloc(p->allocator, p->index);
+                batch_free(p);
+                project_free(p->project);
+                query_free(p->query);
                 str_buf_free(p->write_buf);
-                pg_dealloc(p);
+                str_buf_free(p->feed_buf);
+                al_dealloc(p->allocator, p);
         }
 }
 
@@ -338,7 +610,8 @@ static jsonpg_type parse(
 {
         jsonpg_type type;
         int abort = 0;
-        while(!abort && JSONPG_EOF != (type = jsonpg_parse_next(p))) {
+        while(!abort && JSONPG_EOF != (type = jsonpg_parse_next(p))
+                        && JSONPG_NEED_MORE != type) {
                 abort = generate(g, type, &p->result);
         }
 
@@ -348,26 +621,30 @@ static jsonpg_type parse(
 jsonpg_type jsonpg_parse(
                 jsonpg_parser p, 
                 uint8_t *json, 
-                uint32_t length,
+                size_t length,
                 jsonpg_generator g)
 {
         if(p->reader) {
-                pg_dealloc(p->reader);
+                jsonpg_reader_free(p->reader);
                 p->reader = NULL;
         }
         p->write_buf = str_buf_reset(p->write_buf);
-        if(p->input_is_ours)
-                pg_dealloc(p->input);
+        input_release(p);
 
         p->input = p->current = json;
         p->input_size = length;
-        p->input_is_ours = 0;
         p->last = json + length;
         p->seen_eof = 1;
+        p->input_is_fed = 0;
         p->stack.ptr = p->stack.ptr_min;
         p->token_ptr = 0;
+        p->skipping = 0;
         p->state = JSONPG_STATE_INITIAL;
 
+        // Strict JSON held in memory can use the structural index
+        p->use_index = ((p->flags & ~config_buffers)
+                        == JSONPG_FLAG_STRUCTURAL_INDEX);
+
         // Skip leading byte order mark
         p->current += bom_bytes(p->input, p->input_size);
 
@@ -389,21 +666,40 @@ jsonpg_type jsonpg_parse_reader(
                 jsonpg_reader r,
                 jsonpg_generator g)
 {
-        if(!(p->input_is_ours && p->input)) {
-                p->input = pg_alloc(JSONPG_BUF_SIZE);
-                if(!p->input)
-                        return alloc_error(p);
-                p->input_size = JSONPG_BUF_SIZE;
-                p->input_is_ours = 1;
+        // A buffer or ring of our own is reused
+        if(p->input_is_ours || p->input_is_ring)
+                input_close(p);
+        else
+                input_release(p);
+        if(!(p->input_is_ours || p->input_is_ring)) {
+                size_t size = p->buffer_size;
+                uint8_t *ring = (p->flags & JSONPG_FLAG_MIRRORED_BUFFER)
+                        ? ring_new(&size)
+                        : NULL;
+                if(ring) {
+                        p->input = ring;
+                        p->input_size = size;
+                        p->input_is_ring = 1;
+                } else {
+                        p->input = al_alloc(p->allocator, p->buffer_size);
+                        if(!p->input)
+                                return alloc_error(p);
+                        p->input_size = p->buffer_size;
+                        p->input_is_ours = 1;
+                }
         }
+        p->buffer_pressure = 0;
         p->write_buf = str_buf_reset(p->write_buf);
         p->reader = r;
-        int l = input_read(p, p->input);
+        p->use_index = 0;
+        p->input_is_fed = 0;
+        int l = input_read(p, p->input, p->input + p->input_size);
         if(l < 0)
                 return file_read_error(p);
         p->seen_eof = (0 == l);
         p->stack.ptr = p->stack.ptr_min;
         p->token_ptr = 0;
+        p->skipping = 0;
         p->state = JSONPG_STATE_INITIAL;
 
         // Skip leading byte order mark
@@ -416,18 +712,22 @@ jsonpg_type jsonpg_parse_reader(
 
 jsonpg_reader jsonpg_file_reader(int fd)
 {
-        jsonpg_reader r = pg_alloc(sizeof(struct jsonpg_reader_s));
+        jsonpg_allocator *allocator = allocator_select(NULL);
+        jsonpg_reader r = al_alloc(allocator, sizeof(struct jsonpg_reader_s));
         if(!r)
                 return NULL;
         r->read = read_fd;
         r->ctx = INT_TO_CTX(fd);
+        r->allocator = allocator;
 
         return r;
 }
 
-void jsonpg_reader_free(void *p)
+void jsonpg_reader_free(void *ptr)
 {
-        pg_dealloc(p);
+        jsonpg_reader r = ptr;
+        if(r)
+                al_dealloc(allocator_select(r->allocator), r);
 }
 
 jsonpg_type jsonpg_parse_fd(
@@ -441,6 +741,53 @@ jsonpg_type jsonpg_parse_fd(
         return jsonpg_parse_reader(p, r, g);
 }
 
+/*
+ * Parses the file at path, a regular file is mapped into memory and
+ * parsed as one buffer so strings need no copying and there are no
+ * refills, anything else such as a pipe is read with a file reader
+ *
+ * Without a generator the mapping or file is kept until the next
+ * parse or the parser is freed, the file must not be truncated
+ * while it is mapped
+ */
+jsonpg_type jsonpg_parse_file(
+                jsonpg_parser p,
+                char *path,
+                jsonpg_generator g)
+{
+        struct stat st;
+        int fd = open(path, O_RDONLY);
+        if(fd == -1 || fstat(fd, &st) == -1) {
+                if(fd != -1)
+                        close(fd);
+                // Leave no previous input behind the error
+                jsonpg_parse(p, (uint8_t *)"", 0, NULL);
+                return file_read_error(p);
+        }
+
+        jsonpg_type type;
+        uint8_t *input = MAP_FAILED;
+        // Files in /proc and the like report a size of 0
+        if(S_ISREG(st.st_mode) && st.st_size > 0)
+                input = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(input != MAP_FAILED) {
+                close(fd);
+                madvise(input, st.st_size, MADV_SEQUENTIAL);
+                type = jsonpg_parse(p, input, st.st_size, NULL);
+                p->input_is_mapped = 1;
+        } else {
+                type = jsonpg_parse_fd(p, fd, NULL);
+                p->input_fd = fd;
+        }
+
+        if(!g || type == JSONPG_ERROR)
+                return type;
+
+        type = parse(p, g);
+        input_release(p);
+        return type;
+}
+
 jsonpg_type jsonpg_parse_stream(
                 jsonpg_parser p, 
                 FILE *stream, 
@@ -449,7 +796,128 @@ jsonpg_type jsonpg_parse_stream(
         return jsonpg_parse_fd(p, fileno(stream), g);
 }
 
+/*
+ * Parses input as it arrives, each chunk is parsed as far as it
+ * goes and JSONPG_NEED_MORE returned when it runs out, a chunk
+ * of length 0 ends the input
+ *
+ * With a generator events are generated for the chunk, otherwise
+ * they are pulled by jsonpg_parse_next() until JSONPG_NEED_MORE
+ * and values can point into the chunk so it must not be reused
+ * until then
+ *
+ * Tokens crossing chunks are kept by the parser, a chunk after
+ * the end of input or an error starts the next document
+ */
+jsonpg_type jsonpg_parse_feed(
+                jsonpg_parser p,
+                uint8_t *chunk,
+                size_t length,
+                jsonpg_generator g)
+{
+        jsonpg_type type = JSONPG_ROOT;
+        if(!p->input_is_fed || p->seen_eof) {
+                if(p->reader) {
+                        jsonpg_reader_free(p->reader);
+                        p->reader = NULL;
+                }
+                p->write_buf = str_buf_reset(p->write_buf);
+                input_release(p);
+                if(!p->feed_buf && !(p->feed_buf = str_buf_empty(p->allocator)))
+                        return alloc_error(p);
+                str_buf_reset(p->feed_buf);
+
+                p->input = p->current = p->last = p->feed_buf->bytes;
+                p->input_size = 0;
+                p->input_is_fed = 1;
+                p->seen_eof = 0;
+                p->use_index = 0;
+                p->stack.ptr = p->stack.ptr_min;
+                p->token_ptr = 0;
+                p->skipping = 0;
+                p->state = JSONPG_STATE_INITIAL;
+
+                // Skip leading byte order mark
+                size_t bom = bom_bytes(chunk, length);
+                chunk += bom;
+                length -= bom;
+        }
+
+        str_buf fb = p->feed_buf;
+        if(length == 0) {
+                // Kept bytes are the last of the input
+                p->seen_eof = 1;
+        } else if(fb->count) {
+                // A token crossing chunks stays contiguous
+                size_t offsets[JSONPG_TOKEN_MAX];
+                for(int i = 0 ; i < p->token_ptr ; i++)
+                        offsets[i] = p->tokens[i].pos - p->input;
+                size_t count = fb->count;
+                if(str_buf_append(fb, chunk, length)) {
+                        p->feed_buf = NULL;
+                        return alloc_error(p);
+                }
+                for(int i = 0 ; i < p->token_ptr ; i++)
+                        p->tokens[i].pos = fb->bytes + offsets[i];
+                p->input = fb->bytes;
+                p->input_size = fb->count;
+                p->current = fb->bytes + count;
+                p->last = fb->bytes + fb->count;
+        } else {
+                p->input = p->current = chunk;
+                p->input_size = length;
+                p->last = chunk + length;
+                // A string or escape carries on from the chunk start
+                if(p->token_ptr > 0)
+                        p->tokens[p->token_ptr - 1].pos = chunk;
+        }
+
+        return g
+                ? parse(p, g)
+                : type;
+}
+
 jsonpg_value jsonpg_result(jsonpg_parser p)
 {
         return p->result;
 }
+
+/*
+ * Fills events with up to max events and returns the number filled
+ *
+ * Stops early after JSONPG_EOF, JSONPG_ERROR or JSONPG_NEED_MORE or
+ * when reading from a reader needs the input buffer refilled, so
+ * strings in earlier events can still point into it. String values
+ * in write_buf are copied, all values remain valid until the next call
+ */
+int jsonpg_parse_batch(jsonpg_parser p, jsonpg_event *events, int max)
+{
+        batch_reset(p);
+        int count = 0;
+        while(count < max) {
+                // Only the first event may refill the input
+                p->no_refill = (count > 0);
+                jsonpg_type type = jsonpg_parse_next(p);
+                if(type == JSONPG_NONE)
+                        break;
+
+                jsonpg_event *e = &events[count++];
+                e->type = type;
+                e->value = p->result;
+                if((type == JSONPG_STRING || type == JSONPG_KEY)
+                                && batch_transient(p, &e->value.string)) {
+                        e->value.string.bytes = batch_copy(p,
+                                        e->value.string.bytes,
+                                        e->value.string.length);
+                        if(!e->value.string.bytes) {
+                                e->type = alloc_error(p);
+                                e->value = p->result;
+                        }
+                }
+                if(e->type == JSONPG_EOF || e->type == JSONPG_ERROR
+                                || e->type == JSONPG_NEED_MORE)
+                        break;
+        }
+        p->no_refill = 0;
+        return count;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #define JSONPG_BUF_SIZE 4096
+#define JSONPG_BUF_ADAPTIVE_MAX (1 << 16)
 
 #define JSONPG_TOKEN_MAX 3 // string/escape_u/surrogate
 
@@ -34,19 +35,46 @@ typedef struct token_s {
 struct str_buf_s;
 typedef struct str_buf_s *str_buf;
 
+struct index_s;
+struct project_s;
+struct query_s;
+struct batch_block_s;
+
+typedef jsonpg_type (*parse_next_fn)(struct jsonpg_parser_s *);
+
 struct jsonpg_parser_s {
         uint8_t seen_eof;
         uint8_t token_ptr;
         uint8_t input_is_ours;
         uint8_t state;
         uint8_t push_state;
+        uint8_t use_index;
+        uint8_t no_refill;
+        uint8_t input_is_mapped;
+        uint8_t input_is_ring;
+        uint8_t input_is_fed;
+        uint8_t buffer_pressure;
+        uint8_t skipping;
+        uint8_t skip_in_string;
+        uint8_t skip_escaped;
         uint16_t flags;
-        uint32_t input_size;
+        uint16_t skip_ptr;
+        uint16_t skip_depth;
+        int input_fd;
+        size_t input_size;
+        size_t buffer_size;
         uint8_t *input;   
         uint8_t *current;
         uint8_t *last;
+        parse_next_fn parse_next;
+        jsonpg_allocator *allocator;
         str_buf write_buf;
+        str_buf feed_buf;
         jsonpg_reader reader;
+        struct index_s *index;
+        struct batch_block_s *batch;
+        struct project_s *project;
+        struct query_s *query;
         jsonpg_value result;
         struct token_s tokens[JSONPG_TOKEN_MAX];
         struct stack_s stack;
@@ -1,15 +1,23 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 #include <math.h>
+#include <sys/uio.h>
 
 // TODO error handling of writer errors
 
-static char number_buffer[32];
-
 typedef struct jsonpg_print_ctx_s *jsonpg_print_ctx;
-typedef int (*write_fn)(void *, uint8_t *, size_t);
-
+typedef int (*write_fn)(void *, struct iovec *, int);
+
+/*
+ * File printers gather output in a buffer after the context and write
+ * it when full, at the end of each root value, on an error, and on
+ * jsonpg_generator_flush() or jsonpg_generator_free()
+ *
+ * Buffer printers have no buffer of their own as every write appends
+ * to the str_buf straight away
+ */
 struct jsonpg_print_ctx_s {
         int level;
         int comma;
@@ -18,8 +26,56 @@ struct jsonpg_print_ctx_s {
         int nl;
         write_fn write;
         void *write_ctx;
+        uint8_t *out;
+        size_t out_size;
+        size_t out_used;
+        char number[32];        // each printer formats numbers in its own
 };
 
+static int print_flush(void *ctx)
+{
+        jsonpg_print_ctx pctx = ctx;
+        if(!pctx->out_used)
+                return 0;
+        struct iovec iov = {
+                .iov_base = pctx->out,
+                .iov_len = pctx->out_used
+        };
+        pctx->out_used = 0;
+        return pctx->write(pctx->write_ctx, &iov, 1);
+}
+
+static int print_write(jsonpg_print_ctx ctx, uint8_t *bytes, size_t count)
+{
+        if(count <= ctx->out_size - ctx->out_used) {
+                memcpy(ctx->out + ctx->out_used, bytes, count);
+                ctx->out_used += count;
+                return 0;
+        }
+
+        // What is buffered and what does not fit after it in one write
+        struct iovec iov[2] = {
+                { .iov_base = ctx->out, .iov_len = ctx->out_used },
+                { .iov_base = bytes, .iov_len = count }
+        };
+        ctx->out_used = 0;
+        if(count < ctx->out_size) {
+                // Small enough to start the next buffer with
+                if(ctx->write(ctx->write_ctx, iov, 1))
+                        return -1;
+                memcpy(ctx->out, bytes, count);
+                ctx->out_used = count;
+                return 0;
+        }
+        return ctx->write(ctx->write_ctx, iov, 2);
+}
+
+// Root values are written out whole
+static int print_done(jsonpg_print_ctx ctx)
+{
+        return ctx->level ? 0 : print_flush(ctx);
+}
+
 static int write_utf8(jsonpg_print_ctx ctx, uint8_t *bytes, size_t count) 
 {
         uint8_t *s = bytes;
@@ -30,6 +86,12 @@ static int write_utf8(jsonpg_print_ctx ctx, uint8_t *bytes, size_t count)
         char *print_p;
         int print_w = 0;
 
+#ifdef JSONPG_VALIDATE_UTF8_OUT
+        // we validate UTF8 from outside, all in one go
+        if(!valid_utf8(bytes, count))
+                return -1;
+#endif
+
         while((s - bytes) < count) {
                 if(*s < 0x20) {
                         print_p = e;
@@ -71,41 +133,32 @@ static int write_utf8(jsonpg_print_ctx ctx, uint8_t *bytes, size_t count)
                         }
                         s++;
                 } else {
+                        // multi byte UTF8 is written as is, stuff from
+                        // inside is validated by the parser
                         print_p = NULL;
-                        // we validate UTF8 sequences from outside
-                        // but expect stuff from inside to be validated
-
-#ifdef JSONPG_VALIDATE_UTF8_OUT
-                        int v = valid_utf8_sequence(s, count - (s - bytes));
-                        if(!v)
-                                return -1;
-                        s += v;
-#else
                         s++;
-#endif
-
                 }
                 if(print_p) {
                         // We have to print an escape sequence 
                         // first print stuff we skipped
-                        if(ctx->write(ctx->write_ctx, last_s, s - last_s - 1))
+                        if(print_write(ctx, last_s, s - last_s - 1))
                                 return -1;
                         last_s = s;
-                        if(ctx->write(ctx->write_ctx, (uint8_t *)print_p, print_w))
+                        if(print_write(ctx, (uint8_t *)print_p, print_w))
                                 return -1;
                 }
         }
-        return ctx->write(ctx->write_ctx, last_s, s - last_s);
+        return print_write(ctx, last_s, s - last_s);
 }
 
 static int write_c(jsonpg_print_ctx ctx, char c)
 {
-        return ctx->write(ctx->write_ctx, (uint8_t *)&c, 1);
+        return print_write(ctx, (uint8_t *)&c, 1);
 }
 
 static int write_s(jsonpg_print_ctx ctx, char *s)
 {
-        return ctx->write(ctx->write_ctx, (uint8_t *)s, strlen(s));
+        return print_write(ctx, (uint8_t *)s, strlen(s));
 }
 
 static int print_indent(jsonpg_print_ctx ctx)
@@ -179,7 +232,7 @@ static int print_boolean(void *ctx, int is_true)
         if(print_prefix(ctx)
                         || write_s(ctx, is_true ? "true" : "false"))
                 return -1;
-        return 0;
+        return print_done(ctx);
 }
 
 static int print_null(void *ctx) 
@@ -187,30 +240,32 @@ static int print_null(void *ctx)
         if(print_prefix(ctx)
                         || write_s(ctx, "null"))
                 return -1;
-        return 0;
+        return print_done(ctx);
 }
 
 static int print_integer(void *ctx, int64_t l) 
 {
+        jsonpg_print_ctx pctx = ctx;
         print_prefix(ctx);
-        int r = snprintf(number_buffer, sizeof(number_buffer), "%ld", l);
+        int r = snprintf(pctx->number, sizeof(pctx->number), "%ld", l);
         if(r < 0) {
                 // TODO better errors
                 return -1;
         }
 
-        write_s(ctx, number_buffer);
-        return 0;
+        write_s(ctx, pctx->number);
+        return print_done(ctx);
 }
 
 static int print_real(void *ctx, double d) 
 {
+        jsonpg_print_ctx pctx = ctx;
         if(!(d == 0 || isnormal(d))) {
                 // TODO better errors
                 return -1;
         }
         print_prefix(ctx);
-        int r = snprintf(number_buffer, sizeof(number_buffer), "%16g", d);
+        int r = snprintf(pctx->number, sizeof(pctx->number), "%16g", d);
         if(r < 0) {
                 // TODO better errors
                 return -1;
@@ -218,7 +273,7 @@ static int print_real(void *ctx, double d)
 
         // snprintf(%16g) writes at the bak of the buffer
         // so we get lots of leading spaces
-        char *s = number_buffer;
+        char *s = pctx->number;
         while(*s == ' ')
                 s++;
         if(write_s(ctx, s))
@@ -226,11 +281,11 @@ static int print_real(void *ctx, double d)
 
         // real number without decimal point or exponent
         // add .0 at the end to preserve type at next JSON decode
-        if(r == strcspn(number_buffer, ".e"))
+        if(r == strcspn(pctx->number, ".e"))
                 if(write_s(ctx, ".0"))
                         return -1;
 
-        return 0;
+        return print_done(ctx);
 }
 
 static int print_string(void *ctx, uint8_t *bytes, size_t length)
@@ -240,7 +295,7 @@ static int print_string(void *ctx, uint8_t *bytes, size_t length)
                         || write_utf8(ctx, bytes, length) 
                         || write_c(ctx, '"'))
                 return -1;
-        return 0;
+        return print_done(ctx);
 }
 
 static int print_key(void *ctx, uint8_t *bytes, size_t length) 
@@ -265,7 +320,7 @@ static int print_end_array(void *ctx)
 {
         if(print_end_prefix(ctx) || write_c(ctx, ']'))
                return -1;
-        return 0;
+        return print_done(ctx);
 }
 
 static int print_begin_object(void *ctx) 
@@ -279,11 +334,24 @@ static int print_end_object(void *ctx)
 {
         if(print_end_prefix(ctx) || write_c(ctx, '}'))
                 return -1;
-        return 0;
+        return print_done(ctx);
+}
+
+// Each document of a sequence on a line of its own
+static int print_end_document(void *ctx)
+{
+        jsonpg_print_ctx pctx = ctx;
+        pctx->level = 0;
+        pctx->comma = 0;
+        pctx->key = 0;
+        pctx->nl = 0;
+        return write_c(ctx, '\n') || print_flush(ctx);
 }
 
+// What was printed before the error is written out first
 static int print_error(void *ctx, jsonpg_error_code code, int at)
 {
+        print_flush(ctx);
         fprintf(stderr, "\nError: %d [%d]", code, at);
         return -1;
 }
@@ -300,15 +368,20 @@ static jsonpg_callbacks printer_callbacks = {
         .end_array = print_end_array,
         .begin_object = print_begin_object,
         .end_object = print_end_object,
-        .error = print_error
+        .error = print_error,
+        .end_document = print_end_document,
+        .flush = print_flush
 };
 
-static jsonpg_generator print_generator(write_fn write, void *write_ctx, int pretty, int stack_size)
+static jsonpg_generator print_generator(write_fn write, void *write_ctx,
+                int pretty, int stack_size, size_t buffer_size,
+                jsonpg_allocator *allocator)
 {
-        jsonpg_generator g = jsonpg_generator_new(
+        jsonpg_generator g = jsonpg_generator_new_with(
                         &printer_callbacks, 
-                        sizeof(struct jsonpg_print_ctx_s),
-                        stack_size);
+                        sizeof(struct jsonpg_print_ctx_s) + buffer_size,
+                        stack_size,
+                        allocator);
         if(!g)
                 return NULL;
 
@@ -321,52 +394,88 @@ static jsonpg_generator print_generator(write_fn write, void *write_ctx, int pre
         ctx->nl = 0;
         ctx->write = write;
         ctx->write_ctx = write_ctx;
+        ctx->out = (uint8_t *)(ctx + 1);
+        ctx->out_size = buffer_size;
+        ctx->out_used = 0;
 
         return g;
 }
 
-static int write_fd(void *ctx, uint8_t *bytes, size_t count)
+static int write_fd(void *ctx, struct iovec *iov, int count)
 {
         int fd = CTX_TO_INT(ctx);
-        uint8_t *start = bytes;
-        size_t size = count;
-        while(size) {
-                size_t w = write(fd, start, size);
+        while(count) {
+                ssize_t w = writev(fd, iov, count);
                 if(w < 0) {
+                        if(errno == EINTR)
+                                continue;
                         // TODO errors
                         return -1;
                 }
-                start += w;
-                size -= w;
+                // Past what was written, partly into the last iovec
+                while(count && (size_t)w >= iov->iov_len) {
+                        w -= iov->iov_len;
+                        iov++;
+                        count--;
+                }
+                if(count) {
+                        iov->iov_base = (uint8_t *)iov->iov_base + w;
+                        iov->iov_len -= w;
+                }
         }
         return 0;
 }
 
+/*
+ * A printer writing to fd through a buffer of buffer_size bytes, 0 to
+ * write each piece as it is printed
+ */
+jsonpg_generator jsonpg_file_printer_sized(int fd, int pretty, int stack_size,
+                size_t buffer_size)
+{
+        return print_generator(write_fd, INT_TO_CTX(fd), pretty, stack_size,
+                        buffer_size, NULL);
+}
+
 jsonpg_generator jsonpg_file_printer(int fd, int pretty, int stack_size)
 {
-        return print_generator(write_fd, INT_TO_CTX(fd), pretty, stack_size);
+        return jsonpg_file_printer_sized(fd, pretty, stack_size,
+                        JSONPG_PRINT_BUFFER_SIZE);
 }
 
+// Writes what stream has buffered first as the printer bypasses it
 jsonpg_generator jsonpg_stream_printer(FILE *stream, int pretty, int stack_size)
 {
+        fflush(stream);
         return jsonpg_file_printer(fileno(stream), pretty, stack_size);
 }
 
-int write_buffer(void *ctx, uint8_t *bytes, size_t count)
+int write_buffer(void *ctx, struct iovec *iov, int count)
 {
         str_buf sbuf = ctx;
-        return str_buf_append(sbuf, bytes, count);
+        for(int i = 0 ; i < count ; i++)
+                if(str_buf_append(sbuf, iov[i].iov_base, iov[i].iov_len))
+                        return -1;
+        return 0;
 }
 
+// Allocated with the buffer's allocator
 jsonpg_generator jsonpg_buffer_printer(str_buf sbuf, int pretty, int stack_size)
 {
-        return print_generator(write_buffer, sbuf, pretty, stack_size);
+        return print_generator(write_buffer, sbuf, pretty, stack_size, 0,
+                        sbuf->allocator);
 }
 
 
 str_buf jsonpg_buffer_new(uint32_t size)
 {
-        return str_buf_new(size);
+        return str_buf_new(size, allocator_select(NULL));
+}
+
+// A buffer allocating with allocator, NULL for the default
+str_buf jsonpg_buffer_new_with(uint32_t size, jsonpg_allocator *allocator)
+{
+        return str_buf_new(size, allocator_select(allocator));
 }
 
 char *jsonpg_buffer_string(str_buf sbuf)
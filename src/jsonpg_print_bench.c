@@ -0,0 +1,111 @@
+/*
+ * jsonpg_print_bench.c
+ *   printing to a file descriptor with and without an output buffer
+ *
+ *   gcc -O2 -march=native -o jsonpg_print_bench jsonpg_print_bench.c
+ *
+ *   jsonpg_print_bench <json file> [output file] [times]
+ *      parses the file into a DOM once then prints the DOM to the
+ *      output file, /dev/null by default, with jsonpg_file_printer_sized()
+ *      writing each piece as it is printed and through buffers of
+ *      4K, 64K and 1M, compact and pretty, reporting MB/s printed
+ */
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "jsonpg.c"
+
+static double seconds()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Returns the length of the DOM printed or 0 on error
+static size_t print_length(jsonpg_dom dom, int pretty)
+{
+        jsonpg_buffer b = jsonpg_buffer_new(0);
+        jsonpg_generator g = jsonpg_buffer_printer(b, pretty, 0);
+        size_t length = 0;
+        if(g && JSONPG_ERROR != jsonpg_dom_parse(dom, g))
+                length = strlen(jsonpg_buffer_string(b));
+        jsonpg_generator_free(g);
+        jsonpg_buffer_free(b);
+        return length;
+}
+
+// Returns MB/s printed or -1 on error
+static double print_rate(jsonpg_dom dom, char *output, int pretty,
+                size_t buffer_size, int times)
+{
+        size_t length = print_length(dom, pretty);
+        double start = seconds();
+        for(int i = 0 ; i < times ; i++) {
+                int fd = open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if(fd == -1)
+                        return -1;
+                jsonpg_generator g = jsonpg_file_printer_sized(fd, pretty, 0,
+                                buffer_size);
+                jsonpg_type type = g ? jsonpg_dom_parse(dom, g) : JSONPG_ERROR;
+                jsonpg_generator_free(g);
+                close(fd);
+                if(type == JSONPG_ERROR)
+                        return -1;
+        }
+        return (double)length * times / (seconds() - start) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+        if(argc < 2 || argc > 4) {
+                printf("Usage: jsonpg_print_bench <json file> [output file] [times]\n");
+                exit(1);
+        }
+        char *output = (argc > 2) ? argv[2] : "/dev/null";
+        int times = (argc > 3) ? atoi(argv[3]) : 5;
+
+        int fd = open(argv[1], O_RDONLY);
+        struct stat st;
+        if(fd == -1 || fstat(fd, &st) == -1 || st.st_size == 0) {
+                perror("Failed to open file");
+                exit(1);
+        }
+        uint8_t *json = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(json == MAP_FAILED) {
+                perror("Failed to map file");
+                exit(1);
+        }
+        close(fd);
+
+        jsonpg_parser p = jsonpg_parser_new(NULL);
+        jsonpg_dom dom = jsonpg_dom_new();
+        jsonpg_generator g = jsonpg_dom_generator(dom);
+        if(!p || !g || JSONPG_ERROR == jsonpg_parse(p, json, st.st_size, g)) {
+                printf("Failed to parse file\n");
+                exit(1);
+        }
+
+        size_t sizes[] = { 0, 4096, 65536, 1 << 20 };
+        printf("%s: %zu bytes to %s\n", argv[1], (size_t)st.st_size, output);
+        for(int pretty = 0 ; pretty < 2 ; pretty++) {
+                for(size_t i = 0 ; i < sizeof(sizes) / sizeof(sizes[0]) ; i++) {
+                        double rate = print_rate(dom, output, pretty, sizes[i],
+                                        times);
+                        printf("%-7s %8zu buffer ", pretty ? "pretty" : "compact",
+                                        sizes[i]);
+                        if(rate < 0)
+                                printf("     error\n");
+                        else
+                                printf("%8.1f MB/s\n", rate);
+                }
+        }
+
+        jsonpg_generator_free(g);
+        jsonpg_dom_free(dom);
+        jsonpg_parser_free(p);
+        munmap(json, st.st_size);
+}
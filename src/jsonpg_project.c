@@ -0,0 +1,619 @@
+/*
+ * jsonpg_project.c
+ *   projections, events only for the values at a set of paths
+ *
+ *   paths are JSON Pointers, "/a/0/b", or simple JSONPaths, "$.a[0].b"
+ *   or "$['a'][*]", where * is every member or element, up to
+ *   PROJECT_PATHS_MAX compiled into a jsonpg_projection that any
+ *   number of parsers can share
+ *
+ *   a parser with a projection gives jsonpg_parse_next() and so its
+ *   generators the events of the values at the paths, along with the
+ *   objects, arrays and keys leading to them so what is left is still
+ *   one JSON value, objects and arrays on the way to a path are kept
+ *   even when nothing in them matches, scalars only when they match
+ *
+ *   the paths matching each open container are kept as a bit mask a
+ *   level, members and elements no path leads into are skipped with
+ *   jsonpg_skip()'s scanner and a container that nothing more can match
+ *   in has the rest of it skipped, keys being taken to be unique
+ *
+ *   once nothing more can match anywhere the open containers are ended
+ *   and JSONPG_EOF returned, the rest of the input is neither read nor
+ *   checked, a fed parser starts a new document with the next chunk
+ */
+
+#define PROJECT_PATHS_MAX 64
+#define PROJECT_NO_INDEX NUMBER_NO_INDEX
+
+struct project_step_s {
+        uint8_t *key;           // member name, NULL for an index or *
+        size_t length;
+        size_t index;           // element index or PROJECT_NO_INDEX
+};
+
+struct project_path_s {
+        int steps;
+        struct project_step_s *step;
+        uint8_t *names;         // the steps' keys
+};
+
+struct jsonpg_projection_s {
+        jsonpg_allocator *allocator;    // made and freed with
+        int count;
+        int max_steps;
+        // [n] masks of the paths with n steps, more than n steps,
+        // * as step n and a key as step n
+        uint64_t *ends;
+        uint64_t *longer;
+        uint64_t *any;
+        uint64_t *keyed;
+        struct project_path_s path[PROJECT_PATHS_MAX];
+};
+
+struct project_level_s {
+        uint64_t active;        // paths leading into the container
+        uint64_t seen;          // object, paths whose key has been seen
+        size_t index;           // array, index of the next element
+        size_t limit;           // array, elements that can still match
+        uint8_t is_object;
+        uint8_t implied;        // JSONPG_FLAG_IS_OBJECT or IS_ARRAY
+};
+
+enum {
+        PROJECT_EVENTS,
+        PROJECT_KEY,            // key kept back until its value starts
+        PROJECT_HELD,           // key returned, value event held
+        PROJECT_SKIP,           // skipping a value
+        PROJECT_CLOSE,          // skipping the rest of the container
+        PROJECT_END,            // ending the open containers
+        PROJECT_DONE
+};
+
+struct project_s {
+        jsonpg_projection projection;
+        jsonpg_allocator *allocator;    // the parser's
+        int depth;              // levels open, 0 between values
+        uint8_t phase;
+        uint8_t check;          // a value at depth has ended
+        uint8_t dropping;       // jsonpg_skip()
+        jsonpg_type last;
+        size_t nested;          // containers open in a matched value
+        size_t drop;            // containers open in a dropped value
+        uint64_t value;         // paths matching the held key's value
+        jsonpg_type held;
+        jsonpg_value held_result;
+        uint8_t *key;
+        size_t key_length;
+        size_t key_size;
+        struct project_level_s level[];
+};
+
+// A token matches a member with its name or an element with its index
+static int compile_pointer(struct project_path_s *path, char *pointer)
+{
+        uint8_t *names = path->names;
+        while(*pointer == '/') {
+                uint8_t *token = (uint8_t *)++pointer;
+                size_t length = strcspn(pointer, "/");
+                pointer += length;
+
+                // ~1 is '/' and ~0 is '~'
+                struct project_step_s *step = &path->step[path->steps++];
+                step->key = names;
+                for(size_t i = 0 ; i < length ; i++) {
+                        if(token[i] == '~' && i + 1 < length
+                                        && (token[i + 1] == '0' || token[i + 1] == '1'))
+                                *names++ = (token[++i] == '0') ? '~' : '/';
+                        else
+                                *names++ = token[i];
+                }
+                step->length = names - step->key;
+                step->index = number_index(step->key, step->length);
+        }
+        return *pointer ? -1 : 0;
+}
+
+// .name, .*, ['name'], ["name"], [0] and [*] after $
+static int compile_jsonpath(struct project_path_s *path, char *jsonpath)
+{
+        uint8_t *names = path->names;
+        char *s = jsonpath + 1;
+        while(*s) {
+                struct project_step_s *step = &path->step[path->steps++];
+                step->key = NULL;
+                step->length = 0;
+                step->index = PROJECT_NO_INDEX;
+
+                if(s[0] == '.' && s[1] == '*') {
+                        s += 2;
+                } else if(s[0] == '.') {
+                        size_t length = strcspn(++s, ".[");
+                        if(length == 0)
+                                return -1;
+                        step->key = names;
+                        step->length = length;
+                        memcpy(names, s, length);
+                        names += length;
+                        s += length;
+                } else if(s[0] == '[' && s[1] == '*' && s[2] == ']') {
+                        s += 3;
+                } else if(s[0] == '[' && (s[1] == '\'' || s[1] == '"')) {
+                        char quote = s[1];
+                        step->key = names;
+                        for(s += 2 ; *s && *s != quote ; s++) {
+                                if(*s == '\\' && s[1])
+                                        s++;
+                                *names++ = *s;
+                        }
+                        if(s[0] != quote || s[1] != ']')
+                                return -1;
+                        step->length = names - step->key;
+                        s += 2;
+                } else if(s[0] == '[') {
+                        size_t length = strspn(++s, "0123456789");
+                        step->index = number_index((uint8_t *)s, length);
+                        if(step->index == PROJECT_NO_INDEX || s[length] != ']')
+                                return -1;
+                        s += length + 1;
+                } else {
+                        return -1;
+                }
+        }
+        return 0;
+}
+
+void jsonpg_projection_free(void *ptr)
+{
+        if(ptr) {
+                jsonpg_projection j = ptr;
+                for(int i = 0 ; i < j->count ; i++) {
+                        al_dealloc(j->allocator, j->path[i].step);
+                        al_dealloc(j->allocator, j->path[i].names);
+                }
+                al_dealloc(j->allocator, j->ends);
+                al_dealloc(j->allocator, j);
+        }
+}
+
+static int projection_masks(jsonpg_projection j)
+{
+        int n = j->max_steps + 1;
+        j->ends = al_alloc(j->allocator, 4 * n * sizeof(uint64_t));
+        if(!j->ends)
+                return -1;
+        memset(j->ends, 0, 4 * n * sizeof(uint64_t));
+        j->longer = j->ends + n;
+        j->any = j->longer + n;
+        j->keyed = j->any + n;
+
+        for(int i = 0 ; i < j->count ; i++) {
+                struct project_path_s *path = &j->path[i];
+                uint64_t bit = 1ULL << i;
+                j->ends[path->steps] |= bit;
+                for(int s = 0 ; s < path->steps ; s++) {
+                        j->longer[s] |= bit;
+                        if(path->step[s].key)
+                                j->keyed[s] |= bit;
+                        else if(path->step[s].index == PROJECT_NO_INDEX)
+                                j->any[s] |= bit;
+                }
+        }
+        return 0;
+}
+
+/*
+ * Compiles count paths, each a JSON Pointer, "" or starting with '/',
+ * or a JSONPath starting with '$'
+ *
+ * Returns NULL for more than PROJECT_PATHS_MAX paths, a path that is
+ * neither or on failing to allocate
+ */
+jsonpg_projection jsonpg_projection_new(char **paths, int count)
+{
+        if(count < 0 || count > PROJECT_PATHS_MAX)
+                return NULL;
+
+        jsonpg_allocator *allocator = allocator_select(NULL);
+        jsonpg_projection j = al_alloc(allocator,
+                        sizeof(struct jsonpg_projection_s));
+        if(!j)
+                return NULL;
+        j->allocator = allocator;
+        j->count = 0;
+        j->max_steps = 0;
+        j->ends = NULL;
+
+        for(int i = 0 ; i < count ; i++) {
+                struct project_path_s *path = &j->path[i];
+                // No more steps or name bytes than characters
+                size_t length = strlen(paths[i]);
+                path->steps = 0;
+                path->step = al_alloc(allocator,
+                                (length + 1) * sizeof(struct project_step_s));
+                path->names = al_alloc(allocator, length + 1);
+                j->count++;
+                if(!path->step || !path->names
+                                || (paths[i][0] == '$'
+                                        ? compile_jsonpath(path, paths[i])
+                                        : compile_pointer(path, paths[i]))) {
+                        jsonpg_projection_free(j);
+                        return NULL;
+                }
+                if(path->steps > j->max_steps)
+                        j->max_steps = path->steps;
+        }
+
+        if(projection_masks(j)) {
+                jsonpg_projection_free(j);
+                return NULL;
+        }
+        return j;
+}
+
+static void project_free(struct project_s *s)
+{
+        if(s) {
+                al_dealloc(s->allocator, s->key);
+                al_dealloc(s->allocator, s);
+        }
+}
+
+static uint8_t *project_held_key(jsonpg_parser p)
+{
+        return p->project
+                ? p->project->key
+                : NULL;
+}
+
+static void project_push(struct project_s *s, uint64_t active, int is_object)
+{
+        jsonpg_projection j = s->projection;
+        int n = s->depth++;
+        struct project_level_s *l = &s->level[s->depth];
+        l->active = active;
+        l->seen = 0;
+        l->index = 0;
+        l->limit = 0;
+        l->is_object = is_object;
+        l->implied = 0;
+
+        if(!is_object) {
+                if(active & j->any[n]) {
+                        l->limit = PROJECT_NO_INDEX;
+                } else {
+                        for(uint64_t b = active ; b ; b &= b - 1) {
+                                size_t index = j->path[__builtin_ctzll(b)].step[n].index;
+                                if(index != PROJECT_NO_INDEX && index >= l->limit)
+                                        l->limit = index + 1;
+                        }
+                }
+        }
+        s->check = 1;
+}
+
+// Starts on a document
+static void project_start(jsonpg_parser p, struct project_s *s)
+{
+        jsonpg_projection j = s->projection;
+        s->depth = 0;
+        s->phase = PROJECT_EVENTS;
+        s->check = 0;
+        s->dropping = 0;
+        s->last = JSONPG_NONE;
+        s->nested = 0;
+
+        if(p->flags & (JSONPG_FLAG_IS_OBJECT | JSONPG_FLAG_IS_ARRAY)) {
+                // Everything matches inside the container without end
+                if(j->ends[0]) {
+                        s->nested = 1;
+                } else {
+                        project_push(s, j->longer[0],
+                                        (p->flags & JSONPG_FLAG_IS_OBJECT) != 0);
+                        s->level[1].implied = 1;
+                }
+        }
+}
+
+/*
+ * Projects the parser's events onto a projection's paths, NULL for all
+ * events again, set between parses, the projection must outlive its
+ * use by the parser
+ *
+ * Returns -1 on failing to allocate, leaving the parser without one
+ */
+int jsonpg_parser_project(jsonpg_parser p, jsonpg_projection j)
+{
+        project_free(p->project);
+        p->project = NULL;
+        if(!j)
+                return 0;
+
+        // Levels 1 to max_steps with level 0 for values at the root
+        p->project = al_alloc(p->allocator, sizeof(struct project_s)
+                        + (j->max_steps + 1) * sizeof(struct project_level_s));
+        if(!p->project)
+                return -1;
+        p->project->projection = j;
+        p->project->allocator = p->allocator;
+        p->project->key = NULL;
+        p->project->key_size = 0;
+        project_start(p, p->project);
+        return 0;
+}
+
+// Whether anything more can match in the container at depth
+static int project_possible(struct project_s *s, int depth)
+{
+        jsonpg_projection j = s->projection;
+        struct project_level_s *l = &s->level[depth];
+        return l->is_object
+                ? 0 != (l->active & (j->any[depth - 1] | (j->keyed[depth - 1] & ~l->seen)))
+                : l->index < l->limit;
+}
+
+// Paths through the key of a member of the object at depth
+static uint64_t project_key(struct project_s *s, uint8_t *key, size_t length)
+{
+        jsonpg_projection j = s->projection;
+        int n = s->depth - 1;
+        struct project_level_s *l = &s->level[s->depth];
+        uint64_t matched = l->active & j->any[n];
+        for(uint64_t b = l->active & j->keyed[n] ; b ; b &= b - 1) {
+                int i = __builtin_ctzll(b);
+                struct project_step_s *step = &j->path[i].step[n];
+                if(step->length == length && !memcmp(step->key, key, length))
+                        matched |= 1ULL << i;
+        }
+        l->seen |= matched & ~j->any[n];
+        return matched;
+}
+
+// Paths through the next element of the array at depth
+static uint64_t project_element(struct project_s *s)
+{
+        jsonpg_projection j = s->projection;
+        int n = s->depth - 1;
+        struct project_level_s *l = &s->level[s->depth];
+        size_t index = l->index++;
+        if(index >= l->limit)
+                return 0;
+        uint64_t matched = l->active & j->any[n];
+        for(uint64_t b = l->active & ~j->any[n] ; b ; b &= b - 1) {
+                int i = __builtin_ctzll(b);
+                if(j->path[i].step[n].index == index)
+                        matched |= 1ULL << i;
+        }
+        return matched;
+}
+
+// Whether a value starting with type at depth is kept
+static int project_keeps(struct project_s *s, jsonpg_type type, uint64_t matched)
+{
+        jsonpg_projection j = s->projection;
+        return (matched & j->ends[s->depth])
+                || ((matched & j->longer[s->depth])
+                        && (type == JSONPG_BEGIN_OBJECT || type == JSONPG_BEGIN_ARRAY));
+}
+
+// Starts a kept value
+static jsonpg_type project_value(struct project_s *s, jsonpg_type type, uint64_t matched)
+{
+        jsonpg_projection j = s->projection;
+        int begins = (type == JSONPG_BEGIN_OBJECT || type == JSONPG_BEGIN_ARRAY);
+        if(matched & j->ends[s->depth]) {
+                if(begins)
+                        s->nested = 1;
+                else
+                        s->check = 1;
+        } else {
+                project_push(s, matched & j->longer[s->depth],
+                                type == JSONPG_BEGIN_OBJECT);
+        }
+        return type;
+}
+
+static int project_hold_key(jsonpg_parser p, struct project_s *s)
+{
+        // A byte over so an empty key has bytes to point at too
+        size_t length = p->result.string.length;
+        if(length >= s->key_size) {
+                uint8_t *key = al_realloc(s->allocator, s->key, length + 1);
+                if(!key)
+                        return -1;
+                s->key = key;
+                s->key_size = length + 1;
+        }
+        if(length)
+                memcpy(s->key, p->result.string.bytes, length);
+        s->key_length = length;
+        return 0;
+}
+
+static int project_pauses(jsonpg_type type)
+{
+        return type == JSONPG_NONE || type == JSONPG_NEED_MORE
+                || type == JSONPG_ERROR || type == JSONPG_EOF;
+}
+
+// Whether nothing more can match in any open container
+static int project_finished(jsonpg_parser p, struct project_s *s)
+{
+        if(p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE)
+                return 0;
+        for(int depth = 1 ; depth <= s->depth ; depth++) {
+                if(project_possible(s, depth))
+                        return 0;
+        }
+        return 1;
+}
+
+static jsonpg_type project_next(jsonpg_parser p)
+{
+        struct project_s *s = p->project;
+        if(p->state == JSONPG_STATE_INITIAL)
+                project_start(p, s);
+
+        while(1) {
+                jsonpg_type type;
+                struct project_level_s *l = &s->level[s->depth];
+
+                switch(s->phase) {
+                case PROJECT_DONE:
+                        return JSONPG_EOF;
+
+                case PROJECT_END:
+                        if(s->depth == 0 || l->implied) {
+                                s->phase = PROJECT_DONE;
+                                if(p->input_is_fed)
+                                        p->seen_eof = 1;
+                                return JSONPG_EOF;
+                        }
+                        s->depth--;
+                        type = l->is_object
+                                ? JSONPG_END_OBJECT
+                                : JSONPG_END_ARRAY;
+                        break;
+
+                case PROJECT_KEY:
+                        type = next_event(p);
+                        if(project_pauses(type))
+                                return type;
+                        s->phase = PROJECT_EVENTS;
+                        if(!project_keeps(s, type, s->value)) {
+                                if(type == JSONPG_BEGIN_OBJECT || type == JSONPG_BEGIN_ARRAY)
+                                        goto skip_begun;
+                                s->check = 1;
+                                continue;
+                        }
+                        s->phase = PROJECT_HELD;
+                        s->held = type;
+                        s->held_result = p->result;
+                        p->result.string.bytes = s->key;
+                        p->result.string.length = s->key_length;
+                        type = JSONPG_KEY;
+                        break;
+
+                case PROJECT_HELD:
+                        s->phase = PROJECT_EVENTS;
+                        p->result = s->held_result;
+                        type = project_value(s, s->held, s->value);
+                        break;
+
+                case PROJECT_SKIP:
+                        type = next_event(p);
+                        goto skipped;
+
+                case PROJECT_CLOSE:
+                        type = next_event(p);
+                        goto closed;
+
+                default:
+                        if(s->check && !s->nested) {
+                                s->check = 0;
+                                if(s->depth > 0 && !project_possible(s, s->depth)) {
+                                        if(project_finished(p, s)) {
+                                                s->phase = PROJECT_END;
+                                                continue;
+                                        }
+                                        if(!l->implied) {
+                                                s->phase = PROJECT_CLOSE;
+                                                type = skip_begun(p);
+                                                goto closed;
+                                        }
+                                }
+                        }
+
+                        type = next_event(p);
+                        if(project_pauses(type))
+                                return type;
+
+                        if(s->nested) {
+                                // Inside a matched value
+                                if(type == JSONPG_BEGIN_OBJECT || type == JSONPG_BEGIN_ARRAY)
+                                        s->nested++;
+                                else if(type == JSONPG_END_OBJECT || type == JSONPG_END_ARRAY)
+                                        s->check = (--s->nested == 0);
+                                break;
+                        }
+                        if(type == JSONPG_END_DOCUMENT) {
+                                project_start(p, s);
+                                break;
+                        }
+                        if(type == JSONPG_END_OBJECT || type == JSONPG_END_ARRAY) {
+                                s->depth--;
+                                s->check = 1;
+                                break;
+                        }
+
+                        if(s->depth > 0 && l->is_object) {
+                                s->value = project_key(s, p->result.string.bytes,
+                                                p->result.string.length);
+                                if(!s->value) {
+                                        s->phase = PROJECT_SKIP;
+                                        type = skip_value(p);
+                                        goto skipped;
+                                }
+                                if(project_hold_key(p, s))
+                                        return alloc_error(p);
+                                s->phase = PROJECT_KEY;
+                                continue;
+                        }
+
+                        s->value = (s->depth > 0)
+                                ? project_element(s)
+                                : ~0ULL;
+                        if(project_keeps(s, type, s->value)) {
+                                type = project_value(s, type, s->value);
+                                break;
+                        }
+                        if(type == JSONPG_BEGIN_OBJECT || type == JSONPG_BEGIN_ARRAY)
+                                goto skip_begun;
+                        s->check = 1;
+                        continue;
+                }
+
+        emit:
+                // Drops what jsonpg_skip() skips
+                s->last = type;
+                if(s->dropping) {
+                        if(type == JSONPG_BEGIN_OBJECT || type == JSONPG_BEGIN_ARRAY) {
+                                s->drop++;
+                                continue;
+                        }
+                        if((type == JSONPG_END_OBJECT || type == JSONPG_END_ARRAY) && s->drop)
+                                s->drop--;
+                        if(s->drop)
+                                continue;
+                        s->dropping = 0;
+                }
+                return type;
+
+        skip_begun:
+                s->phase = PROJECT_SKIP;
+                type = skip_begun(p);
+        skipped:
+                if(project_pauses(type))
+                        return type;
+                s->phase = PROJECT_EVENTS;
+                s->check = 1;
+                continue;
+
+        closed:
+                if(project_pauses(type))
+                        return type;
+                s->phase = PROJECT_EVENTS;
+                s->depth--;
+                s->check = 1;
+                goto emit;
+        }
+}
+
+// jsonpg_skip() with a projection, dropping the projected events
+static jsonpg_type project_skip(jsonpg_parser p)
+{
+        struct project_s *s = p->project;
+        s->dropping = 1;
+        s->drop = (s->last == JSONPG_BEGIN_OBJECT || s->last == JSONPG_BEGIN_ARRAY);
+        return project_next(p);
+}
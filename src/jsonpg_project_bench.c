@@ -0,0 +1,87 @@
+/*
+ * jsonpg_project_bench.c
+ *   pulling the events for a few paths against pulling them all
+ *
+ *   gcc -O2 -march=native -o jsonpg_project_bench jsonpg_project_bench.c
+ *
+ *   jsonpg_project_bench <json file> <path>...
+ *      pulls every event of the file with jsonpg_parse_next() and
+ *      then only those for the paths, JSON Pointers or JSONPaths such
+ *      as '$.items[*].id', with a projection, reporting MB/s and events
+ */
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "jsonpg.c"
+
+#define TIMES 10
+
+static double seconds()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(char *name, jsonpg_parser p, uint8_t *json, size_t length)
+{
+        size_t events = 0;
+        jsonpg_type type = JSONPG_NONE;
+        double start = seconds();
+        for(int i = 0 ; i < TIMES ; i++) {
+                events = 0;
+                jsonpg_parse(p, json, length, NULL);
+                do {
+                        type = jsonpg_parse_next(p);
+                        events++;
+                } while(type != JSONPG_EOF && type != JSONPG_ERROR);
+        }
+        double elapsed = seconds() - start;
+
+        printf("%-10s %8.1f MB/s %10zu events%s\n", name,
+                        (double)length * TIMES / elapsed / 1e6, events,
+                        (type == JSONPG_ERROR) ? " parse error" : "");
+}
+
+int main(int argc, char *argv[])
+{
+        if(argc < 3) {
+                printf("Usage: jsonpg_project_bench <json file> <path>...\n");
+                exit(1);
+        }
+
+        int fd = open(argv[1], O_RDONLY);
+        struct stat st;
+        if(fd == -1 || fstat(fd, &st) == -1 || st.st_size == 0) {
+                perror("Failed to open file");
+                exit(1);
+        }
+        uint8_t *json = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(json == MAP_FAILED) {
+                perror("Failed to map file");
+                exit(1);
+        }
+        close(fd);
+
+        jsonpg_parser p = jsonpg_parser_new(NULL);
+        jsonpg_projection j = jsonpg_projection_new(argv + 2, argc - 2);
+        if(!p || !j) {
+                printf("Failed to create parser or projection\n");
+                exit(1);
+        }
+
+        printf("%s: %zu bytes\n", argv[1], (size_t)st.st_size);
+        report("all", p, json, st.st_size);
+        if(jsonpg_parser_project(p, j)) {
+                printf("Failed to project\n");
+                exit(1);
+        }
+        report("projected", p, json, st.st_size);
+
+        jsonpg_parser_free(p);
+        jsonpg_projection_free(j);
+        munmap(json, st.st_size);
+}
@@ -0,0 +1,1479 @@
+/*
+ * jsonpg_query.c
+ *   JSONPath queries run over the events as they are parsed
+ *
+ *   a query such as "$.items[*].price", "$..id" or
+ *   "$.log[?(@.status == 'ok' && @.ms > 100)].id" is compiled into a
+ *   jsonpg_query that any number of parsers can share, a parser with a
+ *   query gives jsonpg_parse_next() and so its generators the value of
+ *   each match followed by JSONPG_END_DOCUMENT, as for a document
+ *   sequence, in the order the values start
+ *
+ *   segments are .name, .*, [selectors] and the descendant ..name, ..*
+ *   and ..[selectors], a selector being 'name' or "name", an index or
+ *   a slice start:end:step counting from the start, * or a filter
+ *   ?expression, names after a dot are letters, digits, _ and - and a
+ *   backslash in a quoted name escapes the character after it
+ *
+ *   filter expressions test each member or element as @, comparing @
+ *   or paths from it such as @.a.b or @['a'][0] with ==, !=, <, <=, >
+ *   and >= to each other or to numbers, strings, true, false and null,
+ *   or testing that a path is there, combined with &&, || and ! and
+ *   grouped with brackets, objects and arrays equal nothing
+ *
+ *   the segments run as an automaton with a bit mask of states for each
+ *   open container, members and elements no state leads into are
+ *   skipped with jsonpg_skip()'s scanner, a container nothing more can
+ *   match in has the rest of it skipped, keys being taken to be unique,
+ *   and once nothing more can match anywhere JSONPG_EOF is returned
+ *   without reading the rest of the input
+ *
+ *   a filter is decided by reading ahead through the value it tests
+ *   until its paths have been found or cannot be, the events read ahead
+ *   are kept, as are matches inside a match that follow it, up to the
+ *   query's buffer limit past which parsing fails with
+ *   JSONPG_ERROR_BUFFER_LIMIT, otherwise memory does not grow with the
+ *   input
+ */
+
+#define QUERY_SEGMENTS_MAX 63
+#define QUERY_SELECTORS_MAX 64
+#define QUERY_OPERANDS_MAX 64
+#define QUERY_BUFFER_LIMIT (16 * 1024 * 1024)
+#define QUERY_LEVELS 16
+
+enum {
+        QUERY_NAME,
+        QUERY_INDEX,
+        QUERY_SLICE,
+        QUERY_WILDCARD,
+        QUERY_FILTER
+};
+
+struct query_selector_s {
+        uint8_t kind;
+        uint8_t *key;           // name
+        size_t length;
+        size_t start;           // index or slice
+        size_t end;             // slice, PROJECT_NO_INDEX for no end
+        size_t step;
+        int filter;             // node at the root of the expression
+};
+
+struct query_segment_s {
+        uint8_t descendant;
+        int first;              // selectors
+        int count;
+        uint64_t names;         // the name selectors
+        uint64_t operands;      // of the filter selectors
+        size_t limit;           // elements the index and slice selectors reach
+};
+
+enum {
+        QUERY_OR,
+        QUERY_AND,
+        QUERY_NOT,
+        QUERY_EXISTS,
+        QUERY_EQ,
+        QUERY_NE,
+        QUERY_LT,
+        QUERY_LE,
+        QUERY_GT,
+        QUERY_GE
+};
+
+struct query_node_s {
+        uint8_t kind;
+        int left;               // nodes, terms for exists and comparisons
+        int right;
+};
+
+struct query_term_s {
+        int operand;            // -1 for a literal
+        jsonpg_type type;
+        jsonpg_value value;
+};
+
+// A path from @
+struct query_operand_s {
+        int steps;
+        struct project_step_s *step;
+};
+
+struct jsonpg_query_s {
+        jsonpg_allocator *allocator;    // made and freed with
+        int segments;
+        int selectors;
+        int operands;
+        int nodes;
+        int terms;
+        int max_steps;          // of an operand
+        size_t buffer_limit;
+        // Masks of the states before the match, the bit after them,
+        // and of the descendant segments and those with selectors
+        // matching any member or elements to the end
+        uint64_t live;
+        uint64_t descendant;
+        uint64_t object_open;
+        uint64_t array_open;
+        uint8_t *names;
+        struct project_step_s *steps;
+        struct query_node_s *node;
+        struct query_term_s *term;
+        struct query_segment_s segment[QUERY_SEGMENTS_MAX];
+        struct query_selector_s selector[QUERY_SELECTORS_MAX];
+        struct query_operand_s operand[QUERY_OPERANDS_MAX];
+};
+
+struct query_compile_s {
+        jsonpg_query query;
+        uint8_t *s;             // next character
+        uint8_t *names;         // next free name byte
+        struct project_step_s *steps;
+};
+
+struct query_level_s {
+        uint64_t states;        // bit i for segment i next
+        uint64_t seen;          // object, name selectors seen
+        size_t index;           // array, index of the next element
+        size_t limit;           // array, elements that can still match
+        uint8_t is_object;
+        uint8_t implied;        // JSONPG_FLAG_IS_OBJECT or IS_ARRAY
+};
+
+struct query_event_s {
+        jsonpg_type type;
+        jsonpg_value value;
+        size_t offset;          // of a string in bytes
+};
+
+struct query_store_s {
+        struct query_event_s *event;
+        size_t count;
+        size_t size;
+        uint8_t *bytes;
+        size_t used;
+        size_t bytes_size;
+};
+
+// A match inside a match, returned after it
+struct query_match_s {
+        size_t start;           // events in nested
+        size_t end;
+        int depth;              // of the container it is in
+        int outer;              // match it is in, -1 for none
+};
+
+// A container in the value read ahead
+struct query_look_s {
+        uint64_t operands;      // with paths into it
+        size_t index;
+        uint8_t is_object;
+};
+
+enum {
+        QUERY_EVENTS,
+        QUERY_LOOK,             // reading ahead to decide filters
+        QUERY_DISCARD,          // discarding a value or a container's rest
+        QUERY_DOCUMENT,         // a match has ended
+        QUERY_REPLAY,           // returning the matches inside it
+        QUERY_PASS,             // everything matches
+        QUERY_DONE
+};
+
+enum {
+        QUERY_UNKNOWN,
+        QUERY_MISSING,
+        QUERY_FOUND
+};
+
+#define QUERY_UNORDERED 2
+
+struct query_s {
+        jsonpg_query query;
+        jsonpg_allocator *allocator;    // the parser's
+        uint8_t phase;
+        uint8_t check;          // a value at depth has ended
+        uint8_t known;          // child is worked out for the next value
+        uint8_t was_ahead;      // the last event had been read ahead
+        uint8_t closing;        // discarding the rest of the container
+        uint8_t dropping;       // jsonpg_skip()
+        jsonpg_type last;
+        int depth;              // levels open, 0 between values
+        int levels;
+        struct query_level_s *level;
+        size_t emit;            // containers open in the match returned
+        size_t discard;         // containers open in what is discarded
+        size_t drop;            // containers open in a dropped value
+        uint64_t child;         // states of the next member or element
+        uint64_t filters;       // its states waiting on filters
+        uint64_t decided;
+        uint64_t passed;
+        struct query_store_s ahead;
+        size_t head;            // next event read ahead to return
+        size_t at;              // next event to read ahead
+        size_t look_depth;
+        uint64_t key_operands;
+        struct query_store_s nested;
+        struct query_match_s *match;
+        int matches;
+        int matches_size;
+        int open;               // innermost match being kept
+        int replay;
+        size_t replay_at;
+        uint8_t state[QUERY_OPERANDS_MAX];
+        size_t found[QUERY_OPERANDS_MAX];       // events read ahead
+        struct query_look_s look[];
+};
+
+static void query_space(struct query_compile_s *c)
+{
+        while(*c->s == ' ' || *c->s == '\t' || *c->s == '\n' || *c->s == '\r')
+                c->s++;
+}
+
+static int query_name_char(uint8_t c)
+{
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                || (c >= '0' && c <= '9') || c == '_' || c == '-' || c >= 0x80;
+}
+
+static uint8_t *query_name(struct query_compile_s *c, size_t *length)
+{
+        uint8_t *key = c->names;
+        while(query_name_char(*c->s))
+                *c->names++ = *c->s++;
+        *length = c->names - key;
+        return key;
+}
+
+// A quoted name or string, NULL without the closing quote
+static uint8_t *query_quoted(struct query_compile_s *c, size_t *length)
+{
+        uint8_t quote = *c->s++;
+        uint8_t *key = c->names;
+        for( ; *c->s && *c->s != quote ; c->s++) {
+                if(*c->s == '\\' && c->s[1])
+                        c->s++;
+                *c->names++ = *c->s;
+        }
+        if(*c->s != quote)
+                return NULL;
+        c->s++;
+        *length = c->names - key;
+        return key;
+}
+
+// Returns 1 for an index, 0 without digits and -1 for a bad one
+static int query_index(struct query_compile_s *c, size_t *index)
+{
+        size_t length = strspn((char *)c->s, "0123456789");
+        if(length == 0)
+                return 0;
+        *index = number_index(c->s, length);
+        c->s += length;
+        return (*index == PROJECT_NO_INDEX) ? -1 : 1;
+}
+
+static int query_word(struct query_compile_s *c, char *word)
+{
+        size_t length = strlen(word);
+        if(strncmp((char *)c->s, word, length) || query_name_char(c->s[length]))
+                return 0;
+        c->s += length;
+        return 1;
+}
+
+static int query_number(struct query_compile_s *c, struct query_term_s *t)
+{
+        char *start = (char *)c->s;
+        char *end;
+        size_t digits = strspn(start + (*start == '-'), "0123456789");
+        if(digits == 0)
+                return -1;
+        char *after = start + (*start == '-') + digits;
+        if(*after == '.' || *after == 'e' || *after == 'E' || digits > 18) {
+                t->type = JSONPG_REAL;
+                t->value.number.real = strtod(start, &end);
+        } else {
+                t->type = JSONPG_INTEGER;
+                t->value.number.integer = strtol(start, &end, 10);
+        }
+        c->s = (uint8_t *)end;
+        return 0;
+}
+
+// @ and its steps, .name, ['name'] or [0]
+static int query_operand(struct query_compile_s *c)
+{
+        jsonpg_query q = c->query;
+        if(q->operands == QUERY_OPERANDS_MAX)
+                return -1;
+        struct query_operand_s *o = &q->operand[q->operands];
+        o->steps = 0;
+        o->step = c->steps;
+        c->s++;
+        while(1) {
+                struct project_step_s *step = &o->step[o->steps];
+                step->key = NULL;
+                step->length = 0;
+                step->index = PROJECT_NO_INDEX;
+                if(c->s[0] == '.' && query_name_char(c->s[1])) {
+                        c->s++;
+                        step->key = query_name(c, &step->length);
+                } else if(c->s[0] == '[') {
+                        c->s++;
+                        query_space(c);
+                        if(*c->s == '\'' || *c->s == '"') {
+                                step->key = query_quoted(c, &step->length);
+                                if(!step->key)
+                                        return -1;
+                        } else if(query_index(c, &step->index) <= 0) {
+                                return -1;
+                        }
+                        query_space(c);
+                        if(*c->s++ != ']')
+                                return -1;
+                } else {
+                        break;
+                }
+                o->steps++;
+        }
+        c->steps += o->steps;
+        if(o->steps > q->max_steps)
+                q->max_steps = o->steps;
+        return q->operands++;
+}
+
+static int query_term(struct query_compile_s *c)
+{
+        jsonpg_query q = c->query;
+        struct query_term_s *t = &q->term[q->terms];
+        t->operand = -1;
+        t->type = JSONPG_NONE;
+        if(*c->s == '@') {
+                t->operand = query_operand(c);
+                if(t->operand < 0)
+                        return -1;
+        } else if(*c->s == '\'' || *c->s == '"') {
+                t->type = JSONPG_STRING;
+                t->value.string.bytes = query_quoted(c, &t->value.string.length);
+                if(!t->value.string.bytes)
+                        return -1;
+        } else if(*c->s == '-' || (*c->s >= '0' && *c->s <= '9')) {
+                if(query_number(c, t))
+                        return -1;
+        } else if(query_word(c, "true")) {
+                t->type = JSONPG_TRUE;
+        } else if(query_word(c, "false")) {
+                t->type = JSONPG_FALSE;
+        } else if(query_word(c, "null")) {
+                t->type = JSONPG_NULL;
+        } else {
+                return -1;
+        }
+        return q->terms++;
+}
+
+static int query_node(jsonpg_query q, int kind, int left, int right)
+{
+        struct query_node_s *node = &q->node[q->nodes];
+        node->kind = kind;
+        node->left = left;
+        node->right = right;
+        return q->nodes++;
+}
+
+static int query_operator(struct query_compile_s *c)
+{
+        uint8_t *s = c->s;
+        int kind;
+        if(s[0] == '=' && s[1] == '=')
+                kind = QUERY_EQ;
+        else if(s[0] == '!' && s[1] == '=')
+                kind = QUERY_NE;
+        else if(s[0] == '<')
+                kind = (s[1] == '=') ? QUERY_LE : QUERY_LT;
+        else if(s[0] == '>')
+                kind = (s[1] == '=') ? QUERY_GE : QUERY_GT;
+        else
+                return -1;
+        c->s += (s[1] == '=') ? 2 : 1;
+        return kind;
+}
+
+static int query_or(struct query_compile_s *c);
+
+// A test, a comparison or a negated or bracketed expression
+static int query_primary(struct query_compile_s *c)
+{
+        jsonpg_query q = c->query;
+        query_space(c);
+        if(*c->s == '!') {
+                c->s++;
+                int n = query_primary(c);
+                return (n < 0) ? -1 : query_node(q, QUERY_NOT, n, -1);
+        }
+        if(*c->s == '(') {
+                c->s++;
+                int n = query_or(c);
+                query_space(c);
+                if(n < 0 || *c->s != ')')
+                        return -1;
+                c->s++;
+                return n;
+        }
+
+        int left = query_term(c);
+        if(left < 0)
+                return -1;
+        query_space(c);
+        int kind = query_operator(c);
+        if(kind < 0)
+                return (q->term[left].operand < 0)
+                        ? -1
+                        : query_node(q, QUERY_EXISTS, left, -1);
+        query_space(c);
+        int right = query_term(c);
+        return (right < 0) ? -1 : query_node(q, kind, left, right);
+}
+
+static int query_and(struct query_compile_s *c)
+{
+        int n = query_primary(c);
+        while(n >= 0) {
+                query_space(c);
+                if(c->s[0] != '&' || c->s[1] != '&')
+                        break;
+                c->s += 2;
+                int right = query_primary(c);
+                n = (right < 0) ? -1 : query_node(c->query, QUERY_AND, n, right);
+        }
+        return n;
+}
+
+static int query_or(struct query_compile_s *c)
+{
+        int n = query_and(c);
+        while(n >= 0) {
+                query_space(c);
+                if(c->s[0] != '|' || c->s[1] != '|')
+                        break;
+                c->s += 2;
+                int right = query_and(c);
+                n = (right < 0) ? -1 : query_node(c->query, QUERY_OR, n, right);
+        }
+        return n;
+}
+
+static int query_selector(struct query_compile_s *c, struct query_segment_s *g)
+{
+        jsonpg_query q = c->query;
+        if(q->selectors == QUERY_SELECTORS_MAX)
+                return -1;
+        struct query_selector_s *sel = &q->selector[q->selectors++];
+        g->count++;
+        sel->start = 0;
+        sel->end = PROJECT_NO_INDEX;
+        sel->step = 1;
+
+        if(*c->s == '\'' || *c->s == '"') {
+                sel->kind = QUERY_NAME;
+                sel->key = query_quoted(c, &sel->length);
+                return sel->key ? 0 : -1;
+        } else if(*c->s == '*') {
+                sel->kind = QUERY_WILDCARD;
+                c->s++;
+                return 0;
+        } else if(*c->s == '?') {
+                sel->kind = QUERY_FILTER;
+                c->s++;
+                int first = q->operands;
+                sel->filter = query_or(c);
+                for(int i = first ; i < q->operands ; i++)
+                        g->operands |= 1ULL << i;
+                return (sel->filter < 0) ? -1 : 0;
+        }
+
+        int start = query_index(c, &sel->start);
+        query_space(c);
+        if(start < 0 || (*c->s != ':' && !start))
+                return -1;
+        sel->kind = QUERY_INDEX;
+        if(*c->s != ':')
+                return 0;
+
+        sel->kind = QUERY_SLICE;
+        c->s++;
+        query_space(c);
+        if(query_index(c, &sel->end) < 0)
+                return -1;
+        query_space(c);
+        if(*c->s == ':') {
+                c->s++;
+                query_space(c);
+                if(query_index(c, &sel->step) < 0 || sel->step == 0)
+                        return -1;
+        }
+        return 0;
+}
+
+// [selector, ...]
+static int query_brackets(struct query_compile_s *c, struct query_segment_s *g)
+{
+        c->s++;
+        do {
+                query_space(c);
+                if(query_selector(c, g))
+                        return -1;
+                query_space(c);
+        } while(*c->s == ',' && c->s++);
+        if(*c->s != ']')
+                return -1;
+        c->s++;
+        return 0;
+}
+
+static int query_segments(struct query_compile_s *c)
+{
+        jsonpg_query q = c->query;
+        while(*c->s) {
+                if(q->segments == QUERY_SEGMENTS_MAX)
+                        return -1;
+                struct query_segment_s *g = &q->segment[q->segments++];
+                g->descendant = 0;
+                g->first = q->selectors;
+                g->count = 0;
+                g->names = 0;
+                g->operands = 0;
+                g->limit = 0;
+
+                if(c->s[0] == '[') {
+                        if(query_brackets(c, g))
+                                return -1;
+                        continue;
+                } else if(c->s[0] != '.') {
+                        return -1;
+                }
+                g->descendant = (c->s[1] == '.');
+                c->s += 1 + g->descendant;
+                if(g->descendant && c->s[0] == '[') {
+                        if(query_brackets(c, g))
+                                return -1;
+                } else if(c->s[0] == '*') {
+                        if(query_selector(c, g))
+                                return -1;
+                } else {
+                        if(q->selectors == QUERY_SELECTORS_MAX)
+                                return -1;
+                        struct query_selector_s *sel = &q->selector[q->selectors++];
+                        g->count++;
+                        sel->kind = QUERY_NAME;
+                        sel->key = query_name(c, &sel->length);
+                        if(sel->length == 0)
+                                return -1;
+                }
+        }
+        return 0;
+}
+
+static void query_masks(jsonpg_query q)
+{
+        q->live = (1ULL << q->segments) - 1;
+        q->descendant = 0;
+        q->object_open = 0;
+        q->array_open = 0;
+        for(int i = 0 ; i < q->segments ; i++) {
+                struct query_segment_s *g = &q->segment[i];
+                uint64_t bit = 1ULL << i;
+                if(g->descendant)
+                        q->descendant |= bit;
+                for(int k = g->first ; k < g->first + g->count ; k++) {
+                        struct query_selector_s *sel = &q->selector[k];
+                        switch(sel->kind) {
+                        case QUERY_NAME:
+                                g->names |= 1ULL << k;
+                                break;
+                        case QUERY_INDEX:
+                                if(sel->start >= g->limit)
+                                        g->limit = sel->start + 1;
+                                break;
+                        case QUERY_SLICE:
+                                if(sel->end == PROJECT_NO_INDEX)
+                                        q->array_open |= bit;
+                                else if(sel->end > g->limit)
+                                        g->limit = sel->end;
+                                break;
+                        default:
+                                q->object_open |= bit;
+                                q->array_open |= bit;
+                        }
+                }
+        }
+}
+
+void jsonpg_query_free(void *ptr)
+{
+        if(ptr) {
+                jsonpg_query q = ptr;
+                al_dealloc(q->allocator, q->names);
+                al_dealloc(q->allocator, q->steps);
+                al_dealloc(q->allocator, q->node);
+                al_dealloc(q->allocator, q->term);
+                al_dealloc(q->allocator, q);
+        }
+}
+
+/*
+ * Compiles a JSONPath, buffer_limit bounds the bytes of events kept
+ * for filters and matches inside matches, 0 for QUERY_BUFFER_LIMIT
+ *
+ * Returns NULL for a query it cannot compile, more than
+ * QUERY_SEGMENTS_MAX segments, QUERY_SELECTORS_MAX selectors or
+ * QUERY_OPERANDS_MAX paths in filters, or on failing to allocate
+ */
+jsonpg_query jsonpg_query_new(char *jsonpath, size_t buffer_limit)
+{
+        if(jsonpath[0] != '$')
+                return NULL;
+
+        jsonpg_allocator *allocator = allocator_select(NULL);
+        jsonpg_query q = al_alloc(allocator, sizeof(struct jsonpg_query_s));
+        if(!q)
+                return NULL;
+        q->allocator = allocator;
+        q->segments = 0;
+        q->selectors = 0;
+        q->operands = 0;
+        q->nodes = 0;
+        q->terms = 0;
+        q->max_steps = 0;
+        q->buffer_limit = buffer_limit ? buffer_limit : QUERY_BUFFER_LIMIT;
+
+        // No more names, steps, nodes or terms than characters
+        size_t length = strlen(jsonpath) + 1;
+        q->names = al_alloc(allocator, length);
+        q->steps = al_alloc(allocator, length * sizeof(struct project_step_s));
+        q->node = al_alloc(allocator, length * sizeof(struct query_node_s));
+        q->term = al_alloc(allocator, length * sizeof(struct query_term_s));
+        uint8_t *copy = al_alloc(allocator, length);
+        if(!q->names || !q->steps || !q->node || !q->term || !copy) {
+                al_dealloc(allocator, copy);
+                jsonpg_query_free(q);
+                return NULL;
+        }
+
+        memcpy(copy, jsonpath, length);
+        struct query_compile_s c = {
+                .query = q,
+                .s = copy + 1,
+                .names = q->names,
+                .steps = q->steps
+        };
+        int failed = query_segments(&c);
+        al_dealloc(allocator, copy);
+        if(failed) {
+                jsonpg_query_free(q);
+                return NULL;
+        }
+        query_masks(q);
+        return q;
+}
+
+static void store_reset(struct query_store_s *st)
+{
+        st->count = 0;
+        st->used = 0;
+}
+
+static void store_free(jsonpg_allocator *allocator, struct query_store_s *st)
+{
+        al_dealloc(allocator, st->event);
+        al_dealloc(allocator, st->bytes);
+}
+
+static jsonpg_type store_get(struct query_store_s *st, size_t i, jsonpg_value *value)
+{
+        struct query_event_s *e = &st->event[i];
+        *value = e->value;
+        if(e->type == JSONPG_STRING || e->type == JSONPG_KEY)
+                value->string.bytes = st->bytes + e->offset;
+        return e->type;
+}
+
+static size_t query_kept(struct query_s *s)
+{
+        return (s->ahead.count + s->nested.count) * sizeof(struct query_event_s)
+                + s->ahead.used + s->nested.used
+                + s->matches * sizeof(struct query_match_s);
+}
+
+// Returns -1 on failing to allocate and 1 past the buffer limit
+static int query_keep(struct query_s *s, struct query_store_s *st,
+                jsonpg_type type, jsonpg_value *value)
+{
+        size_t length = (type == JSONPG_STRING || type == JSONPG_KEY)
+                ? value->string.length
+                : 0;
+        if(query_kept(s) + sizeof(struct query_event_s) + length
+                        > s->query->buffer_limit)
+                return 1;
+
+        if(st->count == st->size) {
+                size_t size = st->size ? 2 * st->size : 64;
+                struct query_event_s *event = al_realloc(s->allocator, st->event,
+                                size * sizeof(struct query_event_s));
+                if(!event)
+                        return -1;
+                st->event = event;
+                st->size = size;
+        }
+        if(!st->bytes || st->used + length > st->bytes_size) {
+                size_t size = st->bytes_size ? st->bytes_size : JSONPG_BUF_SIZE;
+                while(size < st->used + length)
+                        size *= 2;
+                uint8_t *bytes = al_realloc(s->allocator, st->bytes, size);
+                if(!bytes)
+                        return -1;
+                st->bytes = bytes;
+                st->bytes_size = size;
+        }
+
+        struct query_event_s *e = &st->event[st->count++];
+        e->type = type;
+        e->value = *value;
+        e->offset = st->used;
+        if(length)
+                memcpy(st->bytes + st->used, value->string.bytes, length);
+        st->used += length;
+        return 0;
+}
+
+static jsonpg_type query_error(jsonpg_parser p, int kept)
+{
+        return (kept < 0)
+                ? alloc_error(p)
+                : set_result_error(p, JSONPG_ERROR_BUFFER_LIMIT);
+}
+
+static void query_free(struct query_s *s)
+{
+        if(s) {
+                store_free(s->allocator, &s->ahead);
+                store_free(s->allocator, &s->nested);
+                al_dealloc(s->allocator, s->match);
+                al_dealloc(s->allocator, s->level);
+                al_dealloc(s->allocator, s);
+        }
+}
+
+static int store_holds(struct query_store_s *st, uint8_t *bytes)
+{
+        return st->bytes && bytes >= st->bytes && bytes < st->bytes + st->bytes_size;
+}
+
+// Whether a string is in the events the parser's query keeps
+static int query_holds(jsonpg_parser p, uint8_t *bytes)
+{
+        struct query_s *s = p->query;
+        return s && (store_holds(&s->ahead, bytes) || store_holds(&s->nested, bytes));
+}
+
+// Pushes a container with the states worked out for it
+static int query_push(struct query_s *s, int is_object)
+{
+        jsonpg_query q = s->query;
+        if(s->depth + 1 == s->levels) {
+                struct query_level_s *level = al_realloc(s->allocator, s->level,
+                                2 * s->levels * sizeof(struct query_level_s));
+                if(!level)
+                        return -1;
+                s->level = level;
+                s->levels *= 2;
+        }
+
+        struct query_level_s *l = &s->level[++s->depth];
+        l->states = s->child;
+        l->seen = 0;
+        l->index = 0;
+        l->limit = 0;
+        l->is_object = is_object;
+        l->implied = 0;
+        for(uint64_t b = s->child & q->live ; b ; b &= b - 1) {
+                size_t limit = q->segment[__builtin_ctzll(b)].limit;
+                if(limit > l->limit)
+                        l->limit = limit;
+        }
+        s->check = 1;
+        return 0;
+}
+
+// Starts on a document
+static void query_start(jsonpg_parser p, struct query_s *s)
+{
+        jsonpg_query q = s->query;
+        s->depth = 0;
+        s->phase = QUERY_EVENTS;
+        s->check = 0;
+        s->known = 0;
+        s->closing = 0;
+        s->dropping = 0;
+        s->last = JSONPG_NONE;
+        s->emit = 0;
+        s->head = 0;
+        store_reset(&s->ahead);
+        store_reset(&s->nested);
+        s->matches = 0;
+        s->open = -1;
+
+        if(p->flags & (JSONPG_FLAG_IS_OBJECT | JSONPG_FLAG_IS_ARRAY)) {
+                // $ alone matches everything inside the container without end
+                if(q->segments == 0) {
+                        s->phase = QUERY_PASS;
+                } else {
+                        s->child = 1;
+                        query_push(s, (p->flags & JSONPG_FLAG_IS_OBJECT) != 0);
+                        s->level[1].implied = 1;
+                }
+        }
+}
+
+/*
+ * Runs a query over the parser's events, NULL for all events again,
+ * set between parses, the query must outlive its use by the parser
+ *
+ * With a projection as well the query runs over the projected events
+ *
+ * Returns -1 on failing to allocate, leaving the parser without one
+ */
+int jsonpg_parser_query(jsonpg_parser p, jsonpg_query q)
+{
+        query_free(p->query);
+        p->query = NULL;
+        if(!q)
+                return 0;
+
+        // Levels read ahead 0 to max_steps deep
+        struct query_s *s = al_alloc(p->allocator, sizeof(struct query_s)
+                        + (q->max_steps + 1) * sizeof(struct query_look_s));
+        if(!s)
+                return -1;
+        s->query = q;
+        s->allocator = p->allocator;
+        s->ahead = (struct query_store_s) { 0 };
+        s->nested = (struct query_store_s) { 0 };
+        s->match = NULL;
+        s->matches_size = 0;
+        s->levels = QUERY_LEVELS;
+        s->level = al_alloc(s->allocator, s->levels * sizeof(struct query_level_s));
+        if(!s->level) {
+                query_free(s);
+                return -1;
+        }
+        p->query = s;
+        query_start(p, s);
+        return 0;
+}
+
+// Whether anything more can match in the container at depth
+static int query_possible(struct query_s *s, int depth)
+{
+        jsonpg_query q = s->query;
+        struct query_level_s *l = &s->level[depth];
+        uint64_t states = l->states & q->live;
+        if(states & q->descendant)
+                return 1;
+        if(!l->is_object)
+                return (states & q->array_open) || l->index < l->limit;
+        if(states & q->object_open)
+                return 1;
+
+        uint64_t names = 0;
+        for(uint64_t b = states ; b ; b &= b - 1)
+                names |= q->segment[__builtin_ctzll(b)].names;
+        return (names & ~l->seen) != 0;
+}
+
+// Whether nothing more can match in any open container
+static int query_finished(jsonpg_parser p, struct query_s *s)
+{
+        if(p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE)
+                return 0;
+        for(int depth = 1 ; depth <= s->depth ; depth++) {
+                if(query_possible(s, depth))
+                        return 0;
+        }
+        return 1;
+}
+
+// States of a member of the object at depth
+static void query_member(struct query_s *s, uint8_t *key, size_t length)
+{
+        jsonpg_query q = s->query;
+        struct query_level_s *l = &s->level[s->depth];
+        s->child = 0;
+        s->filters = 0;
+        s->known = 0;
+        for(uint64_t b = l->states & q->live ; b ; b &= b - 1) {
+                int i = __builtin_ctzll(b);
+                struct query_segment_s *g = &q->segment[i];
+                if(g->descendant)
+                        s->child |= 1ULL << i;
+                for(int k = g->first ; k < g->first + g->count ; k++) {
+                        struct query_selector_s *sel = &q->selector[k];
+                        if(sel->kind == QUERY_WILDCARD
+                                        || (sel->kind == QUERY_NAME
+                                                && sel->length == length
+                                                && (!length || !memcmp(sel->key, key, length)))) {
+                                s->child |= 2ULL << i;
+                                l->seen |= 1ULL << k;
+                        } else if(sel->kind == QUERY_FILTER) {
+                                s->filters |= 1ULL << i;
+                        }
+                }
+        }
+}
+
+// States of the next element of the array at depth
+static void query_element(struct query_s *s)
+{
+        jsonpg_query q = s->query;
+        struct query_level_s *l = &s->level[s->depth];
+        size_t index = l->index++;
+        s->child = 0;
+        s->filters = 0;
+        for(uint64_t b = l->states & q->live ; b ; b &= b - 1) {
+                int i = __builtin_ctzll(b);
+                struct query_segment_s *g = &q->segment[i];
+                if(g->descendant)
+                        s->child |= 1ULL << i;
+                for(int k = g->first ; k < g->first + g->count ; k++) {
+                        struct query_selector_s *sel = &q->selector[k];
+                        if(sel->kind == QUERY_WILDCARD
+                                        || (sel->kind == QUERY_INDEX && index == sel->start)
+                                        || (sel->kind == QUERY_SLICE
+                                                && index >= sel->start && index < sel->end
+                                                && (index - sel->start) % sel->step == 0))
+                                s->child |= 2ULL << i;
+                        else if(sel->kind == QUERY_FILTER)
+                                s->filters |= 1ULL << i;
+                }
+        }
+}
+
+// Gets a term's value, JSONPG_NONE for a path that is not there
+static int query_value(struct query_s *s, int t, jsonpg_type *type, jsonpg_value *value)
+{
+        struct query_term_s *term = &s->query->term[t];
+        if(term->operand < 0) {
+                *type = term->type;
+                *value = term->value;
+                return 0;
+        }
+        switch(s->state[term->operand]) {
+        case QUERY_UNKNOWN:
+                return -1;
+        case QUERY_MISSING:
+                *type = JSONPG_NONE;
+                return 0;
+        default:
+                *type = store_get(&s->ahead, s->found[term->operand], value);
+                return 0;
+        }
+}
+
+// -1, 0 or 1 as a is less, equal or more than b, or QUERY_UNORDERED
+static int query_order(jsonpg_type a, jsonpg_value *x, jsonpg_type b, jsonpg_value *y)
+{
+        if((a == JSONPG_INTEGER || a == JSONPG_REAL)
+                        && (b == JSONPG_INTEGER || b == JSONPG_REAL)) {
+                if(a == JSONPG_INTEGER && b == JSONPG_INTEGER)
+                        return (x->number.integer > y->number.integer)
+                                - (x->number.integer < y->number.integer);
+                double u = (a == JSONPG_REAL) ? x->number.real : x->number.integer;
+                double v = (b == JSONPG_REAL) ? y->number.real : y->number.integer;
+                return (u > v) - (u < v);
+        }
+        if(a == JSONPG_STRING && b == JSONPG_STRING) {
+                size_t length = (x->string.length < y->string.length)
+                        ? x->string.length
+                        : y->string.length;
+                int cmp = length ? memcmp(x->string.bytes, y->string.bytes, length) : 0;
+                if(cmp)
+                        return (cmp < 0) ? -1 : 1;
+                return (x->string.length > y->string.length)
+                        - (x->string.length < y->string.length);
+        }
+        if(a == JSONPG_BEGIN_OBJECT || a == JSONPG_BEGIN_ARRAY)
+                return QUERY_UNORDERED;
+        return (a == b) ? 0 : QUERY_UNORDERED;
+}
+
+static int query_compare(struct query_s *s, struct query_node_s *node)
+{
+        jsonpg_type a, b;
+        jsonpg_value x = { 0 }, y = { 0 };
+        if(query_value(s, node->left, &a, &x) || query_value(s, node->right, &b, &y))
+                return -1;
+        int order = query_order(a, &x, b, &y);
+        switch(node->kind) {
+        case QUERY_EQ:
+                return order == 0;
+        case QUERY_NE:
+                return order != 0;
+        case QUERY_LT:
+                return order == -1;
+        case QUERY_LE:
+                return order == -1 || order == 0;
+        case QUERY_GT:
+                return order == 1;
+        default:
+                return order == 1 || order == 0;
+        }
+}
+
+// Whether an expression holds, -1 until it is known
+static int query_eval(struct query_s *s, int n)
+{
+        jsonpg_query q = s->query;
+        struct query_node_s *node = &q->node[n];
+        int left, right;
+        switch(node->kind) {
+        case QUERY_OR:
+                left = query_eval(s, node->left);
+                if(left > 0)
+                        return 1;
+                right = query_eval(s, node->right);
+                if(right > 0)
+                        return 1;
+                return (left < 0 || right < 0) ? -1 : 0;
+        case QUERY_AND:
+                left = query_eval(s, node->left);
+                if(left == 0)
+                        return 0;
+                right = query_eval(s, node->right);
+                if(right == 0)
+                        return 0;
+                return (left < 0 || right < 0) ? -1 : 1;
+        case QUERY_NOT:
+                left = query_eval(s, node->left);
+                return (left < 0) ? left : !left;
+        case QUERY_EXISTS:
+                switch(s->state[q->term[node->left].operand]) {
+                case QUERY_UNKNOWN:
+                        return -1;
+                case QUERY_MISSING:
+                        return 0;
+                default:
+                        return 1;
+                }
+        default:
+                return query_compare(s, node);
+        }
+}
+
+// Decides what filters it can for the value read ahead
+static void query_decide(struct query_s *s)
+{
+        jsonpg_query q = s->query;
+        for(uint64_t b = s->filters & ~s->decided ; b ; b &= b - 1) {
+                int i = __builtin_ctzll(b);
+                struct query_segment_s *g = &q->segment[i];
+                int passed = 0;
+                for(int k = g->first ; k < g->first + g->count && passed < 1 ; k++) {
+                        if(q->selector[k].kind == QUERY_FILTER) {
+                                int result = query_eval(s, q->selector[k].filter);
+                                if(result)
+                                        passed = result;
+                        }
+                }
+                if(passed >= 0) {
+                        s->decided |= 1ULL << i;
+                        if(passed)
+                                s->passed |= 1ULL << i;
+                }
+        }
+}
+
+static void query_resolve(struct query_s *s, uint64_t operands, int state, size_t at)
+{
+        int changed = 0;
+        for(uint64_t b = operands ; b ; b &= b - 1) {
+                int i = __builtin_ctzll(b);
+                if(s->state[i] == QUERY_UNKNOWN) {
+                        s->state[i] = state;
+                        s->found[i] = at;
+                        changed = 1;
+                }
+        }
+        if(changed)
+                query_decide(s);
+}
+
+// Starts reading ahead through the value at head
+static void query_look_start(struct query_s *s)
+{
+        jsonpg_query q = s->query;
+        s->at = s->head;
+        s->look_depth = 0;
+        s->decided = 0;
+        s->passed = 0;
+        uint64_t operands = 0;
+        for(uint64_t b = s->filters ; b ; b &= b - 1)
+                operands |= q->segment[__builtin_ctzll(b)].operands;
+        for(uint64_t b = operands ; b ; b &= b - 1)
+                s->state[__builtin_ctzll(b)] = QUERY_UNKNOWN;
+        s->look[0].operands = operands;
+}
+
+// Finds the operands' values in an event read ahead, at in ahead
+static void query_look(struct query_s *s, jsonpg_type type, jsonpg_value *value, size_t at)
+{
+        jsonpg_query q = s->query;
+        size_t depth = s->look_depth;
+        struct query_look_s *l = &s->look[(depth <= (size_t)q->max_steps) ? depth : 0];
+        uint64_t operands = 0;
+
+        if(type == JSONPG_KEY) {
+                s->key_operands = 0;
+                if(depth > (size_t)q->max_steps)
+                        return;
+                for(uint64_t b = l->operands ; b ; b &= b - 1) {
+                        int i = __builtin_ctzll(b);
+                        struct project_step_s *step = &q->operand[i].step[depth - 1];
+                        if(step->key && step->length == value->string.length
+                                        && (!step->length
+                                                || !memcmp(step->key, value->string.bytes, step->length)))
+                                s->key_operands |= 1ULL << i;
+                }
+                return;
+        }
+        if(type == JSONPG_END_OBJECT || type == JSONPG_END_ARRAY) {
+                // Paths into the container not found are not there
+                s->look_depth--;
+                if(depth <= (size_t)q->max_steps)
+                        query_resolve(s, l->operands, QUERY_MISSING, 0);
+                return;
+        }
+
+        if(depth == 0) {
+                operands = l->operands;
+        } else if(depth <= (size_t)q->max_steps) {
+                if(l->is_object) {
+                        operands = s->key_operands;
+                } else {
+                        size_t index = l->index++;
+                        for(uint64_t b = l->operands ; b ; b &= b - 1) {
+                                int i = __builtin_ctzll(b);
+                                struct project_step_s *step = &q->operand[i].step[depth - 1];
+                                if(!step->key && step->index == index)
+                                        operands |= 1ULL << i;
+                        }
+                }
+        }
+
+        uint64_t found = 0;
+        for(uint64_t b = operands ; b ; b &= b - 1) {
+                int i = __builtin_ctzll(b);
+                if((size_t)q->operand[i].steps == depth)
+                        found |= 1ULL << i;
+        }
+        query_resolve(s, found, QUERY_FOUND, at);
+        if(type == JSONPG_BEGIN_OBJECT || type == JSONPG_BEGIN_ARRAY) {
+                if(++s->look_depth <= (size_t)q->max_steps) {
+                        l = &s->look[s->look_depth];
+                        l->operands = operands & ~found;
+                        l->index = 0;
+                        l->is_object = (type == JSONPG_BEGIN_OBJECT);
+                }
+        } else {
+                query_resolve(s, operands & ~found, QUERY_MISSING, 0);
+        }
+}
+
+// Keeps the matches inside a match until it has been returned
+static int query_nest(struct query_s *s)
+{
+        if(s->matches == s->matches_size) {
+                int size = s->matches_size ? 2 * s->matches_size : 16;
+                struct query_match_s *match = al_realloc(s->allocator, s->match,
+                                size * sizeof(struct query_match_s));
+                if(!match)
+                        return -1;
+                s->match = match;
+                s->matches_size = size;
+        }
+        struct query_match_s *m = &s->match[s->matches];
+        m->start = s->nested.count;
+        m->end = 0;
+        m->depth = s->depth;
+        m->outer = s->open;
+        s->open = s->matches++;
+        return 0;
+}
+
+// The next event read ahead, JSONPG_NONE once they have all been returned
+static jsonpg_type query_ahead(jsonpg_parser p, struct query_s *s)
+{
+        if(s->head < s->ahead.count)
+                return store_get(&s->ahead, s->head++, &p->result);
+        if(s->ahead.count) {
+                store_reset(&s->ahead);
+                s->head = 0;
+        }
+        return JSONPG_NONE;
+}
+
+// The parser's events or those of its projection
+static jsonpg_type query_source(jsonpg_parser p)
+{
+        return p->project
+                ? project_next(p)
+                : next_event(p);
+}
+
+// Returns 1 once what is discarded has ended
+static int query_discarded(struct query_s *s, jsonpg_type type)
+{
+        if(type == JSONPG_BEGIN_OBJECT || type == JSONPG_BEGIN_ARRAY) {
+                s->discard++;
+                return 0;
+        }
+        if(type == JSONPG_END_OBJECT || type == JSONPG_END_ARRAY)
+                s->discard--;
+        else if(type == JSONPG_KEY)
+                return 0;
+        return s->discard == 0;
+}
+
+static jsonpg_type query_next(jsonpg_parser p)
+{
+        struct query_s *s = p->query;
+        jsonpg_query q = s->query;
+        if(p->state == JSONPG_STATE_INITIAL)
+                query_start(p, s);
+
+        while(1) {
+                jsonpg_type type;
+                struct query_level_s *l = &s->level[s->depth];
+                struct query_match_s *m;
+                int kept;
+
+                switch(s->phase) {
+                case QUERY_DONE:
+                        return JSONPG_EOF;
+
+                case QUERY_PASS:
+                        type = query_source(p);
+                        if(project_pauses(type))
+                                return type;
+                        goto returned;
+
+                case QUERY_DOCUMENT:
+                        s->phase = s->matches ? QUERY_REPLAY : QUERY_EVENTS;
+                        s->replay = 0;
+                        s->replay_at = 0;
+                        type = JSONPG_END_DOCUMENT;
+                        goto returned;
+
+                case QUERY_REPLAY:
+                        m = &s->match[s->replay];
+                        if(s->replay_at < m->end) {
+                                type = store_get(&s->nested, s->replay_at++, &p->result);
+                                goto returned;
+                        }
+                        if(++s->replay < s->matches) {
+                                s->replay_at = s->match[s->replay].start;
+                        } else {
+                                s->phase = QUERY_EVENTS;
+                                s->matches = 0;
+                                store_reset(&s->nested);
+                        }
+                        type = JSONPG_END_DOCUMENT;
+                        goto returned;
+
+                case QUERY_LOOK:
+                        if(s->at < s->ahead.count) {
+                                jsonpg_value value;
+                                type = store_get(&s->ahead, s->at, &value);
+                                query_look(s, type, &value, s->at);
+                        } else {
+                                type = query_source(p);
+                                if(project_pauses(type))
+                                        return type;
+                                if((kept = query_keep(s, &s->ahead, type, &p->result)))
+                                        return query_error(p, kept);
+                                query_look(s, type, &p->result, s->at);
+                        }
+                        s->at++;
+                        if(s->decided == s->filters) {
+                                s->child |= s->passed << 1;
+                                s->known = 1;
+                                s->phase = QUERY_EVENTS;
+                        }
+                        continue;
+
+                case QUERY_DISCARD:
+                        type = query_ahead(p, s);
+                        if(type == JSONPG_NONE && !p->project) {
+                                // Scanned, each skip_begun() closing a container
+                                if(p->skipping)
+                                        type = next_event(p);
+                                else
+                                        type = s->discard
+                                                ? skip_begun(p)
+                                                : skip_value(p);
+                                if(project_pauses(type))
+                                        return type;
+                                if(s->discard && (type == JSONPG_END_OBJECT
+                                                        || type == JSONPG_END_ARRAY))
+                                        s->discard--;
+                                if(s->discard)
+                                        continue;
+                        } else {
+                                if(type == JSONPG_NONE)
+                                        type = query_source(p);
+                                if(project_pauses(type))
+                                        return type;
+                                if(!query_discarded(s, type))
+                                        continue;
+                        }
+                        s->phase = QUERY_EVENTS;
+                        if(s->closing) {
+                                s->closing = 0;
+                                s->depth--;
+                        }
+                        s->check = 1;
+                        continue;
+
+                default:
+                        if(s->check && !s->emit) {
+                                s->check = 0;
+                                if(s->depth > 0 && !query_possible(s, s->depth)) {
+                                        if(query_finished(p, s)) {
+                                                s->phase = QUERY_DONE;
+                                                if(p->input_is_fed)
+                                                        p->seen_eof = 1;
+                                                return JSONPG_EOF;
+                                        }
+                                        if(!l->implied) {
+                                                s->phase = QUERY_DISCARD;
+                                                s->discard = 1;
+                                                s->closing = 1;
+                                                continue;
+                                        }
+                                }
+                        }
+
+                        type = query_ahead(p, s);
+                        s->was_ahead = (type != JSONPG_NONE);
+                        if(!s->was_ahead)
+                                type = query_source(p);
+                        if(project_pauses(type))
+                                return type;
+
+                        if(type == JSONPG_END_DOCUMENT) {
+                                query_start(p, s);
+                                continue;
+                        }
+                        if(type == JSONPG_END_OBJECT || type == JSONPG_END_ARRAY) {
+                                s->depth--;
+                                s->check = 1;
+                                if(!s->emit)
+                                        continue;
+                                if(--s->emit == 0)
+                                        s->phase = QUERY_DOCUMENT;
+                                goto emit;
+                        }
+                        if(type == JSONPG_KEY) {
+                                query_member(s, p->result.string.bytes,
+                                                p->result.string.length);
+                                if(s->emit)
+                                        goto emit;
+                                if(!s->child && !s->filters) {
+                                        s->phase = QUERY_DISCARD;
+                                        s->discard = 0;
+                                }
+                                continue;
+                        }
+
+                        // A value starts
+                        if(!s->known) {
+                                if(s->depth == 0) {
+                                        s->child = 1;
+                                        s->filters = 0;
+                                } else if(!l->is_object) {
+                                        query_element(s);
+                                }
+                                if(s->filters) {
+                                        // Read ahead from the value
+                                        if(s->was_ahead) {
+                                                s->head--;
+                                        } else {
+                                                if((kept = query_keep(s, &s->ahead, type, &p->result)))
+                                                        return query_error(p, kept);
+                                                s->head = s->ahead.count - 1;
+                                        }
+                                        query_look_start(s);
+                                        s->phase = QUERY_LOOK;
+                                        continue;
+                                }
+                        }
+                        s->known = 0;
+
+                        int begins = (type == JSONPG_BEGIN_OBJECT || type == JSONPG_BEGIN_ARRAY);
+                        int matched = (s->child & ~q->live) != 0;
+                        int returns = matched || s->emit;
+                        if(matched && s->emit && query_nest(s))
+                                return alloc_error(p);
+                        if(begins) {
+                                if(query_push(s, type == JSONPG_BEGIN_OBJECT))
+                                        return alloc_error(p);
+                                if(returns)
+                                        s->emit++;
+                        } else {
+                                s->check = 1;
+                                if(matched && !s->emit)
+                                        s->phase = QUERY_DOCUMENT;
+                        }
+                        if(!returns)
+                                continue;
+                }
+
+        emit:
+                if(s->open >= 0) {
+                        if((kept = query_keep(s, &s->nested, type, &p->result)))
+                                return query_error(p, kept);
+                        m = &s->match[s->open];
+                        if(m->depth == s->depth) {
+                                m->end = s->nested.count;
+                                s->open = m->outer;
+                        }
+                }
+
+        returned:
+                // Drops what jsonpg_skip() skips
+                s->last = type;
+                if(s->dropping) {
+                        if(type == JSONPG_BEGIN_OBJECT || type == JSONPG_BEGIN_ARRAY) {
+                                s->drop++;
+                                continue;
+                        }
+                        if((type == JSONPG_END_OBJECT || type == JSONPG_END_ARRAY) && s->drop)
+                                s->drop--;
+                        if(s->drop)
+                                continue;
+                        s->dropping = 0;
+                }
+                return type;
+        }
+}
+
+// jsonpg_skip() with a query, dropping the events of the matches
+static jsonpg_type query_skip(jsonpg_parser p)
+{
+        struct query_s *s = p->query;
+        s->dropping = 1;
+        s->drop = (s->last == JSONPG_BEGIN_OBJECT || s->last == JSONPG_BEGIN_ARRAY);
+        return query_next(p);
+}
@@ -0,0 +1,93 @@
+/*
+ * jsonpg_query_bench.c
+ *   streaming a file through a JSONPath query
+ *
+ *   gcc -O2 -march=native -o jsonpg_query_bench jsonpg_query_bench.c
+ *
+ *   jsonpg_query_bench <json file> <jsonpath> [buffer limit]
+ *      reads the file with jsonpg_parse_fd() pulling every event and
+ *      then only the matches of a query such as '$..id' or
+ *      '$.items[?(@.status == "ok")].price', reporting MB/s, matches
+ *      and the peak resident memory, which stays flat however large
+ *      the file is
+ */
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "jsonpg.c"
+
+static double seconds()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long peak_kb()
+{
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        return ru.ru_maxrss;
+}
+
+static void report(char *name, jsonpg_parser p, char *file, size_t length)
+{
+        int fd = open(file, O_RDONLY);
+        if(fd == -1) {
+                perror("Failed to open file");
+                exit(1);
+        }
+
+        size_t events = 0;
+        size_t matches = 0;
+        jsonpg_type type;
+        double start = seconds();
+        jsonpg_parse_fd(p, fd, NULL);
+        do {
+                type = jsonpg_parse_next(p);
+                events++;
+                if(type == JSONPG_END_DOCUMENT)
+                        matches++;
+        } while(type != JSONPG_EOF && type != JSONPG_ERROR);
+        double elapsed = seconds() - start;
+        close(fd);
+
+        printf("%-8s %8.1f MB/s %10zu events %8zu matches %8ld KB peak%s\n",
+                        name, (double)length / elapsed / 1e6, events, matches,
+                        peak_kb(), (type == JSONPG_ERROR) ? " error" : "");
+}
+
+int main(int argc, char *argv[])
+{
+        if(argc < 3) {
+                printf("Usage: jsonpg_query_bench <json file> <jsonpath> [buffer limit]\n");
+                exit(1);
+        }
+
+        struct stat st;
+        if(stat(argv[1], &st) == -1) {
+                perror("Failed to stat file");
+                exit(1);
+        }
+
+        jsonpg_parser p = jsonpg_parser_new(NULL);
+        jsonpg_query q = jsonpg_query_new(argv[2], (argc > 3) ? atol(argv[3]) : 0);
+        if(!p || !q) {
+                printf("Failed to create parser or query\n");
+                exit(1);
+        }
+
+        printf("%s: %zu bytes\n", argv[1], (size_t)st.st_size);
+        report("all", p, argv[1], st.st_size);
+        if(jsonpg_parser_query(p, q)) {
+                printf("Failed to set query\n");
+                exit(1);
+        }
+        report("query", p, argv[1], st.st_size);
+
+        jsonpg_parser_free(p);
+        jsonpg_query_free(q);
+}
@@ -0,0 +1,68 @@
+/*
+ * jsonpg - a JSON parser/generator
+ * © 2025 Bob Davison (see also: LICENSE)
+ *
+ * jsonpg_ring.c
+ *   mirrored ring buffers for reader input
+ *
+ *   the same memory is mapped twice, back to back, so bytes
+ *   that wrap past the end of the ring are also found straight
+ *   after it and any run of up to the ring size is contiguous
+ *
+ *   Linux only (memfd), elsewhere ring_new() fails and readers
+ *   use a plain buffer
+ */
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+/*
+ * Returns a ring of at least *size bytes, mapped twice, setting
+ * *size to the actual size, a multiple of the page size
+ *
+ * Returns NULL if mirrored mappings are not available
+ */
+static uint8_t *ring_new(size_t *size)
+{
+#if defined(__linux__) && defined(SYS_memfd_create)
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t ring_size = (*size + page - 1) / page * page;
+
+        int fd = syscall(SYS_memfd_create, "jsonpg_ring", 0);
+        if(fd == -1)
+                return NULL;
+
+        // Reserve both halves then map the file over each
+        uint8_t *ring = MAP_FAILED;
+        if(0 == ftruncate(fd, ring_size))
+                ring = mmap(NULL, 2 * ring_size, PROT_NONE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(ring != MAP_FAILED
+                        && (MAP_FAILED == mmap(ring, ring_size,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_FIXED, fd, 0)
+                        || MAP_FAILED == mmap(ring + ring_size, ring_size,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_FIXED, fd, 0))) {
+                munmap(ring, 2 * ring_size);
+                ring = MAP_FAILED;
+        }
+        // The mappings keep the memory
+        close(fd);
+
+        if(ring == MAP_FAILED)
+                return NULL;
+        *size = ring_size;
+        return ring;
+#else
+        return NULL;
+#endif
+}
+
+static void ring_free(uint8_t *ring, size_t size)
+{
+        munmap(ring, 2 * size);
+}
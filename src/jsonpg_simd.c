@@ -0,0 +1,733 @@
+/*
+ * jsonpg - a JSON parser/generator
+ * © 2025 Bob Davison (see also: LICENSE)
+ *
+ * jsonpg_simd.c
+ *   vectorised scanning of input bytes
+ *   classification of input blocks into bit masks
+ *   validation of UTF-8
+ *
+ *   uses AVX2 or SSE2 (SSSE3 for UTF-8) when the compiler targets them
+ *   (e.g. -march=native) with a word at a time fallback
+ *
+ *   -DJSONPG_NO_SIMD forces the fallback
+ */
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(JSONPG_NO_SIMD) && defined(__AVX2__)
+#define JSONPG_SIMD_AVX2
+#include <immintrin.h>
+#elif !defined(JSONPG_NO_SIMD) && defined(__SSE2__)
+#define JSONPG_SIMD_SSE2
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#define JSONPG_SIMD_SSSE3
+#include <tmmintrin.h>
+#endif
+#endif
+#if !defined(JSONPG_NO_SIMD) && defined(__PCLMUL__)
+#include <wmmintrin.h>
+#endif
+
+#define SWAR_ONES  0x0101010101010101ULL
+#define SWAR_HIGHS 0x8080808080808080ULL
+
+// non-zero if any byte in x is zero
+#define SWAR_HAS_ZERO(x)       (((x) - SWAR_ONES) & ~(x) & SWAR_HIGHS)
+// non-zero if any byte in x is less than n (n <= 0x80)
+#define SWAR_HAS_LESS(x, n)    (((x) - SWAR_ONES * (n)) & ~(x) & SWAR_HIGHS)
+// high bit set in exactly those bytes of x that are zero
+#define SWAR_ZERO_BYTES(x)     (~((((x) & ~SWAR_HIGHS) + ~SWAR_HIGHS) | (x)) & SWAR_HIGHS)
+
+/*
+ * Returns non-zero if the byte cannot be part of a run
+ * of plain string bytes
+ */
+static int string_stop_byte(uint8_t c, uint8_t quote)
+{
+        return c == quote || c == '\\' || c < 0x20 || c >= 0x80;
+}
+
+/*
+ * Returns a pointer to the first byte in [pos, last) that ends a run
+ * of plain string bytes: the closing quote, a backslash, a control
+ * character or the start of a multi byte UTF-8 sequence
+ * Returns last if there is no such byte
+ *
+ * All skipped bytes are ones that the string states map to themselves
+ */
+static uint8_t *scan_string(uint8_t *pos, const uint8_t *last, uint8_t quote)
+{
+#if defined(JSONPG_SIMD_AVX2)
+        const __m256i q32 = _mm256_set1_epi8(quote);
+        const __m256i b32 = _mm256_set1_epi8('\\');
+        // signed compare so bytes >= 0x80 are also less than 0x20
+        const __m256i s32 = _mm256_set1_epi8(0x20);
+        while(last - pos >= 32) {
+                __m256i v = _mm256_loadu_si256((const __m256i *)pos);
+                __m256i m = _mm256_or_si256(
+                                _mm256_or_si256(
+                                        _mm256_cmpeq_epi8(v, q32),
+                                        _mm256_cmpeq_epi8(v, b32)),
+                                _mm256_cmpgt_epi8(s32, v));
+                uint32_t mask = (uint32_t)_mm256_movemask_epi8(m);
+                if(mask)
+                        return pos + __builtin_ctz(mask);
+                pos += 32;
+        }
+#endif
+#if defined(JSONPG_SIMD_AVX2) || defined(JSONPG_SIMD_SSE2)
+        const __m128i q16 = _mm_set1_epi8(quote);
+        const __m128i b16 = _mm_set1_epi8('\\');
+        const __m128i s16 = _mm_set1_epi8(0x20);
+        while(last - pos >= 16) {
+                __m128i v = _mm_loadu_si128((const __m128i *)pos);
+                __m128i m = _mm_or_si128(
+                                _mm_or_si128(
+                                        _mm_cmpeq_epi8(v, q16),
+                                        _mm_cmpeq_epi8(v, b16)),
+                                _mm_cmpgt_epi8(s16, v));
+                uint32_t mask = (uint32_t)_mm_movemask_epi8(m);
+                if(mask)
+                        return pos + __builtin_ctz(mask);
+                pos += 16;
+        }
+#else
+        const uint64_t q8 = SWAR_ONES * quote;
+        const uint64_t b8 = SWAR_ONES * '\\';
+        while(last - pos >= 8) {
+                uint64_t w;
+                memcpy(&w, pos, 8);
+                if((w & SWAR_HIGHS)
+                                || SWAR_HAS_LESS(w, 0x20)
+                                || SWAR_HAS_ZERO(w ^ q8)
+                                || SWAR_HAS_ZERO(w ^ b8))
+                        break;
+                pos += 8;
+        }
+#endif
+        while(pos < last && !string_stop_byte(*pos, quote))
+                pos++;
+
+        return pos;
+}
+
+/*
+ * UTF-8 validation by lookup tables, after Keiser and Lemire
+ *
+ * Each byte is checked with the byte before it by looking up the high
+ * and low nibbles of the previous byte and the high nibble of the byte
+ * in tables of the errors that each nibble could take part in, a bit is
+ * only set in all three lookups for a real error. The bytes that must be
+ * the 3rd or 4th byte of a sequence are found separately
+ */
+#define UTF8_TOO_SHORT          (1 << 0) // 11______ 0_______ or 11______
+#define UTF8_TOO_LONG           (1 << 1) // 0_______ 10______
+#define UTF8_OVERLONG_3         (1 << 2) // 11100000 100_____
+#define UTF8_TOO_LARGE          (1 << 3) // 11110100 1001____ or 101_____
+#define UTF8_SURROGATE          (1 << 4) // 11101101 101_____
+#define UTF8_OVERLONG_2         (1 << 5) // 1100000_ 10______
+#define UTF8_TOO_LARGE_1000     (1 << 6) // 11110101+ 1000____
+#define UTF8_OVERLONG_4         (1 << 6) // 11110000 1000____
+#define UTF8_TWO_CONTS          (1 << 7) // 10______ 10______
+#define UTF8_CARRY              (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#if defined(JSONPG_SIMD_AVX2) || defined(JSONPG_SIMD_SSSE3)
+static const uint8_t utf8_byte_1_high[16] = {
+        // 0_______ ascii
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        // 10______ continuation
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        // 1100____ 2 byte leader
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        // 1101____ 2 byte leader
+        UTF8_TOO_SHORT,
+        // 1110____ 3 byte leader
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        // 1111____ 4 byte leader
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+};
+
+static const uint8_t utf8_byte_1_low[16] = {
+        // ____0000
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        // ____0001
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        // ____001_
+        UTF8_CARRY,
+        UTF8_CARRY,
+        // ____0100
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        // ____0101 to ____1100
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        // ____1101
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        // ____111_
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+};
+
+static const uint8_t utf8_byte_2_high[16] = {
+        // ________ 0_______ ascii
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        // ________ 1000____
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS
+                | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        // ________ 1001____
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS
+                | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        // ________ 101_____
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS
+                | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS
+                | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        // ________ 11______ leader
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+// Non-zero where a sequence is cut off at the end of a vector
+static const uint8_t utf8_max[32] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1
+};
+
+/*
+ * Returns the number of bytes at the end of [bytes, end) that start
+ * a multi byte sequence too long to fit
+ */
+static size_t utf8_incomplete(const uint8_t *bytes, const uint8_t *end)
+{
+        for(size_t n = 1 ; n <= 3 && end - n >= bytes ; n++) {
+                uint8_t c = end[-n];
+                if(c < 0x80)
+                        return 0;
+                if(c >= 0xC0) {
+                        size_t need = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : 2;
+                        return (need > n) ? n : 0;
+                }
+        }
+        return 0;
+}
+#endif
+
+#if defined(JSONPG_SIMD_AVX2)
+#define UTF8_VECTOR 32
+
+static __m256i utf8_lookup(const uint8_t *table, __m256i nibbles)
+{
+        __m256i t = _mm256_broadcastsi128_si256(
+                        _mm_loadu_si128((const __m128i *)table));
+        return _mm256_shuffle_epi8(t, nibbles);
+}
+
+/*
+ * Returns non-zero bytes where input, following prev, is not valid
+ */
+static __m256i utf8_errors(__m256i input, __m256i prev)
+{
+        const __m256i low = _mm256_set1_epi8(0x0F);
+        __m256i shifted = _mm256_permute2x128_si256(prev, input, 0x21);
+        __m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+        __m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+        __m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+
+        __m256i special = _mm256_and_si256(
+                        _mm256_and_si256(
+                                utf8_lookup(utf8_byte_1_high, _mm256_and_si256(
+                                                _mm256_srli_epi16(prev1, 4), low)),
+                                utf8_lookup(utf8_byte_1_low, _mm256_and_si256(prev1, low))),
+                        utf8_lookup(utf8_byte_2_high, _mm256_and_si256(
+                                        _mm256_srli_epi16(input, 4), low)));
+
+        // High bit set after a 3 or 4 byte leader
+        __m256i must_23 = _mm256_or_si256(
+                        _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xE0 - 0x80)),
+                        _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xF0 - 0x80)));
+        return _mm256_xor_si256(
+                        _mm256_and_si256(must_23, _mm256_set1_epi8((char)0x80)),
+                        special);
+}
+
+/*
+ * Returns count if [bytes, bytes + count) is valid UTF-8, otherwise
+ * a sequence boundary before the vector holding the first error
+ */
+static size_t utf8_vector_prefix(const uint8_t *bytes, size_t count)
+{
+        const __m256i max = _mm256_loadu_si256((const __m256i *)utf8_max);
+        __m256i prev = _mm256_setzero_si256();
+        __m256i incomplete = _mm256_setzero_si256();
+        uint8_t tail[UTF8_VECTOR];
+
+        for(size_t done = 0 ; done < count ; done += UTF8_VECTOR) {
+                __m256i v;
+                if(count - done >= UTF8_VECTOR) {
+                        v = _mm256_loadu_si256((const __m256i *)(bytes + done));
+                } else {
+                        // Padding is ascii so a sequence cut off is an error
+                        memset(tail, 0, UTF8_VECTOR);
+                        memcpy(tail, bytes + done, count - done);
+                        v = _mm256_loadu_si256((const __m256i *)tail);
+                }
+                __m256i error = incomplete;
+                if(_mm256_movemask_epi8(v)) {
+                        error = utf8_errors(v, prev);
+                        incomplete = _mm256_subs_epu8(v, max);
+                }
+                if(!_mm256_testz_si256(error, error))
+                        return done - utf8_incomplete(bytes, bytes + done);
+                prev = v;
+        }
+        if(!_mm256_testz_si256(incomplete, incomplete))
+                return count - utf8_incomplete(bytes, bytes + count);
+        return count;
+}
+#elif defined(JSONPG_SIMD_SSSE3)
+#define UTF8_VECTOR 16
+
+static int utf8_any(__m128i v)
+{
+        return 0xFFFF != _mm_movemask_epi8(
+                        _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+}
+
+static __m128i utf8_lookup(const uint8_t *table, __m128i nibbles)
+{
+        return _mm_shuffle_epi8(
+                        _mm_loadu_si128((const __m128i *)table), nibbles);
+}
+
+/*
+ * Returns non-zero bytes where input, following prev, is not valid
+ */
+static __m128i utf8_errors(__m128i input, __m128i prev)
+{
+        const __m128i low = _mm_set1_epi8(0x0F);
+        __m128i prev1 = _mm_alignr_epi8(input, prev, 15);
+        __m128i prev2 = _mm_alignr_epi8(input, prev, 14);
+        __m128i prev3 = _mm_alignr_epi8(input, prev, 13);
+
+        __m128i special = _mm_and_si128(
+                        _mm_and_si128(
+                                utf8_lookup(utf8_byte_1_high, _mm_and_si128(
+                                                _mm_srli_epi16(prev1, 4), low)),
+                                utf8_lookup(utf8_byte_1_low, _mm_and_si128(prev1, low))),
+                        utf8_lookup(utf8_byte_2_high, _mm_and_si128(
+                                        _mm_srli_epi16(input, 4), low)));
+
+        // High bit set after a 3 or 4 byte leader
+        __m128i must_23 = _mm_or_si128(
+                        _mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80)),
+                        _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80)));
+        return _mm_xor_si128(
+                        _mm_and_si128(must_23, _mm_set1_epi8((char)0x80)),
+                        special);
+}
+
+/*
+ * Returns count if [bytes, bytes + count) is valid UTF-8, otherwise
+ * a sequence boundary before the vector holding the first error
+ */
+static size_t utf8_vector_prefix(const uint8_t *bytes, size_t count)
+{
+        const __m128i max = _mm_loadu_si128((const __m128i *)(utf8_max + 16));
+        __m128i prev = _mm_setzero_si128();
+        __m128i incomplete = _mm_setzero_si128();
+        uint8_t tail[UTF8_VECTOR];
+
+        for(size_t done = 0 ; done < count ; done += UTF8_VECTOR) {
+                __m128i v;
+                if(count - done >= UTF8_VECTOR) {
+                        v = _mm_loadu_si128((const __m128i *)(bytes + done));
+                } else {
+                        // Padding is ascii so a sequence cut off is an error
+                        memset(tail, 0, UTF8_VECTOR);
+                        memcpy(tail, bytes + done, count - done);
+                        v = _mm_loadu_si128((const __m128i *)tail);
+                }
+                __m128i error = incomplete;
+                if(_mm_movemask_epi8(v)) {
+                        error = utf8_errors(v, prev);
+                        incomplete = _mm_subs_epu8(v, max);
+                }
+                if(utf8_any(error))
+                        return done - utf8_incomplete(bytes, bytes + done);
+                prev = v;
+        }
+        if(utf8_any(incomplete))
+                return count - utf8_incomplete(bytes, bytes + count);
+        return count;
+}
+#endif
+
+/*
+ * Returns the length of the longest prefix of [bytes, bytes + count)
+ * that is valid UTF-8 ending with a complete sequence
+ *
+ * Vectors find the first error, if any, and the sequences
+ * from there are checked one at a time for the exact position
+ */
+static size_t valid_utf8_prefix(const uint8_t *bytes, size_t count)
+{
+        size_t done = 0;
+#ifdef UTF8_VECTOR
+        if(count >= UTF8_VECTOR / 2) {
+                done = utf8_vector_prefix(bytes, count);
+                if(done == count)
+                        return count;
+        }
+#endif
+        while(done < count) {
+                if(count - done >= 8) {
+                        uint64_t w;
+                        memcpy(&w, bytes + done, 8);
+                        if(!(w & SWAR_HIGHS)) {
+                                done += 8;
+                                continue;
+                        }
+                }
+                if(bytes[done] < 0x80) {
+                        done++;
+                        continue;
+                }
+                int length = valid_utf8_sequence((uint8_t *)bytes + done, count - done);
+                if(!length)
+                        break;
+                done += length;
+        }
+        return done;
+}
+
+static int valid_utf8(const uint8_t *bytes, size_t count)
+{
+        return valid_utf8_prefix(bytes, count) == count;
+}
+
+/*
+ * Returns a pointer to the end of the run of valid multi byte UTF-8
+ * sequences starting at pos, or pos if the first is invalid
+ *
+ * The run ends at the first ascii byte, a sequence that is invalid
+ * or cut off by last is left for the caller
+ */
+static uint8_t *scan_utf8(uint8_t *pos, const uint8_t *last)
+{
+        uint8_t *end = pos;
+#if defined(JSONPG_SIMD_AVX2)
+        while(last - end >= 32) {
+                uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+                                _mm256_loadu_si256((const __m256i *)end));
+                if(mask != 0xFFFFFFFF)
+                        break;
+                end += 32;
+        }
+#endif
+#if defined(JSONPG_SIMD_AVX2) || defined(JSONPG_SIMD_SSE2)
+        while(last - end >= 16) {
+                uint32_t mask = (uint32_t)_mm_movemask_epi8(
+                                _mm_loadu_si128((const __m128i *)end));
+                if(mask != 0xFFFF)
+                        break;
+                end += 16;
+        }
+#endif
+        while(end < last && *end >= 0x80)
+                end++;
+
+        return pos + valid_utf8_prefix(pos, end - pos);
+}
+
+static int whitespace_byte(uint8_t c)
+{
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/*
+ * Returns a pointer to the first byte in [pos, last) that is not
+ * JSON whitespace, or last if there is no such byte
+ *
+ * Minified input and the single space after a key rarely get past
+ * the first check, pretty printed newline and indentation runs
+ * are skipped a vector (or word) at a time
+ */
+static uint8_t *skip_whitespace(uint8_t *pos, const uint8_t *last)
+{
+        if(pos < last && !whitespace_byte(*pos))
+                return pos;
+
+#if defined(JSONPG_SIMD_AVX2)
+        const __m256i sp32 = _mm256_set1_epi8(' ');
+        const __m256i nl32 = _mm256_set1_epi8('\n');
+        const __m256i cr32 = _mm256_set1_epi8('\r');
+        const __m256i tb32 = _mm256_set1_epi8('\t');
+        while(last - pos >= 32) {
+                __m256i v = _mm256_loadu_si256((const __m256i *)pos);
+                __m256i m = _mm256_or_si256(
+                                _mm256_or_si256(
+                                        _mm256_cmpeq_epi8(v, sp32),
+                                        _mm256_cmpeq_epi8(v, nl32)),
+                                _mm256_or_si256(
+                                        _mm256_cmpeq_epi8(v, cr32),
+                                        _mm256_cmpeq_epi8(v, tb32)));
+                uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(m);
+                if(mask)
+                        return pos + __builtin_ctz(mask);
+                pos += 32;
+        }
+#endif
+#if defined(JSONPG_SIMD_AVX2) || defined(JSONPG_SIMD_SSE2)
+        const __m128i sp16 = _mm_set1_epi8(' ');
+        const __m128i nl16 = _mm_set1_epi8('\n');
+        const __m128i cr16 = _mm_set1_epi8('\r');
+        const __m128i tb16 = _mm_set1_epi8('\t');
+        while(last - pos >= 16) {
+                __m128i v = _mm_loadu_si128((const __m128i *)pos);
+                __m128i m = _mm_or_si128(
+                                _mm_or_si128(
+                                        _mm_cmpeq_epi8(v, sp16),
+                                        _mm_cmpeq_epi8(v, nl16)),
+                                _mm_or_si128(
+                                        _mm_cmpeq_epi8(v, cr16),
+                                        _mm_cmpeq_epi8(v, tb16)));
+                uint32_t mask = 0xFFFF & ~(uint32_t)_mm_movemask_epi8(m);
+                if(mask)
+                        return pos + __builtin_ctz(mask);
+                pos += 16;
+        }
+#else
+        while(last - pos >= 8) {
+                uint64_t w;
+                memcpy(&w, pos, 8);
+                uint64_t ws = SWAR_ZERO_BYTES(w ^ (SWAR_ONES * ' '))
+                        | SWAR_ZERO_BYTES(w ^ (SWAR_ONES * '\n'))
+                        | SWAR_ZERO_BYTES(w ^ (SWAR_ONES * '\r'))
+                        | SWAR_ZERO_BYTES(w ^ (SWAR_ONES * '\t'));
+                if(ws != SWAR_HIGHS)
+                        break;
+                pos += 8;
+        }
+#endif
+        while(pos < last && whitespace_byte(*pos))
+                pos++;
+
+        return pos;
+}
+
+/*
+ * Bit masks for a 64 byte block of input, bit n is for byte n
+ */
+struct block_masks {
+        uint64_t quote;
+        uint64_t backslash;
+        uint64_t whitespace;
+        uint64_t op;            // { } [ ] , :
+        uint64_t control;       // < 0x20
+        uint64_t high;          // >= 0x80
+};
+
+#if defined(JSONPG_SIMD_AVX2)
+static uint64_t block_bits(__m256i lo, __m256i hi)
+{
+        uint64_t l = (uint32_t)_mm256_movemask_epi8(lo);
+        uint64_t h = (uint32_t)_mm256_movemask_epi8(hi);
+        return l | (h << 32);
+}
+
+/*
+ * Whitespace and ops are found by looking up the low nibble of each byte
+ * in a table holding the only byte with that low nibble that can match
+ * Ops are compared with 0x20 set so [ and ] match as { and }
+ */
+static void classify_32(__m256i v, __m256i *ws, __m256i *op)
+{
+        const __m256i ws_table = _mm256_setr_epi8(
+                        ' ', 100, 100, 100, 17, 100, 113, 2,
+                        100, '\t', '\n', 112, 100, '\r', 100, 100,
+                        ' ', 100, 100, 100, 17, 100, 113, 2,
+                        100, '\t', '\n', 112, 100, '\r', 100, 100);
+        const __m256i op_table = _mm256_setr_epi8(
+                        0, 0, 0, 0, 0, 0, 0, 0,
+                        0, 0, ':', '{', ',', '}', 0, 0,
+                        0, 0, 0, 0, 0, 0, 0, 0,
+                        0, 0, ':', '{', ',', '}', 0, 0);
+        *ws = _mm256_cmpeq_epi8(v, _mm256_shuffle_epi8(ws_table, v));
+        *op = _mm256_cmpeq_epi8(
+                        _mm256_or_si256(v, _mm256_set1_epi8(0x20)),
+                        _mm256_shuffle_epi8(op_table, v));
+}
+#elif defined(JSONPG_SIMD_SSE2)
+static uint64_t block_eq(const __m128i *v, uint8_t c)
+{
+        const __m128i c16 = _mm_set1_epi8(c);
+        uint64_t mask = 0;
+        for(int i = 0 ; i < 4 ; i++)
+                mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(
+                                _mm_cmpeq_epi8(v[i], c16)) << (16 * i);
+        return mask;
+}
+#endif
+
+/*
+ * Classifies the 64 bytes at block
+ */
+static void classify_block(const uint8_t *block, struct block_masks *m)
+{
+#if defined(JSONPG_SIMD_AVX2)
+        __m256i lo = _mm256_loadu_si256((const __m256i *)block);
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+        const __m256i q = _mm256_set1_epi8('"');
+        const __m256i b = _mm256_set1_epi8('\\');
+        // signed compare so bytes >= 0x80 are also less than 0x20
+        const __m256i s = _mm256_set1_epi8(0x20);
+        __m256i ws_lo, ws_hi, op_lo, op_hi;
+        classify_32(lo, &ws_lo, &op_lo);
+        classify_32(hi, &ws_hi, &op_hi);
+        m->quote = block_bits(_mm256_cmpeq_epi8(lo, q), _mm256_cmpeq_epi8(hi, q));
+        m->backslash = block_bits(_mm256_cmpeq_epi8(lo, b), _mm256_cmpeq_epi8(hi, b));
+        m->whitespace = block_bits(ws_lo, ws_hi);
+        m->op = block_bits(op_lo, op_hi);
+        m->high = block_bits(lo, hi);
+        m->control = block_bits(_mm256_cmpgt_epi8(s, lo), _mm256_cmpgt_epi8(s, hi))
+                & ~m->high;
+#elif defined(JSONPG_SIMD_SSE2)
+        __m128i v[4];
+        for(int i = 0 ; i < 4 ; i++)
+                v[i] = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+        m->quote = block_eq(v, '"');
+        m->backslash = block_eq(v, '\\');
+        m->whitespace = block_eq(v, ' ') | block_eq(v, '\n')
+                | block_eq(v, '\r') | block_eq(v, '\t');
+        m->op = block_eq(v, '{') | block_eq(v, '}')
+                | block_eq(v, '[') | block_eq(v, ']')
+                | block_eq(v, ',') | block_eq(v, ':');
+        const __m128i s = _mm_set1_epi8(0x20);
+        m->control = m->high = 0;
+        for(int i = 0 ; i < 4 ; i++) {
+                m->control |= (uint64_t)(uint32_t)_mm_movemask_epi8(
+                                _mm_cmpgt_epi8(s, v[i])) << (16 * i);
+                m->high |= (uint64_t)(uint32_t)_mm_movemask_epi8(v[i]) << (16 * i);
+        }
+        m->control &= ~m->high;
+#else
+        *m = (struct block_masks){ 0 };
+        for(int i = 0 ; i < 64 ; i++) {
+                uint64_t bit = 1ULL << i;
+                switch(block[i]) {
+                case '"':
+                        m->quote |= bit;
+                        break;
+                case '\\':
+                        m->backslash |= bit;
+                        break;
+                case ' ': case '\n': case '\r': case '\t':
+                        m->whitespace |= bit;
+                        break;
+                case '{': case '}': case '[': case ']': case ',': case ':':
+                        m->op |= bit;
+                        break;
+                }
+                if(block[i] < 0x20)
+                        m->control |= bit;
+                else if(block[i] >= 0x80)
+                        m->high |= bit;
+        }
+#endif
+}
+
+/*
+ * Bit masks of the quotes, backslashes, opening and closing brackets
+ * in a 64 byte block, all that is needed to skip a value
+ */
+struct bracket_masks {
+        uint64_t quote;
+        uint64_t backslash;
+        uint64_t open;          // { [
+        uint64_t close;         // } ]
+};
+
+/*
+ * Classifies the 64 bytes at block, vector brackets are compared
+ * with 0x20 set so [ and ] match as { and }
+ */
+static void classify_brackets(const uint8_t *block, struct bracket_masks *m)
+{
+#if defined(JSONPG_SIMD_AVX2)
+        __m256i lo = _mm256_loadu_si256((const __m256i *)block);
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+        const __m256i q = _mm256_set1_epi8('"');
+        const __m256i b = _mm256_set1_epi8('\\');
+        const __m256i o = _mm256_set1_epi8('{');
+        const __m256i c = _mm256_set1_epi8('}');
+        const __m256i x = _mm256_set1_epi8(0x20);
+        __m256i lo_x = _mm256_or_si256(lo, x);
+        __m256i hi_x = _mm256_or_si256(hi, x);
+        m->quote = block_bits(_mm256_cmpeq_epi8(lo, q), _mm256_cmpeq_epi8(hi, q));
+        m->backslash = block_bits(_mm256_cmpeq_epi8(lo, b), _mm256_cmpeq_epi8(hi, b));
+        m->open = block_bits(_mm256_cmpeq_epi8(lo_x, o), _mm256_cmpeq_epi8(hi_x, o));
+        m->close = block_bits(_mm256_cmpeq_epi8(lo_x, c), _mm256_cmpeq_epi8(hi_x, c));
+#elif defined(JSONPG_SIMD_SSE2)
+        __m128i v[4], v_x[4];
+        const __m128i x = _mm_set1_epi8(0x20);
+        for(int i = 0 ; i < 4 ; i++) {
+                v[i] = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+                v_x[i] = _mm_or_si128(v[i], x);
+        }
+        m->quote = block_eq(v, '"');
+        m->backslash = block_eq(v, '\\');
+        m->open = block_eq(v_x, '{');
+        m->close = block_eq(v_x, '}');
+#else
+        *m = (struct bracket_masks){ 0 };
+        for(int i = 0 ; i < 64 ; i++) {
+                uint64_t bit = 1ULL << i;
+                switch(block[i]) {
+                case '"':
+                        m->quote |= bit;
+                        break;
+                case '\\':
+                        m->backslash |= bit;
+                        break;
+                case '{': case '[':
+                        m->open |= bit;
+                        break;
+                case '}': case ']':
+                        m->close |= bit;
+                        break;
+                }
+        }
+#endif
+}
+
+/*
+ * Each bit of the result is the xor of that bit and all lower bits of x
+ * Turns a mask of quotes into a mask of the bytes between them
+ */
+static uint64_t prefix_xor(uint64_t x)
+{
+#if !defined(JSONPG_NO_SIMD) && defined(__PCLMUL__)
+        // carryless multiply by all ones
+        __m128i r = _mm_clmulepi64_si128(
+                        _mm_set_epi64x(0, x), _mm_set1_epi8(0xFF), 0);
+        return (uint64_t)_mm_cvtsi128_si64(r);
+#else
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
+#endif
+}
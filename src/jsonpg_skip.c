@@ -0,0 +1,229 @@
+/*
+ * jsonpg_skip.c
+ *   skipping values without producing their events
+ *
+ *   the rest of an object or array is scanned 64 bytes at a time for
+ *   quotes, backslashes and brackets only, strings are found as stage 1
+ *   of the structural index finds them and brackets outside them are
+ *   counted up to the one that closes the container
+ *
+ *   nothing is copied or converted and nothing in the skipped bytes is
+ *   checked beyond the nesting of brackets, which must fit on the stack,
+ *   and the type of the closing bracket
+ *
+ *   the structural index is restarted after the skipped bytes, with
+ *   comments, single quotes or unquoted strings, which change where
+ *   strings are, the events are pulled and dropped
+ */
+
+enum {
+        SKIP_NONE,
+        SKIP_VALUE,             // the next value has not started
+        SKIP_CONTAINER          // skip_depth deeper than the container
+};
+
+#define SKIP_PULL_FLAGS (JSONPG_FLAG_COMMENTS | JSONPG_FLAG_SINGLE_QUOTES \
+                | JSONPG_FLAG_UNQUOTED_KEYS | JSONPG_FLAG_UNQUOTED_STRINGS)
+
+// The bracket at pos closes the skipped container
+static jsonpg_type skip_close(jsonpg_parser p, uint8_t *pos)
+{
+        p->skipping = SKIP_NONE;
+        p->current = pos;
+        int in = peek_stack(&p->stack);
+        if((*pos == '}') != (in == STACK_OBJECT))
+                return parse_error(p);
+
+        jsonpg_type type = (in == STACK_OBJECT)
+                ? end_object()
+                : end_array();
+        p->current++;
+        if(p->use_index) {
+                index_restart(p->index, p->current);
+                p->state = expect_comma_or_close;
+        } else {
+                p->state = state_whitespace;
+                p->push_state = (p->stack.ptr > 0)
+                        ? state_w_after_value
+                        : state_error;
+        }
+        return type;
+}
+
+static jsonpg_type skip_overflow(jsonpg_parser p, uint8_t *pos)
+{
+        p->skipping = SKIP_NONE;
+        p->current = pos;
+        return set_result_error(p, JSONPG_ERROR_STACKOVERFLOW);
+}
+
+/*
+ * Scans the input left carrying on from the state saved by the last scan
+ *
+ * Returns JSONPG_NONE with the state saved when the input runs out
+ */
+static jsonpg_type skip_scan(jsonpg_parser p)
+{
+        uint8_t *pos = p->current;
+        const uint8_t *last = p->last;
+        size_t depth = p->skip_depth;
+        size_t room = p->stack.size - p->stack.ptr;
+        uint64_t in_string = p->skip_in_string ? ~0ULL : 0;
+        uint64_t escaped = p->skip_escaped;
+
+        for( ; last - pos >= 64 ; pos += 64) {
+                struct bracket_masks m;
+                classify_brackets(pos, &m);
+
+                uint64_t quote = m.quote & ~index_escaped(&escaped, m.backslash);
+                uint64_t string = prefix_xor(quote) ^ in_string;
+                in_string = (uint64_t)((int64_t)string >> 63);
+
+                uint64_t open = m.open & ~string;
+                uint64_t close = m.close & ~string;
+                size_t opens = __builtin_popcountll(open);
+                size_t closes = __builtin_popcountll(close);
+                if(closes <= depth && depth + opens <= room) {
+                        depth = depth + opens - closes;
+                        continue;
+                }
+
+                // The container closes or the stack overflows in this block
+                for(uint64_t b = open | close ; b ; b &= b - 1) {
+                        int i = __builtin_ctzll(b);
+                        if((open >> i) & 1) {
+                                if(++depth > room)
+                                        return skip_overflow(p, pos + i);
+                        } else if(depth-- == 0) {
+                                return skip_close(p, pos + i);
+                        }
+                }
+        }
+
+        for( ; pos < last ; pos++) {
+                if(escaped) {
+                        escaped = 0;
+                } else if(*pos == '\\') {
+                        escaped = 1;
+                } else if(*pos == '"') {
+                        in_string = ~in_string;
+                } else if(in_string) {
+                        continue;
+                } else if(*pos == '{' || *pos == '[') {
+                        if(++depth > room)
+                                return skip_overflow(p, pos);
+                } else if(*pos == '}' || *pos == ']') {
+                        if(depth-- == 0)
+                                return skip_close(p, pos);
+                }
+        }
+
+        p->current = pos;
+        p->skip_depth = depth;
+        p->skip_in_string = (in_string != 0);
+        p->skip_escaped = escaped;
+        return JSONPG_NONE;
+}
+
+// Pulls events until the container ends
+static jsonpg_type skip_pull(jsonpg_parser p)
+{
+        while(1) {
+                jsonpg_type type = p->parse_next(p);
+                if(type == JSONPG_NONE || type == JSONPG_NEED_MORE)
+                        return type;
+                if(type == JSONPG_ERROR || type == JSONPG_EOF
+                                || p->stack.ptr < p->skip_ptr) {
+                        p->skipping = SKIP_NONE;
+                        return type;
+                }
+        }
+}
+
+static jsonpg_type skip_container(jsonpg_parser p)
+{
+        if(p->flags & SKIP_PULL_FLAGS)
+                return skip_pull(p);
+
+        while(1) {
+                jsonpg_type type = skip_scan(p);
+                if(type != JSONPG_NONE)
+                        return type;
+
+                if(p->seen_eof) {
+                        p->skipping = SKIP_NONE;
+                        return parse_error(p);
+                } else if(p->no_refill) {
+                        return JSONPG_NONE;
+                } else if(p->input_is_fed) {
+                        return feed_park(p);
+                } else if(-1 == parser_read_next(p)) {
+                        p->skipping = SKIP_NONE;
+                        return file_read_error(p);
+                }
+        }
+}
+
+// Skips the rest of the container just begun
+static jsonpg_type skip_begun(jsonpg_parser p)
+{
+        p->skipping = SKIP_CONTAINER;
+        p->skip_ptr = p->stack.ptr;
+        p->skip_depth = 0;
+        p->skip_in_string = 0;
+        p->skip_escaped = 0;
+        return skip_container(p);
+}
+
+static jsonpg_type skip_value(jsonpg_parser p)
+{
+        p->skipping = SKIP_NONE;
+        jsonpg_type type = next_event(p);
+        if(type == JSONPG_BEGIN_OBJECT || type == JSONPG_BEGIN_ARRAY)
+                return skip_begun(p);
+        if(type == JSONPG_NONE || type == JSONPG_NEED_MORE)
+                p->skipping = SKIP_VALUE;
+        return type;
+}
+
+// jsonpg_skip() pulling projected events, in jsonpg_project.c
+static jsonpg_type project_skip(jsonpg_parser p);
+// jsonpg_skip() pulling the events of a query, in jsonpg_query.c
+static jsonpg_type query_skip(jsonpg_parser p);
+
+static jsonpg_type skip_resume(jsonpg_parser p)
+{
+        return (p->skipping == SKIP_VALUE)
+                ? skip_value(p)
+                : skip_container(p);
+}
+
+/*
+ * Skips a value while pulling events with jsonpg_parse_next(), called
+ * straight after JSONPG_BEGIN_OBJECT or JSONPG_BEGIN_ARRAY it skips the
+ * rest of the object or array, anywhere else the next value, such as
+ * the value of a member after JSONPG_KEY
+ *
+ * Returns the last event of what was skipped, JSONPG_END_OBJECT or
+ * JSONPG_END_ARRAY, or for a next value that is not an object or array
+ * the value as jsonpg_parse_next() returns it, or JSONPG_ERROR
+ *
+ * Input that runs out part way returns JSONPG_NEED_MORE when fed, or
+ * JSONPG_NONE from jsonpg_parse_batch(), and jsonpg_parse_next() carries
+ * on skipping with the next input
+ */
+jsonpg_type jsonpg_skip(jsonpg_parser p)
+{
+        if(p->query)
+                return query_skip(p);
+        if(p->project)
+                return project_skip(p);
+        int begun = p->use_index
+                ? (p->state == expect_value_or_close
+                        || p->state == expect_key_or_close)
+                : (p->state == state_whitespace
+                        && p->push_state == state_w_value_or_close);
+        return begun
+                ? skip_begun(p)
+                : skip_value(p);
+}
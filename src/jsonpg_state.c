@@ -4,8 +4,7 @@
 
 #include <stdint.h>
 
-// Macros for code produced by gen_state
-#define if_config(X)            (p->flags & (X))
+// Macros for code produced by gen_state, if_config() is defined per variant
 #define accept_null(X)          ((X), JSONPG_NULL)
 #define accept_true(X)          ((X), JSONPG_TRUE)
 #define accept_false(X)         ((X), JSONPG_FALSE)
@@ -33,6 +32,85 @@
 #define process_escape_chars(X) process_escape_chars(p, (X))
 #define process_escape_u(X)     process_escape_u(p, (X))
 
+/*
+ * Two layouts of the transition table, JSONPG_BYTE_CLASSES selects
+ * byte_class[] and a state x class table, a few KB smaller than the
+ * state x byte table at the cost of a second dependent load per byte
+ */
+#ifdef JSONPG_BYTE_CLASSES
+#define BYTE_CLASS_COUNT 47
+
+uint8_t byte_class[256] = {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x00, 0x00, 0x02, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x03, 0x04, 0x05, 0x04, 0x04, 0x04, 0x04, 0x06, 0x04, 0x04, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C,
+        0x0D, 0x0E, 0x0E, 0x0E, 0x0E, 0x0E, 0x0E, 0x0E, 0x0F, 0x0F, 0x10, 0x04, 0x04, 0x04, 0x04, 0x04,
+        0x04, 0x11, 0x11, 0x12, 0x13, 0x14, 0x12, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04,
+        0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x15, 0x16, 0x17, 0x04, 0x04,
+        0x04, 0x18, 0x19, 0x12, 0x1A, 0x1B, 0x1C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x1D, 0x04, 0x1E, 0x04,
+        0x04, 0x04, 0x1F, 0x20, 0x21, 0x22, 0x04, 0x04, 0x04, 0x04, 0x04, 0x23, 0x04, 0x24, 0x04, 0x04,
+        0x25, 0x25, 0x25, 0x25, 0x25, 0x25, 0x25, 0x25, 0x25, 0x25, 0x25, 0x25, 0x25, 0x25, 0x25, 0x25,
+        0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26, 0x26,
+        0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27,
+        0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27, 0x27,
+        0x00, 0x00, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28,
+        0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28,
+        0x29, 0x2A, 0x2A, 0x2A, 0x2A, 0x2A, 0x2A, 0x2A, 0x2A, 0x2A, 0x2A, 0x2A, 0x2A, 0x2B, 0x2A, 0x2A,
+        0x2C, 0x2D, 0x2D, 0x2D, 0x2E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+uint8_t state_class_map[][BYTE_CLASS_COUNT] = {
+        {0x80, 0x00, 0x00, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x81, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+        {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+        {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x03, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+        {0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x00, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02},
+        {0x04, 0x04, 0x00, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04},
+        {0x82, 0x82, 0x82, 0x82, 0x82, 0x89, 0x8A, 0x82, 0x82, 0x82, 0x86, 0x82, 0x82, 0x87, 0x88, 0x88, 0x82, 0x82, 0x82, 0x82, 0x82, 0x8C, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x85, 0x82, 0x83, 0x82, 0x82, 0x84, 0x82, 0x8B, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82, 0x82},
+        {0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8E, 0x8F, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D, 0x8D},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x90, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x92, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x94, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x93, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91, 0x91},
+        {0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x97, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x96, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95, 0x95},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0C, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x98, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0E, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x99, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x11, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x12, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x13, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x9A, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x15, 0x16, 0x16, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9C, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9D, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9D, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B},
+        {0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9E, 0x9B, 0x16, 0x16, 0x16, 0x9B, 0x9B, 0x9B, 0x9B, 0x9F, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9F, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B, 0x9B},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x18, 0x18, 0x18, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0x18, 0x18, 0x18, 0xA0, 0xA0, 0xA0, 0xA0, 0x19, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0x19, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x1A, 0xFF, 0x1A, 0xFF, 0xFF, 0x1B, 0x1B, 0x1B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x1B, 0x1B, 0x1B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0x1B, 0x1B, 0x1B, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0, 0xA0},
+        {0xFF, 0xFF, 0xFF, 0x1C, 0x1C, 0xA2, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0xA1, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0xFF, 0xFF, 0xFF, 0x23, 0x1F, 0x24, 0x20, 0x21, 0x25, 0x22},
+        {0xFF, 0xFF, 0xFF, 0x1D, 0x1D, 0x1D, 0xA3, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0xA1, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0x1D, 0xFF, 0xFF, 0xFF, 0x23, 0x1F, 0x24, 0x20, 0x21, 0x25, 0x22},
+        {0xFF, 0xFF, 0xFF, 0xA5, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0xA4, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0xFF, 0xFF, 0xFF, 0x23, 0x1F, 0x24, 0x20, 0x21, 0x25, 0x22},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x23, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x23, 0x23, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x24, 0x24, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x24, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xA6, 0xA6, 0xA6, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x23, 0x23, 0x23, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x24, 0x24, 0x24, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xA7, 0xA8, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xA7, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xA7, 0xFF, 0xFF, 0xA7, 0xFF, 0xFF, 0xA7, 0xFF, 0xA7, 0xA7, 0xFF, 0xA7, 0xA9, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAB, 0xAB, 0xAB, 0xFF, 0xAB, 0xAB, 0xAD, 0xAB, 0xFF, 0xFF, 0xFF, 0xAB, 0xAB, 0xAC, 0xAB, 0xAB, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x2C, 0x2C, 0xAE, 0xFF, 0xAE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAE, 0xAE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAF, 0xAF, 0xAF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAF, 0xAF, 0xAF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x2C, 0x2C, 0x2C, 0xFF, 0x2C, 0x2C, 0x2C, 0x2C, 0xFF, 0xFF, 0xFF, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x2D, 0x2D, 0x2D, 0xFF, 0x2D, 0x2D, 0x2D, 0x2D, 0xFF, 0xFF, 0xFF, 0x2D, 0x2D, 0x2D, 0x2D, 0x2D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xB0, 0xB0, 0xB0, 0xFF, 0xB0, 0xB0, 0xB0, 0xB0, 0xFF, 0xFF, 0xFF, 0xB0, 0xB0, 0xB0, 0xB0, 0xB0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x2F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x28, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}
+};
+#define state_lookup(S, B)      state_class_map[(S)][byte_class[(B)]]
+#else
 uint8_t state_map[][256] = {
         {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0x00, 0x80, 0x80, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x81, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80}, 
         {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 
@@ -75,7 +153,7 @@ uint8_t state_map[][256] = {
         {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xA7, 0xFF, 0xFF, 0xFF, 0xFF, 0xA8, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xA7, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xA7, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xA7, 0xFF, 0xFF, 0xFF, 0xA7, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xA7, 0xFF, 0xFF, 0xFF, 0xA7, 0xFF, 0xA7, 0xA9, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, 
         {0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA}, 
         {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAB, 0xAB, 0xAB, 0xAB, 0xAB, 0xAB, 0xAB, 0xAB, 0xAB, 0xAB, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAB, 0xAB, 0xAB, 0xAD, 0xAB, 0xAB, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAB, 0xAB, 0xAB, 0xAC, 0xAB, 0xAB, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, 
-        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAE, 0xAE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAE, 0xAE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAE, 0xAE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, 
+        {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0xAE, 0xAE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAE, 0xAE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAE, 0xAE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, 
         {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAF, 0xAF, 0xAF, 0xAF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xAF, 0xAF, 0xAF, 0xAF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, 
         {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0x2C, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, 
         {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x2D, 0x2D, 0x2D, 0x2D, 0x2D, 0x2D, 0x2D, 0x2D, 0x2D, 0x2D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x2D, 0x2D, 0x2D, 0x2D, 0x2D, 0x2D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x2D, 0x2D, 0x2D, 0x2D, 0x2D, 0x2D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, 
@@ -83,6 +161,8 @@ uint8_t state_map[][256] = {
         {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x2F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, 
         {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x28, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}
 };
+#define state_lookup(S, B)      state_map[(S)][(B)]
+#endif
 
 typedef enum {
         state_whitespace,
@@ -94,7 +174,7 @@ typedef enum {
         state_w_key,
         state_w_after_key,
         state_w_after_value,
-        state_value_or_close,
+        state_w_value_or_close,
         state_null_2,
         state_null_3,
         state_null_4,
@@ -137,6 +217,23 @@ typedef enum {
         state_error   = JSONPG_STATE_ERROR
 } state;
 
+/*
+ * Called in a state entered on a UTF-8 leader byte, skips the run
+ * of valid multi byte sequences that it starts leaving the last
+ * continuation byte, so the string state is selected as usual
+ */
+static void skip_utf8(jsonpg_parser p, const uint8_t *last)
+{
+        // Not entered part way through a sequence
+        if(p->current[-1] < 0xC0)
+                return;
+        uint8_t *end = scan_utf8(p->current - 1, last);
+        if(end > p->current) {
+                p->current = end - 1;
+                p->state = state_continuation_1;
+        }
+}
+
 #ifdef JSONPG_DEBUG
 char *states[256] = {
         [state_whitespace] = "state_whitespace",
@@ -148,7 +245,7 @@ char *states[256] = {
         [state_w_key] = "state_w_key",
         [state_w_after_key] = "state_w_after_key",
         [state_w_after_value] = "state_w_after_value",
-        [state_value_or_close] = "state_value_or_close",
+        [state_w_value_or_close] = "state_w_value_or_close",
         [state_null_2] = "state_null_2",
         [state_null_3] = "state_null_3",
         [state_null_4] = "state_null_4",
@@ -211,8 +308,8 @@ char *states[256] = {
         [0x93] = "w_after_value/'}'",
         [0x94] = "w_after_value/']'",
         [0x95] = "maybe_after_separator/???",
-        [0x96] = "value_or_close/'}'",
-        [0x97] = "value_or_close/']'",
+        [0x96] = "w_value_or_close/'}'",
+        [0x97] = "w_value_or_close/']'",
         [0x98] = "null_4/'l'",
         [0x99] = "true_4/'e'",
         [0x9A] = "false_5/'e'",
@@ -241,7 +338,15 @@ char *states[256] = {
 };
 #endif
 
-jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
+/*
+ * The parser below is repeated for each variant that gen_state
+ * specializes on the config flags, if_config() is a constant in
+ * all but the last so the disabled branches are compiled away
+ */
+#define parse_variant           parse_next_strict
+#define if_config(X)            (0 & (X))
+
+static jsonpg_type parse_variant(jsonpg_parser p) {
         static void* dispatch_table[0x80] = {
                         &&L0x80,
                         &&L0x81,
@@ -302,14 +407,24 @@ jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
                                 : state_w_value;
                 p->state = state_whitespace;
         }
-        str_buf_reset(p->write_buf);
+        // The last call ended a document, the next starts in place
+        if(p->push_state == state_error
+                        && p->state == state_whitespace
+                        && p->stack.ptr == p->stack.ptr_min
+                        && (p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE)) {
+                p->push_state = state_w_value;
+                return JSONPG_END_DOCUMENT;
+        }
+        // A token in progress was paused by jsonpg_parse_batch()
+        if(p->token_ptr == 0)
+                str_buf_reset(p->write_buf);
         jsonpg_type result = JSONPG_NONE;
         state new_state;
 
         while(1) {
                 const uint8_t *last = p->last;
                 while(p->current < last) {
-                        state current_state = state_map[p->state][*p->current];
+                        state current_state = state_lookup(p->state, *p->current);
 
                         JSONPG_LOG("State change: %s [%02X:%c] => %s\n", 
                                         states[p->state],
@@ -323,6 +438,39 @@ jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
                         if(current_state == jump_state) {
                                 p->state = current_state;
                                 p->current++;
+
+                                // Skip runs of bytes that leave the state unchanged
+                                switch(current_state) {
+                                case state_whitespace:
+                                        p->current = skip_whitespace(p->current, last);
+                                        break;
+                                case state_block_comment:
+                                        p->current = scan_string(p->current, last, 0x2A);
+                                        break;
+                                case state_line_comment:
+                                        p->current = scan_string(p->current, last, 0x5C);
+                                        break;
+                                case state_string:
+                                        p->current = scan_string(p->current, last, 0x22);
+                                        break;
+                                case state_sq_string:
+                                        p->current = scan_string(p->current, last, 0x27);
+                                        break;
+                                case state_nq_string:
+                                        p->current = scan_string(p->current, last, 0x20);
+                                        break;
+                                case state_check_e0:
+                                case state_check_ed:
+                                case state_check_f0:
+                                case state_check_f4:
+                                case state_continuation_1:
+                                case state_continuation_2:
+                                case state_continuation_3:
+                                        skip_utf8(p, last);
+                                        break;
+                                default:
+                                        break;
+                                }
                                 continue;
                         }
                         
@@ -341,7 +489,7 @@ jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
                                         goto Linc;
                                 } else {
                                         new_state = pop_state();
-                                        goto Linc;
+                                        goto Lnoinc;
                                 }
                                 goto Lerror;
                         L0x82:
@@ -398,12 +546,14 @@ jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
                         L0x8B:
                                 // w_value/'{'
                                 result = begin_object();
-                                new_state = state_value_or_close;
+                                push_state(state_w_value_or_close);
+                                new_state = state_whitespace;
                                 goto Linc;
                         L0x8C:
                                 // w_value/'['
                                 result = begin_array();
-                                new_state = state_value_or_close;
+                                push_state(state_w_value_or_close);
+                                new_state = state_whitespace;
                                 goto Linc;
                         L0x8D:
                                 // [virtual] w_key/???
@@ -464,7 +614,8 @@ jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
                         L0x92:
                                 // w_after_value/','
                                 if(if_config(config_trailing_commas)) {
-                                        new_state = state_value_or_close;
+                                        push_state(state_w_value_or_close);
+                                        new_state = state_whitespace;
                                         goto Linc;
                                 } else {
                                         if(in_object()) {
@@ -560,7 +711,7 @@ jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
                                 new_state = state_whitespace;
                                 goto Lnoinc;
                         L0x96:
-                                // value_or_close/'}'
+                                // w_value_or_close/'}'
                                 if(in_object()) {
                                         result = end_object();
                                         if(in_object()) {
@@ -579,7 +730,7 @@ jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
                                 }
                                 goto Lerror;
                         L0x97:
-                                // value_or_close/']'
+                                // w_value_or_close/']'
                                 if(in_array()) {
                                         result = end_array();
                                         if(in_object()) {
@@ -974,13 +1125,2481 @@ jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
                                 return accept_real(pop_token());
                         }
 
-                        return (p->push_state == state_error
+                        // Or nothing at all after the last document, or
+                        // after a member of the implied is_object/is_array
+                        int at_end = (p->push_state == state_error)
+                                || (p->push_state == state_w_value
+                                        && (p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE))
+                                || (p->push_state == state_w_after_value
+                                        && p->stack.ptr_min);
+                        return (at_end
                                         && p->token_ptr == 0 
                                         && p->stack.ptr == p->stack.ptr_min)
                                ? JSONPG_EOF
                                : parse_error(p);
+                } else if(p->no_refill) {
+                        return JSONPG_NONE;
+                } else if(p->input_is_fed) {
+                        return feed_park(p);
                 } else if(-1 == parser_read_next(p)) {
                         return file_read_error(p);
                 }
         }
 }
+
+#undef parse_variant
+#undef if_config
+#define parse_variant           parse_next_comments
+#define if_config(X)            (config_comments & (X))
+
+static jsonpg_type parse_variant(jsonpg_parser p) {
+        static void* dispatch_table[0x80] = {
+                        &&L0x80,
+                        &&L0x81,
+                        &&L0x82,
+                        &&L0x83,
+                        &&L0x84,
+                        &&L0x85,
+                        &&L0x86,
+                        &&L0x87,
+                        &&L0x88,
+                        &&L0x89,
+                        &&L0x8A,
+                        &&L0x8B,
+                        &&L0x8C,
+                        &&L0x8D,
+                        &&L0x8E,
+                        &&L0x8F,
+                        &&L0x90,
+                        &&L0x91,
+                        &&L0x92,
+                        &&L0x93,
+                        &&L0x94,
+                        &&L0x95,
+                        &&L0x96,
+                        &&L0x97,
+                        &&L0x98,
+                        &&L0x99,
+                        &&L0x9A,
+                        &&L0x9B,
+                        &&L0x9C,
+                        &&L0x9D,
+                        &&L0x9E,
+                        &&L0x9F,
+                        &&L0xA0,
+                        &&L0xA1,
+                        &&L0xA2,
+                        &&L0xA3,
+                        &&L0xA4,
+                        &&L0xA5,
+                        &&L0xA6,
+                        &&L0xA7,
+                        &&L0xA8,
+                        &&L0xA9,
+                        &&L0xAA,
+                        &&L0xAB,
+                        &&L0xAC,
+                        &&L0xAD,
+                        &&L0xAE,
+                        &&L0xAF,
+                        &&L0xB0,
+                [0x7F] = &&Lerror      
+        };
+
+        if(p->state == state_initial) {
+                p->push_state = 
+                        (p->flags & JSONPG_FLAG_IS_OBJECT)
+                                ? state_w_key
+                                : state_w_value;
+                p->state = state_whitespace;
+        }
+        // The last call ended a document, the next starts in place
+        if(p->push_state == state_error
+                        && p->state == state_whitespace
+                        && p->stack.ptr == p->stack.ptr_min
+                        && (p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE)) {
+                p->push_state = state_w_value;
+                return JSONPG_END_DOCUMENT;
+        }
+        // A token in progress was paused by jsonpg_parse_batch()
+        if(p->token_ptr == 0)
+                str_buf_reset(p->write_buf);
+        jsonpg_type result = JSONPG_NONE;
+        state new_state;
+
+        while(1) {
+                const uint8_t *last = p->last;
+                while(p->current < last) {
+                        state current_state = state_lookup(p->state, *p->current);
+
+                        JSONPG_LOG("State change: %s [%02X:%c] => %s\n", 
+                                        states[p->state],
+                                        *p->current,
+                                        log_printablechar(*p->current),
+                                        states[current_state]);
+
+                        state jump_state = current_state & 0x7F;
+
+                        //if(!(current_state & 0x80)) {
+                        if(current_state == jump_state) {
+                                p->state = current_state;
+                                p->current++;
+
+                                // Skip runs of bytes that leave the state unchanged
+                                switch(current_state) {
+                                case state_whitespace:
+                                        p->current = skip_whitespace(p->current, last);
+                                        break;
+                                case state_block_comment:
+                                        p->current = scan_string(p->current, last, 0x2A);
+                                        break;
+                                case state_line_comment:
+                                        p->current = scan_string(p->current, last, 0x5C);
+                                        break;
+                                case state_string:
+                                        p->current = scan_string(p->current, last, 0x22);
+                                        break;
+                                case state_sq_string:
+                                        p->current = scan_string(p->current, last, 0x27);
+                                        break;
+                                case state_nq_string:
+                                        p->current = scan_string(p->current, last, 0x20);
+                                        break;
+                                case state_check_e0:
+                                case state_check_ed:
+                                case state_check_f0:
+                                case state_check_f4:
+                                case state_continuation_1:
+                                case state_continuation_2:
+                                case state_continuation_3:
+                                        skip_utf8(p, last);
+                                        break;
+                                default:
+                                        break;
+                                }
+                                continue;
+                        }
+                        
+                        //state new_state = state_error;
+                        //int incr = 1;
+                        //switch((int)current_state) {
+                        goto *dispatch_table[jump_state];
+                        L0x80:
+                                // [virtual] whitespace/???
+                                new_state = pop_state();
+                                goto Lnoinc;
+                        L0x81:
+                                // whitespace/'/'
+                                if(if_config(config_comments)) {
+                                        new_state = state_comment_leader;
+                                        goto Linc;
+                                } else {
+                                        new_state = pop_state();
+                                        goto Lnoinc;
+                                }
+                                goto Lerror;
+                        L0x82:
+                                // [virtual] w_value/???
+                                if(if_config(config_unquoted_strings)) {
+                                        push_token(token_nq_string);
+                                        new_state = state_nq_string;
+                                        goto Lnoinc;
+                                }
+                                goto Lerror;
+                        L0x83:
+                                // w_value/'n'
+                                push_token(token_null);
+                                new_state = state_null_2;
+                                goto Linc;
+                        L0x84:
+                                // w_value/'t'
+                                push_token(token_true);
+                                new_state = state_true_2;
+                                goto Linc;
+                        L0x85:
+                                // w_value/'f'
+                                push_token(token_false);
+                                new_state = state_false_2;
+                                goto Linc;
+                        L0x86:
+                                // w_value/'-'
+                                push_token(token_integer);
+                                new_state = state_minus;
+                                goto Linc;
+                        L0x87:
+                                // w_value/'0'
+                                push_token(token_integer);
+                                new_state = state_zero_integer;
+                                goto Linc;
+                        L0x88:
+                                // w_value/$1-9
+                                push_token(token_integer);
+                                new_state = state_integer;
+                                goto Linc;
+                        L0x89:
+                                // w_value/'"'
+                                push_token(token_string);
+                                new_state = state_string;
+                                goto Linc;
+                        L0x8A:
+                                // w_value/'''
+                                if(if_config(config_single_quotes)) {
+                                        push_token(token_sq_string);
+                                        new_state = state_sq_string;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x8B:
+                                // w_value/'{'
+                                result = begin_object();
+                                push_state(state_w_value_or_close);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x8C:
+                                // w_value/'['
+                                result = begin_array();
+                                push_state(state_w_value_or_close);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x8D:
+                                // [virtual] w_key/???
+                                if(if_config(config_unquoted_keys)) {
+                                        push_token(token_nq_key);
+                                        new_state = state_nq_string;
+                                        goto Lnoinc;
+                                }
+                                goto Lerror;
+                        L0x8E:
+                                // w_key/'"'
+                                push_token(token_key);
+                                new_state = state_string;
+                                goto Linc;
+                        L0x8F:
+                                // w_key/'''
+                                if(if_config(config_single_quotes)) {
+                                        push_token(token_sq_key);
+                                        new_state = state_sq_string;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x90:
+                                // value/???
+                                push_state(state_w_value);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x91:
+                                // [virtual] w_after_value/???
+                                if(if_config(config_optional_commas)) {
+                                        if(in_object()) {
+                                                if(in_object()) {
+                                                        push_state(state_w_key);
+                                                        new_state = state_whitespace;
+                                                        goto Lnoinc;
+                                                } else {
+                                                        push_state(state_w_value);
+                                                        new_state = state_whitespace;
+                                                        goto Lnoinc;
+                                                }
+                                        }
+                                        if(in_array()) {
+                                                if(in_object()) {
+                                                        push_state(state_w_key);
+                                                        new_state = state_whitespace;
+                                                        goto Lnoinc;
+                                                } else {
+                                                        push_state(state_w_value);
+                                                        new_state = state_whitespace;
+                                                        goto Lnoinc;
+                                                }
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                goto Lerror;
+                        L0x92:
+                                // w_after_value/','
+                                if(if_config(config_trailing_commas)) {
+                                        push_state(state_w_value_or_close);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                } else {
+                                        if(in_object()) {
+                                                if(in_object()) {
+                                                        push_state(state_w_key);
+                                                        new_state = state_whitespace;
+                                                        goto Linc;
+                                                } else {
+                                                        push_state(state_w_value);
+                                                        new_state = state_whitespace;
+                                                        goto Linc;
+                                                }
+                                        }
+                                        if(in_array()) {
+                                                if(in_object()) {
+                                                        push_state(state_w_key);
+                                                        new_state = state_whitespace;
+                                                        goto Linc;
+                                                } else {
+                                                        push_state(state_w_value);
+                                                        new_state = state_whitespace;
+                                                        goto Linc;
+                                                }
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x93:
+                                // w_after_value/'}'
+                                if(in_object()) {
+                                        result = end_object();
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x94:
+                                // w_after_value/']'
+                                if(in_array()) {
+                                        result = end_array();
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x95:
+                                // [virtual] maybe_after_separator/???
+                                if(in_object()) {
+                                        if(in_object()) {
+                                                push_state(state_w_key);
+                                                new_state = state_whitespace;
+                                                goto Lnoinc;
+                                        } else {
+                                                push_state(state_w_value);
+                                                new_state = state_whitespace;
+                                                goto Lnoinc;
+                                        }
+                                }
+                                if(in_array()) {
+                                        if(in_object()) {
+                                                push_state(state_w_key);
+                                                new_state = state_whitespace;
+                                                goto Lnoinc;
+                                        } else {
+                                                push_state(state_w_value);
+                                                new_state = state_whitespace;
+                                                goto Lnoinc;
+                                        }
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Lnoinc;
+                        L0x96:
+                                // w_value_or_close/'}'
+                                if(in_object()) {
+                                        result = end_object();
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x97:
+                                // w_value_or_close/']'
+                                if(in_array()) {
+                                        result = end_array();
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x98:
+                                // null_4/'l'
+                                result = accept_null(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x99:
+                                // true_4/'e'
+                                result = accept_true(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x9A:
+                                // false_5/'e'
+                                result = accept_false(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x9B:
+                                // [virtual] after_integer/???
+                                result = accept_integer(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Lnoinc;
+                        L0x9C:
+                                // zero_integer/'.'
+                                swap_token(token_real);
+                                new_state = state_fraction_prefix;
+                                goto Linc;
+                        L0x9D:
+                                // zero_integer/$exponent
+                                swap_token(token_real);
+                                new_state = state_exponent_prefix;
+                                goto Linc;
+                        L0x9E:
+                                // integer/'.'
+                                swap_token(token_real);
+                                new_state = state_fraction_prefix;
+                                goto Linc;
+                        L0x9F:
+                                // integer/$exponent
+                                swap_token(token_real);
+                                new_state = state_exponent_prefix;
+                                goto Linc;
+                        L0xA0:
+                                // [virtual] after_real/???
+                                result = accept_real(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Lnoinc;
+                        L0xA1:
+                                // start_escape/???
+                                if(push_token(token_escape)) {
+                                        return alloc_error(p);
+                                }
+                                new_state = state_escape;
+                                goto Linc;
+                        L0xA2:
+                                // string/'"'
+                                if(ifpeek_token(token_string)) {
+                                        result = accept_string(pop_token());
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_key)) {
+                                                result = accept_key(pop_token());
+                                                push_state(state_w_after_key);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA3:
+                                // sq_string/'''
+                                if(ifpeek_token(token_sq_string)) {
+                                        result = accept_sq_string(pop_token());
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_sq_key)) {
+                                                result = accept_sq_key(pop_token());
+                                                push_state(state_w_after_key);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA4:
+                                // nq_string/'\'
+                                if(if_config(config_escape_characters)) {
+                                        if(push_token(token_escape_chars)) {
+                                                return alloc_error(p);
+                                        }
+                                        new_state = state_escape_chars;
+                                        goto Linc;
+                                } else {
+                                        if(push_token(token_escape)) {
+                                                return alloc_error(p);
+                                        }
+                                        new_state = state_escape;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0xA5:
+                                // nq_string/' '
+                                if(ifpeek_token(token_nq_string)) {
+                                        result = accept_nq_string(pop_token());
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_nq_key)) {
+                                                result = accept_nq_key(pop_token());
+                                                push_state(state_w_after_key);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA6:
+                                // select_string/???
+                                if(ifpeek_token(token_string) || ifpeek_token(token_key)) {
+                                        new_state = state_string;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_sq_string) || ifpeek_token(token_sq_key)) {
+                                                new_state = state_sq_string;
+                                                goto Linc;
+                                        } else {
+                                                new_state = state_nq_string;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA7:
+                                // end_escape/???
+                                if(process_escape(pop_token())) {
+                                        return alloc_error(p);
+                                }
+                                if(ifpeek_token(token_string) || ifpeek_token(token_key)) {
+                                        new_state = state_string;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_sq_string) || ifpeek_token(token_sq_key)) {
+                                                new_state = state_sq_string;
+                                                goto Linc;
+                                        } else {
+                                                new_state = state_nq_string;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA8:
+                                // escape/'''
+                                if(if_config(config_single_quotes)) {
+                                        if(process_escape(pop_token())) {
+                                                return alloc_error(p);
+                                        }
+                                        if(ifpeek_token(token_string) || ifpeek_token(token_key)) {
+                                                new_state = state_string;
+                                                goto Linc;
+                                        } else {
+                                                if(ifpeek_token(token_sq_string) || ifpeek_token(token_sq_key)) {
+                                                        new_state = state_sq_string;
+                                                        goto Linc;
+                                                } else {
+                                                        new_state = state_nq_string;
+                                                        goto Linc;
+                                                }
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA9:
+                                // escape/'u'
+                                swap_token(token_escape_u);
+                                new_state = state_hex_1;
+                                goto Linc;
+                        L0xAA:
+                                // escape_chars/...
+                                if(process_escape_chars(pop_token())) {
+                                        return alloc_error(p);
+                                }
+                                new_state = state_nq_string;
+                                goto Linc;
+                        L0xAB:
+                                // hex_1/$hex_digit
+                                if(!ifpeek_token(token_surrogate)) {
+                                        new_state = state_hex_2;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0xAC:
+                                // hex_1/'d'
+                                if(ifpeek_token(token_surrogate)) {
+                                        new_state = state_low_surrogate_2;
+                                        goto Linc;
+                                } else {
+                                        new_state = state_high_surrogate_2;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0xAD:
+                                // hex_1/'D'
+                                if(ifpeek_token(token_surrogate)) {
+                                        new_state = state_low_surrogate_2;
+                                        goto Linc;
+                                } else {
+                                        new_state = state_high_surrogate_2;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0xAE:
+                                // high_surrogate_2/$high_surrogate_2
+                                push_token(token_surrogate);
+                                new_state = state_hex_3;
+                                goto Linc;
+                        L0xAF:
+                                // low_surrogate_2/$low_surrogate_2
+                                pop_token();
+                                new_state = state_hex_3;
+                                goto Linc;
+                        L0xB0:
+                                // hex_4/$hex_digit
+                                if(ifpeek_token(token_surrogate)) {
+                                        new_state = state_low_surrogate;
+                                        goto Linc;
+                                }
+                                if(process_escape_u(pop_token())) {
+                                        return alloc_error(p);
+                                }
+                                if(ifpeek_token(token_string) || ifpeek_token(token_key)) {
+                                        new_state = state_string;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_sq_string) || ifpeek_token(token_sq_key)) {
+                                                new_state = state_sq_string;
+                                                goto Linc;
+                                        } else {
+                                                new_state = state_nq_string;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        Linc:
+                                p->current++;
+                        Lnoinc:
+                                if(new_state == state_error)
+                                        goto Lerror;
+
+                                p->state = new_state;
+                                
+                        //
+                        // if(new_state == state_error)
+                        //         return parse_error(p);
+                        //
+                        // JSONPG_LOG("New state: %s, use %s input\n",
+                        //                 states[new_state],
+                        //                 incr ? "next" : "same");
+                        //
+                        // p->state = new_state;
+                        // p->current += incr;
+                        //
+                        // if(result == JSONPG_NONE) {
+                        //         return result;
+                        // }
+
+                                if(result == JSONPG_NONE)
+                                        continue;
+                                
+                                return result;
+
+                        Lerror:
+                                return parse_error(p);
+                }
+                if(p->seen_eof) {
+
+                        JSONPG_LOG("Exiting... state=%s, push_state=%s token_ptr=%d, stack_ptr=%d\n",
+                                        states[p->state],
+                                        states[p->push_state],
+                                        p->token_ptr,
+                                        p->stack.ptr);
+
+                        // no whitespace after number leaves it dangling
+                        if(p->state == state_zero_integer
+                                        || p->state == state_integer) {
+                                p->push_state = state_error;
+                                p->state = state_whitespace;
+                                return accept_integer(pop_token());
+                        } else if(p->state == state_fraction
+                                        || p->state == state_exponent) {
+                                p->push_state = state_error;
+                                p->state = state_whitespace;
+                                return accept_real(pop_token());
+                        }
+
+                        // Or nothing at all after the last document, or
+                        // after a member of the implied is_object/is_array
+                        int at_end = (p->push_state == state_error)
+                                || (p->push_state == state_w_value
+                                        && (p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE))
+                                || (p->push_state == state_w_after_value
+                                        && p->stack.ptr_min);
+                        return (at_end
+                                        && p->token_ptr == 0 
+                                        && p->stack.ptr == p->stack.ptr_min)
+                               ? JSONPG_EOF
+                               : parse_error(p);
+                } else if(p->no_refill) {
+                        return JSONPG_NONE;
+                } else if(p->input_is_fed) {
+                        return feed_park(p);
+                } else if(-1 == parser_read_next(p)) {
+                        return file_read_error(p);
+                }
+        }
+}
+
+#undef parse_variant
+#undef if_config
+#define parse_variant           parse_next_relaxed
+#define if_config(X)            (config_all & (X))
+
+static jsonpg_type parse_variant(jsonpg_parser p) {
+        static void* dispatch_table[0x80] = {
+                        &&L0x80,
+                        &&L0x81,
+                        &&L0x82,
+                        &&L0x83,
+                        &&L0x84,
+                        &&L0x85,
+                        &&L0x86,
+                        &&L0x87,
+                        &&L0x88,
+                        &&L0x89,
+                        &&L0x8A,
+                        &&L0x8B,
+                        &&L0x8C,
+                        &&L0x8D,
+                        &&L0x8E,
+                        &&L0x8F,
+                        &&L0x90,
+                        &&L0x91,
+                        &&L0x92,
+                        &&L0x93,
+                        &&L0x94,
+                        &&L0x95,
+                        &&L0x96,
+                        &&L0x97,
+                        &&L0x98,
+                        &&L0x99,
+                        &&L0x9A,
+                        &&L0x9B,
+                        &&L0x9C,
+                        &&L0x9D,
+                        &&L0x9E,
+                        &&L0x9F,
+                        &&L0xA0,
+                        &&L0xA1,
+                        &&L0xA2,
+                        &&L0xA3,
+                        &&L0xA4,
+                        &&L0xA5,
+                        &&L0xA6,
+                        &&L0xA7,
+                        &&L0xA8,
+                        &&L0xA9,
+                        &&L0xAA,
+                        &&L0xAB,
+                        &&L0xAC,
+                        &&L0xAD,
+                        &&L0xAE,
+                        &&L0xAF,
+                        &&L0xB0,
+                [0x7F] = &&Lerror      
+        };
+
+        if(p->state == state_initial) {
+                p->push_state = 
+                        (p->flags & JSONPG_FLAG_IS_OBJECT)
+                                ? state_w_key
+                                : state_w_value;
+                p->state = state_whitespace;
+        }
+        // The last call ended a document, the next starts in place
+        if(p->push_state == state_error
+                        && p->state == state_whitespace
+                        && p->stack.ptr == p->stack.ptr_min
+                        && (p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE)) {
+                p->push_state = state_w_value;
+                return JSONPG_END_DOCUMENT;
+        }
+        // A token in progress was paused by jsonpg_parse_batch()
+        if(p->token_ptr == 0)
+                str_buf_reset(p->write_buf);
+        jsonpg_type result = JSONPG_NONE;
+        state new_state;
+
+        while(1) {
+                const uint8_t *last = p->last;
+                while(p->current < last) {
+                        state current_state = state_lookup(p->state, *p->current);
+
+                        JSONPG_LOG("State change: %s [%02X:%c] => %s\n", 
+                                        states[p->state],
+                                        *p->current,
+                                        log_printablechar(*p->current),
+                                        states[current_state]);
+
+                        state jump_state = current_state & 0x7F;
+
+                        //if(!(current_state & 0x80)) {
+                        if(current_state == jump_state) {
+                                p->state = current_state;
+                                p->current++;
+
+                                // Skip runs of bytes that leave the state unchanged
+                                switch(current_state) {
+                                case state_whitespace:
+                                        p->current = skip_whitespace(p->current, last);
+                                        break;
+                                case state_block_comment:
+                                        p->current = scan_string(p->current, last, 0x2A);
+                                        break;
+                                case state_line_comment:
+                                        p->current = scan_string(p->current, last, 0x5C);
+                                        break;
+                                case state_string:
+                                        p->current = scan_string(p->current, last, 0x22);
+                                        break;
+                                case state_sq_string:
+                                        p->current = scan_string(p->current, last, 0x27);
+                                        break;
+                                case state_nq_string:
+                                        p->current = scan_string(p->current, last, 0x20);
+                                        break;
+                                case state_check_e0:
+                                case state_check_ed:
+                                case state_check_f0:
+                                case state_check_f4:
+                                case state_continuation_1:
+                                case state_continuation_2:
+                                case state_continuation_3:
+                                        skip_utf8(p, last);
+                                        break;
+                                default:
+                                        break;
+                                }
+                                continue;
+                        }
+                        
+                        //state new_state = state_error;
+                        //int incr = 1;
+                        //switch((int)current_state) {
+                        goto *dispatch_table[jump_state];
+                        L0x80:
+                                // [virtual] whitespace/???
+                                new_state = pop_state();
+                                goto Lnoinc;
+                        L0x81:
+                                // whitespace/'/'
+                                if(if_config(config_comments)) {
+                                        new_state = state_comment_leader;
+                                        goto Linc;
+                                } else {
+                                        new_state = pop_state();
+                                        goto Lnoinc;
+                                }
+                                goto Lerror;
+                        L0x82:
+                                // [virtual] w_value/???
+                                if(if_config(config_unquoted_strings)) {
+                                        push_token(token_nq_string);
+                                        new_state = state_nq_string;
+                                        goto Lnoinc;
+                                }
+                                goto Lerror;
+                        L0x83:
+                                // w_value/'n'
+                                push_token(token_null);
+                                new_state = state_null_2;
+                                goto Linc;
+                        L0x84:
+                                // w_value/'t'
+                                push_token(token_true);
+                                new_state = state_true_2;
+                                goto Linc;
+                        L0x85:
+                                // w_value/'f'
+                                push_token(token_false);
+                                new_state = state_false_2;
+                                goto Linc;
+                        L0x86:
+                                // w_value/'-'
+                                push_token(token_integer);
+                                new_state = state_minus;
+                                goto Linc;
+                        L0x87:
+                                // w_value/'0'
+                                push_token(token_integer);
+                                new_state = state_zero_integer;
+                                goto Linc;
+                        L0x88:
+                                // w_value/$1-9
+                                push_token(token_integer);
+                                new_state = state_integer;
+                                goto Linc;
+                        L0x89:
+                                // w_value/'"'
+                                push_token(token_string);
+                                new_state = state_string;
+                                goto Linc;
+                        L0x8A:
+                                // w_value/'''
+                                if(if_config(config_single_quotes)) {
+                                        push_token(token_sq_string);
+                                        new_state = state_sq_string;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x8B:
+                                // w_value/'{'
+                                result = begin_object();
+                                push_state(state_w_value_or_close);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x8C:
+                                // w_value/'['
+                                result = begin_array();
+                                push_state(state_w_value_or_close);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x8D:
+                                // [virtual] w_key/???
+                                if(if_config(config_unquoted_keys)) {
+                                        push_token(token_nq_key);
+                                        new_state = state_nq_string;
+                                        goto Lnoinc;
+                                }
+                                goto Lerror;
+                        L0x8E:
+                                // w_key/'"'
+                                push_token(token_key);
+                                new_state = state_string;
+                                goto Linc;
+                        L0x8F:
+                                // w_key/'''
+                                if(if_config(config_single_quotes)) {
+                                        push_token(token_sq_key);
+                                        new_state = state_sq_string;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x90:
+                                // value/???
+                                push_state(state_w_value);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x91:
+                                // [virtual] w_after_value/???
+                                if(if_config(config_optional_commas)) {
+                                        if(in_object()) {
+                                                if(in_object()) {
+                                                        push_state(state_w_key);
+                                                        new_state = state_whitespace;
+                                                        goto Lnoinc;
+                                                } else {
+                                                        push_state(state_w_value);
+                                                        new_state = state_whitespace;
+                                                        goto Lnoinc;
+                                                }
+                                        }
+                                        if(in_array()) {
+                                                if(in_object()) {
+                                                        push_state(state_w_key);
+                                                        new_state = state_whitespace;
+                                                        goto Lnoinc;
+                                                } else {
+                                                        push_state(state_w_value);
+                                                        new_state = state_whitespace;
+                                                        goto Lnoinc;
+                                                }
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                goto Lerror;
+                        L0x92:
+                                // w_after_value/','
+                                if(if_config(config_trailing_commas)) {
+                                        push_state(state_w_value_or_close);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                } else {
+                                        if(in_object()) {
+                                                if(in_object()) {
+                                                        push_state(state_w_key);
+                                                        new_state = state_whitespace;
+                                                        goto Linc;
+                                                } else {
+                                                        push_state(state_w_value);
+                                                        new_state = state_whitespace;
+                                                        goto Linc;
+                                                }
+                                        }
+                                        if(in_array()) {
+                                                if(in_object()) {
+                                                        push_state(state_w_key);
+                                                        new_state = state_whitespace;
+                                                        goto Linc;
+                                                } else {
+                                                        push_state(state_w_value);
+                                                        new_state = state_whitespace;
+                                                        goto Linc;
+                                                }
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x93:
+                                // w_after_value/'}'
+                                if(in_object()) {
+                                        result = end_object();
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x94:
+                                // w_after_value/']'
+                                if(in_array()) {
+                                        result = end_array();
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x95:
+                                // [virtual] maybe_after_separator/???
+                                if(in_object()) {
+                                        if(in_object()) {
+                                                push_state(state_w_key);
+                                                new_state = state_whitespace;
+                                                goto Lnoinc;
+                                        } else {
+                                                push_state(state_w_value);
+                                                new_state = state_whitespace;
+                                                goto Lnoinc;
+                                        }
+                                }
+                                if(in_array()) {
+                                        if(in_object()) {
+                                                push_state(state_w_key);
+                                                new_state = state_whitespace;
+                                                goto Lnoinc;
+                                        } else {
+                                                push_state(state_w_value);
+                                                new_state = state_whitespace;
+                                                goto Lnoinc;
+                                        }
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Lnoinc;
+                        L0x96:
+                                // w_value_or_close/'}'
+                                if(in_object()) {
+                                        result = end_object();
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x97:
+                                // w_value_or_close/']'
+                                if(in_array()) {
+                                        result = end_array();
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x98:
+                                // null_4/'l'
+                                result = accept_null(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x99:
+                                // true_4/'e'
+                                result = accept_true(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x9A:
+                                // false_5/'e'
+                                result = accept_false(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x9B:
+                                // [virtual] after_integer/???
+                                result = accept_integer(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Lnoinc;
+                        L0x9C:
+                                // zero_integer/'.'
+                                swap_token(token_real);
+                                new_state = state_fraction_prefix;
+                                goto Linc;
+                        L0x9D:
+                                // zero_integer/$exponent
+                                swap_token(token_real);
+                                new_state = state_exponent_prefix;
+                                goto Linc;
+                        L0x9E:
+                                // integer/'.'
+                                swap_token(token_real);
+                                new_state = state_fraction_prefix;
+                                goto Linc;
+                        L0x9F:
+                                // integer/$exponent
+                                swap_token(token_real);
+                                new_state = state_exponent_prefix;
+                                goto Linc;
+                        L0xA0:
+                                // [virtual] after_real/???
+                                result = accept_real(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Lnoinc;
+                        L0xA1:
+                                // start_escape/???
+                                if(push_token(token_escape)) {
+                                        return alloc_error(p);
+                                }
+                                new_state = state_escape;
+                                goto Linc;
+                        L0xA2:
+                                // string/'"'
+                                if(ifpeek_token(token_string)) {
+                                        result = accept_string(pop_token());
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_key)) {
+                                                result = accept_key(pop_token());
+                                                push_state(state_w_after_key);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA3:
+                                // sq_string/'''
+                                if(ifpeek_token(token_sq_string)) {
+                                        result = accept_sq_string(pop_token());
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_sq_key)) {
+                                                result = accept_sq_key(pop_token());
+                                                push_state(state_w_after_key);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA4:
+                                // nq_string/'\'
+                                if(if_config(config_escape_characters)) {
+                                        if(push_token(token_escape_chars)) {
+                                                return alloc_error(p);
+                                        }
+                                        new_state = state_escape_chars;
+                                        goto Linc;
+                                } else {
+                                        if(push_token(token_escape)) {
+                                                return alloc_error(p);
+                                        }
+                                        new_state = state_escape;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0xA5:
+                                // nq_string/' '
+                                if(ifpeek_token(token_nq_string)) {
+                                        result = accept_nq_string(pop_token());
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_nq_key)) {
+                                                result = accept_nq_key(pop_token());
+                                                push_state(state_w_after_key);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA6:
+                                // select_string/???
+                                if(ifpeek_token(token_string) || ifpeek_token(token_key)) {
+                                        new_state = state_string;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_sq_string) || ifpeek_token(token_sq_key)) {
+                                                new_state = state_sq_string;
+                                                goto Linc;
+                                        } else {
+                                                new_state = state_nq_string;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA7:
+                                // end_escape/???
+                                if(process_escape(pop_token())) {
+                                        return alloc_error(p);
+                                }
+                                if(ifpeek_token(token_string) || ifpeek_token(token_key)) {
+                                        new_state = state_string;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_sq_string) || ifpeek_token(token_sq_key)) {
+                                                new_state = state_sq_string;
+                                                goto Linc;
+                                        } else {
+                                                new_state = state_nq_string;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA8:
+                                // escape/'''
+                                if(if_config(config_single_quotes)) {
+                                        if(process_escape(pop_token())) {
+                                                return alloc_error(p);
+                                        }
+                                        if(ifpeek_token(token_string) || ifpeek_token(token_key)) {
+                                                new_state = state_string;
+                                                goto Linc;
+                                        } else {
+                                                if(ifpeek_token(token_sq_string) || ifpeek_token(token_sq_key)) {
+                                                        new_state = state_sq_string;
+                                                        goto Linc;
+                                                } else {
+                                                        new_state = state_nq_string;
+                                                        goto Linc;
+                                                }
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA9:
+                                // escape/'u'
+                                swap_token(token_escape_u);
+                                new_state = state_hex_1;
+                                goto Linc;
+                        L0xAA:
+                                // escape_chars/...
+                                if(process_escape_chars(pop_token())) {
+                                        return alloc_error(p);
+                                }
+                                new_state = state_nq_string;
+                                goto Linc;
+                        L0xAB:
+                                // hex_1/$hex_digit
+                                if(!ifpeek_token(token_surrogate)) {
+                                        new_state = state_hex_2;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0xAC:
+                                // hex_1/'d'
+                                if(ifpeek_token(token_surrogate)) {
+                                        new_state = state_low_surrogate_2;
+                                        goto Linc;
+                                } else {
+                                        new_state = state_high_surrogate_2;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0xAD:
+                                // hex_1/'D'
+                                if(ifpeek_token(token_surrogate)) {
+                                        new_state = state_low_surrogate_2;
+                                        goto Linc;
+                                } else {
+                                        new_state = state_high_surrogate_2;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0xAE:
+                                // high_surrogate_2/$high_surrogate_2
+                                push_token(token_surrogate);
+                                new_state = state_hex_3;
+                                goto Linc;
+                        L0xAF:
+                                // low_surrogate_2/$low_surrogate_2
+                                pop_token();
+                                new_state = state_hex_3;
+                                goto Linc;
+                        L0xB0:
+                                // hex_4/$hex_digit
+                                if(ifpeek_token(token_surrogate)) {
+                                        new_state = state_low_surrogate;
+                                        goto Linc;
+                                }
+                                if(process_escape_u(pop_token())) {
+                                        return alloc_error(p);
+                                }
+                                if(ifpeek_token(token_string) || ifpeek_token(token_key)) {
+                                        new_state = state_string;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_sq_string) || ifpeek_token(token_sq_key)) {
+                                                new_state = state_sq_string;
+                                                goto Linc;
+                                        } else {
+                                                new_state = state_nq_string;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        Linc:
+                                p->current++;
+                        Lnoinc:
+                                if(new_state == state_error)
+                                        goto Lerror;
+
+                                p->state = new_state;
+                                
+                        //
+                        // if(new_state == state_error)
+                        //         return parse_error(p);
+                        //
+                        // JSONPG_LOG("New state: %s, use %s input\n",
+                        //                 states[new_state],
+                        //                 incr ? "next" : "same");
+                        //
+                        // p->state = new_state;
+                        // p->current += incr;
+                        //
+                        // if(result == JSONPG_NONE) {
+                        //         return result;
+                        // }
+
+                                if(result == JSONPG_NONE)
+                                        continue;
+                                
+                                return result;
+
+                        Lerror:
+                                return parse_error(p);
+                }
+                if(p->seen_eof) {
+
+                        JSONPG_LOG("Exiting... state=%s, push_state=%s token_ptr=%d, stack_ptr=%d\n",
+                                        states[p->state],
+                                        states[p->push_state],
+                                        p->token_ptr,
+                                        p->stack.ptr);
+
+                        // no whitespace after number leaves it dangling
+                        if(p->state == state_zero_integer
+                                        || p->state == state_integer) {
+                                p->push_state = state_error;
+                                p->state = state_whitespace;
+                                return accept_integer(pop_token());
+                        } else if(p->state == state_fraction
+                                        || p->state == state_exponent) {
+                                p->push_state = state_error;
+                                p->state = state_whitespace;
+                                return accept_real(pop_token());
+                        }
+
+                        // Or nothing at all after the last document, or
+                        // after a member of the implied is_object/is_array
+                        int at_end = (p->push_state == state_error)
+                                || (p->push_state == state_w_value
+                                        && (p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE))
+                                || (p->push_state == state_w_after_value
+                                        && p->stack.ptr_min);
+                        return (at_end
+                                        && p->token_ptr == 0 
+                                        && p->stack.ptr == p->stack.ptr_min)
+                               ? JSONPG_EOF
+                               : parse_error(p);
+                } else if(p->no_refill) {
+                        return JSONPG_NONE;
+                } else if(p->input_is_fed) {
+                        return feed_park(p);
+                } else if(-1 == parser_read_next(p)) {
+                        return file_read_error(p);
+                }
+        }
+}
+
+#undef parse_variant
+#undef if_config
+#define parse_variant           parse_next_any
+#define if_config(X)            (p->flags & (X))
+
+static jsonpg_type parse_variant(jsonpg_parser p) {
+        static void* dispatch_table[0x80] = {
+                        &&L0x80,
+                        &&L0x81,
+                        &&L0x82,
+                        &&L0x83,
+                        &&L0x84,
+                        &&L0x85,
+                        &&L0x86,
+                        &&L0x87,
+                        &&L0x88,
+                        &&L0x89,
+                        &&L0x8A,
+                        &&L0x8B,
+                        &&L0x8C,
+                        &&L0x8D,
+                        &&L0x8E,
+                        &&L0x8F,
+                        &&L0x90,
+                        &&L0x91,
+                        &&L0x92,
+                        &&L0x93,
+                        &&L0x94,
+                        &&L0x95,
+                        &&L0x96,
+                        &&L0x97,
+                        &&L0x98,
+                        &&L0x99,
+                        &&L0x9A,
+                        &&L0x9B,
+                        &&L0x9C,
+                        &&L0x9D,
+                        &&L0x9E,
+                        &&L0x9F,
+                        &&L0xA0,
+                        &&L0xA1,
+                        &&L0xA2,
+                        &&L0xA3,
+                        &&L0xA4,
+                        &&L0xA5,
+                        &&L0xA6,
+                        &&L0xA7,
+                        &&L0xA8,
+                        &&L0xA9,
+                        &&L0xAA,
+                        &&L0xAB,
+                        &&L0xAC,
+                        &&L0xAD,
+                        &&L0xAE,
+                        &&L0xAF,
+                        &&L0xB0,
+                [0x7F] = &&Lerror      
+        };
+
+        if(p->state == state_initial) {
+                p->push_state = 
+                        (p->flags & JSONPG_FLAG_IS_OBJECT)
+                                ? state_w_key
+                                : state_w_value;
+                p->state = state_whitespace;
+        }
+        // The last call ended a document, the next starts in place
+        if(p->push_state == state_error
+                        && p->state == state_whitespace
+                        && p->stack.ptr == p->stack.ptr_min
+                        && (p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE)) {
+                p->push_state = state_w_value;
+                return JSONPG_END_DOCUMENT;
+        }
+        // A token in progress was paused by jsonpg_parse_batch()
+        if(p->token_ptr == 0)
+                str_buf_reset(p->write_buf);
+        jsonpg_type result = JSONPG_NONE;
+        state new_state;
+
+        while(1) {
+                const uint8_t *last = p->last;
+                while(p->current < last) {
+                        state current_state = state_lookup(p->state, *p->current);
+
+                        JSONPG_LOG("State change: %s [%02X:%c] => %s\n", 
+                                        states[p->state],
+                                        *p->current,
+                                        log_printablechar(*p->current),
+                                        states[current_state]);
+
+                        state jump_state = current_state & 0x7F;
+
+                        //if(!(current_state & 0x80)) {
+                        if(current_state == jump_state) {
+                                p->state = current_state;
+                                p->current++;
+
+                                // Skip runs of bytes that leave the state unchanged
+                                switch(current_state) {
+                                case state_whitespace:
+                                        p->current = skip_whitespace(p->current, last);
+                                        break;
+                                case state_block_comment:
+                                        p->current = scan_string(p->current, last, 0x2A);
+                                        break;
+                                case state_line_comment:
+                                        p->current = scan_string(p->current, last, 0x5C);
+                                        break;
+                                case state_string:
+                                        p->current = scan_string(p->current, last, 0x22);
+                                        break;
+                                case state_sq_string:
+                                        p->current = scan_string(p->current, last, 0x27);
+                                        break;
+                                case state_nq_string:
+                                        p->current = scan_string(p->current, last, 0x20);
+                                        break;
+                                case state_check_e0:
+                                case state_check_ed:
+                                case state_check_f0:
+                                case state_check_f4:
+                                case state_continuation_1:
+                                case state_continuation_2:
+                                case state_continuation_3:
+                                        skip_utf8(p, last);
+                                        break;
+                                default:
+                                        break;
+                                }
+                                continue;
+                        }
+                        
+                        //state new_state = state_error;
+                        //int incr = 1;
+                        //switch((int)current_state) {
+                        goto *dispatch_table[jump_state];
+                        L0x80:
+                                // [virtual] whitespace/???
+                                new_state = pop_state();
+                                goto Lnoinc;
+                        L0x81:
+                                // whitespace/'/'
+                                if(if_config(config_comments)) {
+                                        new_state = state_comment_leader;
+                                        goto Linc;
+                                } else {
+                                        new_state = pop_state();
+                                        goto Lnoinc;
+                                }
+                                goto Lerror;
+                        L0x82:
+                                // [virtual] w_value/???
+                                if(if_config(config_unquoted_strings)) {
+                                        push_token(token_nq_string);
+                                        new_state = state_nq_string;
+                                        goto Lnoinc;
+                                }
+                                goto Lerror;
+                        L0x83:
+                                // w_value/'n'
+                                push_token(token_null);
+                                new_state = state_null_2;
+                                goto Linc;
+                        L0x84:
+                                // w_value/'t'
+                                push_token(token_true);
+                                new_state = state_true_2;
+                                goto Linc;
+                        L0x85:
+                                // w_value/'f'
+                                push_token(token_false);
+                                new_state = state_false_2;
+                                goto Linc;
+                        L0x86:
+                                // w_value/'-'
+                                push_token(token_integer);
+                                new_state = state_minus;
+                                goto Linc;
+                        L0x87:
+                                // w_value/'0'
+                                push_token(token_integer);
+                                new_state = state_zero_integer;
+                                goto Linc;
+                        L0x88:
+                                // w_value/$1-9
+                                push_token(token_integer);
+                                new_state = state_integer;
+                                goto Linc;
+                        L0x89:
+                                // w_value/'"'
+                                push_token(token_string);
+                                new_state = state_string;
+                                goto Linc;
+                        L0x8A:
+                                // w_value/'''
+                                if(if_config(config_single_quotes)) {
+                                        push_token(token_sq_string);
+                                        new_state = state_sq_string;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x8B:
+                                // w_value/'{'
+                                result = begin_object();
+                                push_state(state_w_value_or_close);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x8C:
+                                // w_value/'['
+                                result = begin_array();
+                                push_state(state_w_value_or_close);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x8D:
+                                // [virtual] w_key/???
+                                if(if_config(config_unquoted_keys)) {
+                                        push_token(token_nq_key);
+                                        new_state = state_nq_string;
+                                        goto Lnoinc;
+                                }
+                                goto Lerror;
+                        L0x8E:
+                                // w_key/'"'
+                                push_token(token_key);
+                                new_state = state_string;
+                                goto Linc;
+                        L0x8F:
+                                // w_key/'''
+                                if(if_config(config_single_quotes)) {
+                                        push_token(token_sq_key);
+                                        new_state = state_sq_string;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x90:
+                                // value/???
+                                push_state(state_w_value);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x91:
+                                // [virtual] w_after_value/???
+                                if(if_config(config_optional_commas)) {
+                                        if(in_object()) {
+                                                if(in_object()) {
+                                                        push_state(state_w_key);
+                                                        new_state = state_whitespace;
+                                                        goto Lnoinc;
+                                                } else {
+                                                        push_state(state_w_value);
+                                                        new_state = state_whitespace;
+                                                        goto Lnoinc;
+                                                }
+                                        }
+                                        if(in_array()) {
+                                                if(in_object()) {
+                                                        push_state(state_w_key);
+                                                        new_state = state_whitespace;
+                                                        goto Lnoinc;
+                                                } else {
+                                                        push_state(state_w_value);
+                                                        new_state = state_whitespace;
+                                                        goto Lnoinc;
+                                                }
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                goto Lerror;
+                        L0x92:
+                                // w_after_value/','
+                                if(if_config(config_trailing_commas)) {
+                                        push_state(state_w_value_or_close);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                } else {
+                                        if(in_object()) {
+                                                if(in_object()) {
+                                                        push_state(state_w_key);
+                                                        new_state = state_whitespace;
+                                                        goto Linc;
+                                                } else {
+                                                        push_state(state_w_value);
+                                                        new_state = state_whitespace;
+                                                        goto Linc;
+                                                }
+                                        }
+                                        if(in_array()) {
+                                                if(in_object()) {
+                                                        push_state(state_w_key);
+                                                        new_state = state_whitespace;
+                                                        goto Linc;
+                                                } else {
+                                                        push_state(state_w_value);
+                                                        new_state = state_whitespace;
+                                                        goto Linc;
+                                                }
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x93:
+                                // w_after_value/'}'
+                                if(in_object()) {
+                                        result = end_object();
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x94:
+                                // w_after_value/']'
+                                if(in_array()) {
+                                        result = end_array();
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x95:
+                                // [virtual] maybe_after_separator/???
+                                if(in_object()) {
+                                        if(in_object()) {
+                                                push_state(state_w_key);
+                                                new_state = state_whitespace;
+                                                goto Lnoinc;
+                                        } else {
+                                                push_state(state_w_value);
+                                                new_state = state_whitespace;
+                                                goto Lnoinc;
+                                        }
+                                }
+                                if(in_array()) {
+                                        if(in_object()) {
+                                                push_state(state_w_key);
+                                                new_state = state_whitespace;
+                                                goto Lnoinc;
+                                        } else {
+                                                push_state(state_w_value);
+                                                new_state = state_whitespace;
+                                                goto Lnoinc;
+                                        }
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Lnoinc;
+                        L0x96:
+                                // w_value_or_close/'}'
+                                if(in_object()) {
+                                        result = end_object();
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x97:
+                                // w_value_or_close/']'
+                                if(in_array()) {
+                                        result = end_array();
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0x98:
+                                // null_4/'l'
+                                result = accept_null(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x99:
+                                // true_4/'e'
+                                result = accept_true(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x9A:
+                                // false_5/'e'
+                                result = accept_false(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Linc;
+                        L0x9B:
+                                // [virtual] after_integer/???
+                                result = accept_integer(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Lnoinc;
+                        L0x9C:
+                                // zero_integer/'.'
+                                swap_token(token_real);
+                                new_state = state_fraction_prefix;
+                                goto Linc;
+                        L0x9D:
+                                // zero_integer/$exponent
+                                swap_token(token_real);
+                                new_state = state_exponent_prefix;
+                                goto Linc;
+                        L0x9E:
+                                // integer/'.'
+                                swap_token(token_real);
+                                new_state = state_fraction_prefix;
+                                goto Linc;
+                        L0x9F:
+                                // integer/$exponent
+                                swap_token(token_real);
+                                new_state = state_exponent_prefix;
+                                goto Linc;
+                        L0xA0:
+                                // [virtual] after_real/???
+                                result = accept_real(pop_token());
+                                if(in_object()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                if(in_array()) {
+                                        push_state(state_w_after_value);
+                                        new_state = state_whitespace;
+                                        goto Lnoinc;
+                                }
+                                push_state(state_error);
+                                new_state = state_whitespace;
+                                goto Lnoinc;
+                        L0xA1:
+                                // start_escape/???
+                                if(push_token(token_escape)) {
+                                        return alloc_error(p);
+                                }
+                                new_state = state_escape;
+                                goto Linc;
+                        L0xA2:
+                                // string/'"'
+                                if(ifpeek_token(token_string)) {
+                                        result = accept_string(pop_token());
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_key)) {
+                                                result = accept_key(pop_token());
+                                                push_state(state_w_after_key);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA3:
+                                // sq_string/'''
+                                if(ifpeek_token(token_sq_string)) {
+                                        result = accept_sq_string(pop_token());
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_sq_key)) {
+                                                result = accept_sq_key(pop_token());
+                                                push_state(state_w_after_key);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA4:
+                                // nq_string/'\'
+                                if(if_config(config_escape_characters)) {
+                                        if(push_token(token_escape_chars)) {
+                                                return alloc_error(p);
+                                        }
+                                        new_state = state_escape_chars;
+                                        goto Linc;
+                                } else {
+                                        if(push_token(token_escape)) {
+                                                return alloc_error(p);
+                                        }
+                                        new_state = state_escape;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0xA5:
+                                // nq_string/' '
+                                if(ifpeek_token(token_nq_string)) {
+                                        result = accept_nq_string(pop_token());
+                                        if(in_object()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        if(in_array()) {
+                                                push_state(state_w_after_value);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                        push_state(state_error);
+                                        new_state = state_whitespace;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_nq_key)) {
+                                                result = accept_nq_key(pop_token());
+                                                push_state(state_w_after_key);
+                                                new_state = state_whitespace;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA6:
+                                // select_string/???
+                                if(ifpeek_token(token_string) || ifpeek_token(token_key)) {
+                                        new_state = state_string;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_sq_string) || ifpeek_token(token_sq_key)) {
+                                                new_state = state_sq_string;
+                                                goto Linc;
+                                        } else {
+                                                new_state = state_nq_string;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA7:
+                                // end_escape/???
+                                if(process_escape(pop_token())) {
+                                        return alloc_error(p);
+                                }
+                                if(ifpeek_token(token_string) || ifpeek_token(token_key)) {
+                                        new_state = state_string;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_sq_string) || ifpeek_token(token_sq_key)) {
+                                                new_state = state_sq_string;
+                                                goto Linc;
+                                        } else {
+                                                new_state = state_nq_string;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA8:
+                                // escape/'''
+                                if(if_config(config_single_quotes)) {
+                                        if(process_escape(pop_token())) {
+                                                return alloc_error(p);
+                                        }
+                                        if(ifpeek_token(token_string) || ifpeek_token(token_key)) {
+                                                new_state = state_string;
+                                                goto Linc;
+                                        } else {
+                                                if(ifpeek_token(token_sq_string) || ifpeek_token(token_sq_key)) {
+                                                        new_state = state_sq_string;
+                                                        goto Linc;
+                                                } else {
+                                                        new_state = state_nq_string;
+                                                        goto Linc;
+                                                }
+                                        }
+                                }
+                                goto Lerror;
+                        L0xA9:
+                                // escape/'u'
+                                swap_token(token_escape_u);
+                                new_state = state_hex_1;
+                                goto Linc;
+                        L0xAA:
+                                // escape_chars/...
+                                if(process_escape_chars(pop_token())) {
+                                        return alloc_error(p);
+                                }
+                                new_state = state_nq_string;
+                                goto Linc;
+                        L0xAB:
+                                // hex_1/$hex_digit
+                                if(!ifpeek_token(token_surrogate)) {
+                                        new_state = state_hex_2;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0xAC:
+                                // hex_1/'d'
+                                if(ifpeek_token(token_surrogate)) {
+                                        new_state = state_low_surrogate_2;
+                                        goto Linc;
+                                } else {
+                                        new_state = state_high_surrogate_2;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0xAD:
+                                // hex_1/'D'
+                                if(ifpeek_token(token_surrogate)) {
+                                        new_state = state_low_surrogate_2;
+                                        goto Linc;
+                                } else {
+                                        new_state = state_high_surrogate_2;
+                                        goto Linc;
+                                }
+                                goto Lerror;
+                        L0xAE:
+                                // high_surrogate_2/$high_surrogate_2
+                                push_token(token_surrogate);
+                                new_state = state_hex_3;
+                                goto Linc;
+                        L0xAF:
+                                // low_surrogate_2/$low_surrogate_2
+                                pop_token();
+                                new_state = state_hex_3;
+                                goto Linc;
+                        L0xB0:
+                                // hex_4/$hex_digit
+                                if(ifpeek_token(token_surrogate)) {
+                                        new_state = state_low_surrogate;
+                                        goto Linc;
+                                }
+                                if(process_escape_u(pop_token())) {
+                                        return alloc_error(p);
+                                }
+                                if(ifpeek_token(token_string) || ifpeek_token(token_key)) {
+                                        new_state = state_string;
+                                        goto Linc;
+                                } else {
+                                        if(ifpeek_token(token_sq_string) || ifpeek_token(token_sq_key)) {
+                                                new_state = state_sq_string;
+                                                goto Linc;
+                                        } else {
+                                                new_state = state_nq_string;
+                                                goto Linc;
+                                        }
+                                }
+                                goto Lerror;
+                        Linc:
+                                p->current++;
+                        Lnoinc:
+                                if(new_state == state_error)
+                                        goto Lerror;
+
+                                p->state = new_state;
+                                
+                        //
+                        // if(new_state == state_error)
+                        //         return parse_error(p);
+                        //
+                        // JSONPG_LOG("New state: %s, use %s input\n",
+                        //                 states[new_state],
+                        //                 incr ? "next" : "same");
+                        //
+                        // p->state = new_state;
+                        // p->current += incr;
+                        //
+                        // if(result == JSONPG_NONE) {
+                        //         return result;
+                        // }
+
+                                if(result == JSONPG_NONE)
+                                        continue;
+                                
+                                return result;
+
+                        Lerror:
+                                return parse_error(p);
+                }
+                if(p->seen_eof) {
+
+                        JSONPG_LOG("Exiting... state=%s, push_state=%s token_ptr=%d, stack_ptr=%d\n",
+                                        states[p->state],
+                                        states[p->push_state],
+                                        p->token_ptr,
+                                        p->stack.ptr);
+
+                        // no whitespace after number leaves it dangling
+                        if(p->state == state_zero_integer
+                                        || p->state == state_integer) {
+                                p->push_state = state_error;
+                                p->state = state_whitespace;
+                                return accept_integer(pop_token());
+                        } else if(p->state == state_fraction
+                                        || p->state == state_exponent) {
+                                p->push_state = state_error;
+                                p->state = state_whitespace;
+                                return accept_real(pop_token());
+                        }
+
+                        // Or nothing at all after the last document, or
+                        // after a member of the implied is_object/is_array
+                        int at_end = (p->push_state == state_error)
+                                || (p->push_state == state_w_value
+                                        && (p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE))
+                                || (p->push_state == state_w_after_value
+                                        && p->stack.ptr_min);
+                        return (at_end
+                                        && p->token_ptr == 0 
+                                        && p->stack.ptr == p->stack.ptr_min)
+                               ? JSONPG_EOF
+                               : parse_error(p);
+                } else if(p->no_refill) {
+                        return JSONPG_NONE;
+                } else if(p->input_is_fed) {
+                        return feed_park(p);
+                } else if(-1 == parser_read_next(p)) {
+                        return file_read_error(p);
+                }
+        }
+}
+
+static parse_next_fn parse_next_select(uint16_t flags)
+{
+        switch(flags & config_all) {
+        case 0:
+                return parse_next_strict;
+        case config_comments:
+                return parse_next_comments;
+        case config_all:
+                return parse_next_relaxed;
+        default:
+                return parse_next_any;
+        }
+}
+
+// Carries on skipping after jsonpg_skip() ran out of input, in jsonpg_skip.c
+static jsonpg_type skip_resume(jsonpg_parser p);
+// Events for the parser's projection, in jsonpg_project.c
+static jsonpg_type project_next(jsonpg_parser p);
+// Events for the parser's query, in jsonpg_query.c
+static jsonpg_type query_next(jsonpg_parser p);
+
+static jsonpg_type next_event(jsonpg_parser p)
+{
+        if(p->skipping)
+                return skip_resume(p);
+        if(p->use_index)
+                return index_parse_next(p);
+        return p->parse_next(p);
+}
+
+jsonpg_type jsonpg_parse_next(jsonpg_parser p)
+{
+        if(p->query)
+                return query_next(p);
+        if(p->project)
+                return project_next(p);
+        return next_event(p);
+}
@@ -4,8 +4,7 @@
 
 #include <stdint.h>
 
-// Macros for code produced by gen_state
-#define if_config(X)            (p->flags & (X))
+// Macros for code produced by gen_state, if_config() is defined per variant
 #define accept_null(X)          ((X), JSONPG_NULL)
 #define accept_true(X)          ((X), JSONPG_TRUE)
 #define accept_false(X)         ((X), JSONPG_FALSE)
@@ -33,10 +32,22 @@
 #define process_escape_chars(X) process_escape_chars(p, (X))
 #define process_escape_u(X)     process_escape_u(p, (X))
 
+/*
+ * Two layouts of the transition table, JSONPG_BYTE_CLASSES selects
+ * byte_class[] and a state x class table, a few KB smaller than the
+ * state x byte table at the cost of a second dependent load per byte
+ */
+#ifdef JSONPG_BYTE_CLASSES
+<= classes
+
+#define state_lookup(S, B)      state_class_map[(S)][byte_class[(B)]]
+#else
 uint8_t state_map[][256] = {
 <= map
 
 };
+#define state_lookup(S, B)      state_map[(S)][(B)]
+#endif
 
 typedef enum {
 <= enums
@@ -45,6 +56,23 @@ typedef enum {
         state_error   = JSONPG_STATE_ERROR
 } state;
 
+/*
+ * Called in a state entered on a UTF-8 leader byte, skips the run
+ * of valid multi byte sequences that it starts leaving the last
+ * continuation byte, so the string state is selected as usual
+ */
+static void skip_utf8(jsonpg_parser p, const uint8_t *last)
+{
+        // Not entered part way through a sequence
+        if(p->current[-1] < 0xC0)
+                return;
+        uint8_t *end = scan_utf8(p->current - 1, last);
+        if(end > p->current) {
+                p->current = end - 1;
+                p->state = state_continuation_1;
+        }
+}
+
 #ifdef JSONPG_DEBUG
 char *states[256] = {
 <= enum_names
@@ -56,7 +84,15 @@ char *states[256] = {
 };
 #endif
 
-jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
+/*
+ * The parser below is repeated for each variant that gen_state
+ * specializes on the config flags, if_config() is a constant in
+ * all but the last so the disabled branches are compiled away
+ */
+<= variant
+
+
+static jsonpg_type parse_variant(jsonpg_parser p) {
         static void* dispatch_table[0x80] = {
 <= gotos
 
@@ -70,14 +106,24 @@ jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
                                 : state_w_value;
                 p->state = state_whitespace;
         }
-        str_buf_reset(p->write_buf);
+        // The last call ended a document, the next starts in place
+        if(p->push_state == state_error
+                        && p->state == state_whitespace
+                        && p->stack.ptr == p->stack.ptr_min
+                        && (p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE)) {
+                p->push_state = state_w_value;
+                return JSONPG_END_DOCUMENT;
+        }
+        // A token in progress was paused by jsonpg_parse_batch()
+        if(p->token_ptr == 0)
+                str_buf_reset(p->write_buf);
         jsonpg_type result = JSONPG_NONE;
         state new_state;
 
         while(1) {
                 const uint8_t *last = p->last;
                 while(p->current < last) {
-                        state current_state = state_map[p->state][*p->current];
+                        state current_state = state_lookup(p->state, *p->current);
 
                         JSONPG_LOG("State change: %s [%02X:%c] => %s\n", 
                                         states[p->state],
@@ -91,6 +137,10 @@ jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
                         if(current_state == jump_state) {
                                 p->state = current_state;
                                 p->current++;
+
+                                // Skip runs of bytes that leave the state unchanged
+<= skips
+
                                 continue;
                         }
                         
@@ -152,13 +202,53 @@ jsonpg_type jsonpg_parse_next(jsonpg_parser p) {
                                 return accept_real(pop_token());
                         }
 
-                        return (p->push_state == state_error
+                        // Or nothing at all after the last document, or
+                        // after a member of the implied is_object/is_array
+                        int at_end = (p->push_state == state_error)
+                                || (p->push_state == state_w_value
+                                        && (p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE))
+                                || (p->push_state == state_w_after_value
+                                        && p->stack.ptr_min);
+                        return (at_end
                                         && p->token_ptr == 0 
                                         && p->stack.ptr == p->stack.ptr_min)
                                ? JSONPG_EOF
                                : parse_error(p);
+                } else if(p->no_refill) {
+                        return JSONPG_NONE;
+                } else if(p->input_is_fed) {
+                        return feed_park(p);
                 } else if(-1 == parser_read_next(p)) {
                         return file_read_error(p);
                 }
         }
 }
+<= end_variant
+
+<= select
+
+
+// Carries on skipping after jsonpg_skip() ran out of input, in jsonpg_skip.c
+static jsonpg_type skip_resume(jsonpg_parser p);
+// Events for the parser's projection, in jsonpg_project.c
+static jsonpg_type project_next(jsonpg_parser p);
+// Events for the parser's query, in jsonpg_query.c
+static jsonpg_type query_next(jsonpg_parser p);
+
+static jsonpg_type next_event(jsonpg_parser p)
+{
+        if(p->skipping)
+                return skip_resume(p);
+        if(p->use_index)
+                return index_parse_next(p);
+        return p->parse_next(p);
+}
+
+jsonpg_type jsonpg_parse_next(jsonpg_parser p)
+{
+        if(p->query)
+                return query_next(p);
+        if(p->project)
+                return project_next(p);
+        return next_event(p);
+}
@@ -7,14 +7,16 @@ struct str_buf_s {
         uint8_t *bytes;
         uint32_t count;
         uint32_t size;    
+        jsonpg_allocator *allocator;
 };
 
 
-static str_buf str_buf_empty()
+static str_buf str_buf_empty(jsonpg_allocator *allocator)
 {
-        str_buf sbuf = pg_alloc(sizeof(struct str_buf_s));
+        str_buf sbuf = al_alloc(allocator, sizeof(struct str_buf_s));
         if(!sbuf)
                 return NULL;
+        sbuf->allocator = allocator;
         sbuf->bytes = NULL;
         sbuf->count = 0;
         sbuf->size = 0;
@@ -31,9 +33,9 @@ static str_buf str_buf_alloc(str_buf sbuf, uint32_t size)
 {
         size = size >= JSONPG_BUF_SIZE ? size : JSONPG_BUF_SIZE;
 
-        sbuf->bytes = pg_alloc(size);
+        sbuf->bytes = al_alloc(sbuf->allocator, size);
         if(!sbuf->bytes) {
-                pg_dealloc(sbuf);
+                al_dealloc(sbuf->allocator, sbuf);
                 return NULL;
         }
         sbuf->size = size;
@@ -46,9 +48,9 @@ static str_buf str_buf_alloc_new(str_buf sbuf)
         return str_buf_alloc(sbuf, JSONPG_BUF_SIZE);
 }
 
-static str_buf str_buf_new(uint32_t size)
+static str_buf str_buf_new(uint32_t size, jsonpg_allocator *allocator)
 {
-        str_buf sbuf = str_buf_empty();
+        str_buf sbuf = str_buf_empty(allocator);
         if(!sbuf)
                 return NULL;
         return str_buf_alloc(sbuf, size);
@@ -57,8 +59,8 @@ static str_buf str_buf_new(uint32_t size)
 static void str_buf_free(str_buf sbuf)
 {
         if(sbuf) {
-                pg_dealloc(sbuf->bytes);
-                pg_dealloc(sbuf);
+                al_dealloc(sbuf->allocator, sbuf->bytes);
+                al_dealloc(sbuf->allocator, sbuf);
         }
 }
 
@@ -73,7 +75,7 @@ static int str_buf_append(str_buf sbuf, uint8_t *bytes, size_t count)
                 do {
                         sbuf->size <<= 1;
                 } while(new_count > sbuf->size);
-                uint8_t *b = pg_realloc(sbuf->bytes, sbuf->size);
+                uint8_t *b = al_realloc(sbuf->allocator, sbuf->bytes, sbuf->size);
                 if(!b) {
                         str_buf_free(sbuf);
                         return -1;
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <unistd.h>
 
 #include "jsonpg.c"
 
@@ -27,10 +28,92 @@ void tfree(void *p)
 }
 
 
+/*
+ * jsonpg_tests -c runs the checks, each prints its name and ok or
+ * FAILED, the exit status is the number that failed
+ */
+
+static int check(char *name, int ok)
+{
+        printf("%-40s %s\n", name, ok ? "ok" : "FAILED");
+        return !ok;
+}
+
+// Parses json with flags into a compact printer expecting printed
+static int check_printed(char *name, int16_t flags, char *json, char *expected)
+{
+        jsonpg_config c = jsonpg_config_get();
+        c.flags = flags;
+        jsonpg_parser p = jsonpg_parser_new(&c);
+        jsonpg_buffer b = jsonpg_buffer_new(0);
+        jsonpg_generator g = b ? jsonpg_buffer_printer(b, 0, 0) : NULL;
+        size_t length = strlen(json);
+        uint8_t bytes[length + 1];
+        memcpy(bytes, json, length + 1);
+        int ok = p && g
+                && JSONPG_EOF == jsonpg_parse(p, bytes, length, g)
+                && 0 == strcmp(jsonpg_buffer_string(b), expected);
+        jsonpg_generator_free(g);
+        jsonpg_buffer_free(b);
+        jsonpg_parser_free(p);
+        return check(name, ok);
+}
+
+static jsonpg_generator lines_generator(void *ctx, int worker)
+{
+        (void)worker;
+        return ctx;
+}
+
+// Records print one per line, one an error left open too
+static int check_lines_printed()
+{
+        char json[] = "{\"a\":1}\n[2]\n\n{\"b\":\n3\n\"x\"\n";
+        FILE *fh = tmpfile();
+        jsonpg_generator g = fh ? jsonpg_file_printer(fileno(fh), 0, 0) : NULL;
+        jsonpg_lines_config c = {
+                .threads = 1,
+                .ordered = 1,
+                .generator = lines_generator,
+                .ctx = g
+        };
+        int ok = g && 0 == jsonpg_parse_lines((uint8_t *)json, strlen(json), &c);
+
+        // Read before freeing the printer as that would flush it
+        char printed[sizeof(json)] = { 0 };
+        if(ok)
+                ok = 0 <= pread(fileno(fh), printed, sizeof(printed) - 1, 0)
+                        && 0 == strcmp(printed, json);
+        jsonpg_generator_free(g);
+        if(fh)
+                fclose(fh);
+        return check("lines printed a record per line", ok);
+}
+
+static int checks()
+{
+        int failed = 0;
+        failed += check_printed("bytes before an escape are kept", 0,
+                        "[\"ab\\tcd\", \"\\\"x\"]", "[\"ab\\tcd\",\"\\\"x\"]");
+        failed += check_printed("unquoted strings keep their first byte",
+                        JSONPG_FLAG_UNQUOTED_STRINGS | JSONPG_FLAG_UNQUOTED_KEYS,
+                        "{abc : xyz }", "{\"abc\":\"xyz\"}");
+        failed += check_printed("empty containers may hold whitespace", 0,
+                        "[ [ ], { }, [\n], {\t} ]", "[[],{},[],{}]");
+        failed += check_printed("and with the structural index",
+                        JSONPG_FLAG_STRUCTURAL_INDEX,
+                        "[ [ ], { }, [\n], {\t} ]", "[[],{},[],{}]");
+        failed += check_lines_printed();
+        return failed;
+}
+
 jsonpg_parser pp;
 
 int main(int argc, char *argv[])
 {
+        if(argc == 2 && 0 == strcmp("-c", argv[1]))
+                return checks();
+
         //jsonpg_set_allocator(talloc, tfree);
 
         jsonpg_config c = jsonpg_config_get();
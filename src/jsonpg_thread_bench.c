@@ -0,0 +1,180 @@
+/*
+ * jsonpg_thread_bench.c
+ *   independent parsers and printers on many threads at once
+ *
+ *   gcc -O2 -march=native -pthread -o jsonpg_thread_bench jsonpg_thread_bench.c
+ *
+ *   jsonpg_thread_bench <json file> [times]
+ *      each of 1, 2, 4... threads up to the number of online CPUs
+ *      makes its own parser and parses the file the given times, then
+ *      parses it into a buffer printer and checks the output matches
+ *      the one printed before any thread started, reporting MB/s over
+ *      all threads and the speedup on one thread
+ *
+ *   nothing is shared but the input and the default config, so the
+ *   speedup should follow the number of cores
+ */
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "jsonpg.c"
+
+typedef struct {
+        pthread_t thread;
+        uint8_t *json;
+        size_t length;
+        char *expected;         // NULL to only parse
+        int times;
+        int failed;
+} worker;
+
+static double seconds()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Returns the printed document, NULL on an error
+static char *print(jsonpg_parser p, uint8_t *json, size_t length)
+{
+        jsonpg_buffer b = jsonpg_buffer_new(0);
+        jsonpg_generator g = jsonpg_buffer_printer(b, 0, 0);
+        char *printed = NULL;
+        if(g && JSONPG_ERROR != jsonpg_parse(p, json, length, g))
+                printed = strdup(jsonpg_buffer_string(b));
+        jsonpg_generator_free(g);
+        jsonpg_buffer_free(b);
+        return printed;
+}
+
+// Pulls every event, returns JSONPG_EOF or JSONPG_ERROR
+static jsonpg_type parse_all(jsonpg_parser p, uint8_t *json, size_t length)
+{
+        jsonpg_type type = jsonpg_parse(p, json, length, NULL);
+        while(type != JSONPG_EOF && type != JSONPG_ERROR)
+                type = jsonpg_parse_next(p);
+        return type;
+}
+
+static void *work(void *arg)
+{
+        worker *w = arg;
+        jsonpg_parser p = jsonpg_parser_new(NULL);
+        if(!p) {
+                w->failed = w->times;
+                return NULL;
+        }
+
+        for(int i = 0 ; i < w->times ; i++) {
+                if(!w->expected) {
+                        if(JSONPG_ERROR == parse_all(p, w->json, w->length))
+                                w->failed++;
+                        continue;
+                }
+                char *printed = print(p, w->json, w->length);
+                if(!printed || strcmp(printed, w->expected))
+                        w->failed++;
+                free(printed);
+        }
+        jsonpg_parser_free(p);
+        return NULL;
+}
+
+// Returns MB/s over all threads or -1 on an error
+static double run(int threads, uint8_t *json, size_t length, char *expected,
+                int times, int *failed)
+{
+        worker workers[threads];
+        *failed = 0;
+        double start = seconds();
+        int started;
+        for(started = 0 ; started < threads ; started++) {
+                worker *w = &workers[started];
+                *w = (worker) {
+                        .json = json,
+                        .length = length,
+                        .expected = expected,
+                        .times = times,
+                        .failed = 0
+                };
+                if(pthread_create(&w->thread, NULL, work, w))
+                        break;
+        }
+        // Those started use workers so are joined before returning
+        for(int i = 0 ; i < started ; i++) {
+                pthread_join(workers[i].thread, NULL);
+                *failed += workers[i].failed;
+        }
+        if(started < threads)
+                return -1;
+        return (double)length * times * threads / (seconds() - start) / 1e6;
+}
+
+static void report(char *name, int threads, uint8_t *json, size_t length,
+                char *expected, int times, double *single)
+{
+        int failed;
+        double rate = run(threads, json, length, expected, times, &failed);
+        if(threads == 1)
+                *single = rate;
+        printf("%-6s %3d threads %8.1f MB/s %5.2fx", name, threads, rate,
+                        (*single > 0) ? rate / *single : 0);
+        if(rate < 0 || failed)
+                printf(" %d failed", failed);
+        printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+        if(argc != 2 && argc != 3) {
+                printf("Usage: jsonpg_thread_bench <json file> [times]\n");
+                exit(1);
+        }
+        int times = (argc == 3) ? atoi(argv[2]) : 10;
+
+        int fd = open(argv[1], O_RDONLY);
+        struct stat st;
+        if(fd == -1 || fstat(fd, &st) == -1 || st.st_size == 0) {
+                perror("Failed to open file");
+                exit(1);
+        }
+        uint8_t *json = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(json == MAP_FAILED) {
+                perror("Failed to map file");
+                exit(1);
+        }
+        close(fd);
+
+        jsonpg_parser p = jsonpg_parser_new(NULL);
+        char *expected = p ? print(p, json, st.st_size) : NULL;
+        jsonpg_parser_free(p);
+        if(!expected) {
+                printf("Failed to print file\n");
+                exit(1);
+        }
+
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if(cpus < 1)
+                cpus = 1;
+        printf("%s: %zu bytes, %ld CPUs\n", argv[1], (size_t)st.st_size, cpus);
+        double parse_single = 0;
+        double print_single = 0;
+        for(int threads = 1 ; ; threads *= 2) {
+                if(threads > cpus)
+                        threads = cpus;
+                report("parse", threads, json, st.st_size, NULL, times,
+                                &parse_single);
+                report("print", threads, json, st.st_size, expected, times,
+                                &print_single);
+                if(threads == cpus)
+                        break;
+        }
+
+        free(expected);
+        munmap(json, st.st_size);
+}
@@ -0,0 +1,427 @@
+/*
+ * jsonpg_validate.c
+ *   validation of a large document held in memory by a pool of threads
+ *
+ *   the whole parser cannot be run from the middle of a document, its
+ *   state includes the stack, but the part that decides where strings
+ *   are is a two state automaton, in or out of a string, that can be
+ *   run from both states at once. Backslashes outside strings are not
+ *   JSON so a backslash leaves only the run inside a string, and one
+ *   before the chunk is found by looking back
+ *
+ *   1. each chunk is run from both states, for each noting the state
+ *      at the end, the containers closed that were opened before the
+ *      chunk, those still open at the end and the first byte of { } [
+ *      ] , or : outside a string
+ *
+ *   2. in order, the state and stack at the start of each chunk follow
+ *      from those of the last, too many containers closed or open end
+ *      it there, the parser will find the underflow or overflow
+ *
+ *   3. from the first structural byte in a chunk the parser state is
+ *      known from that byte and the stack, each chunk is parsed from
+ *      there to the same byte in the next chunk that has one
+ *
+ *   the error reported is from the first part to fail, all parts before
+ *   it passed so it started as jsonpg_parse() would have been there
+ *
+ *   uses POSIX threads, link with -pthread
+ */
+#include <pthread.h>
+#include <unistd.h>
+
+enum {
+        LEX_OUT,
+        LEX_STRING,
+        LEX_RUNS
+};
+
+// A run through a chunk from one state
+struct lex_run_s {
+        int alive;              // no backslash outside a string
+        int state;              // at the end
+        size_t closes;          // containers closed opened before the chunk
+        struct stack_s opens;   // containers open at the end
+        int overflow;           // more open than the stack holds
+        uint8_t *structural;    // first { } [ ] , : outside a string
+};
+
+struct vchunk_s {
+        uint8_t *start;
+        uint8_t *end;
+        struct lex_run_s runs[LEX_RUNS];
+        struct stack_s stack;   // at the start
+        uint8_t *from;          // phase 3 parses [from, to)
+        uint8_t *to;
+        int ok;
+        jsonpg_value result;
+};
+
+struct validate_s {
+        uint8_t *input;
+        size_t length;
+        jsonpg_config config;
+        struct vchunk_s *chunks;
+        size_t count;
+        size_t next;            // next chunk to claim
+        size_t failed;          // first part found to fail, count if none
+        void (*work)(struct validate_s *, jsonpg_parser, struct vchunk_s *);
+        pthread_mutex_t lock;
+};
+
+// Bytes that can change the lexical state or the stack
+static const uint8_t lex_class[256] = {
+        ['"'] = 1, ['\\'] = 1, ['{'] = 1, ['}'] = 1,
+        ['['] = 1, [']'] = 1, [','] = 1, [':'] = 1
+};
+
+static void lex_run_byte(struct lex_run_s *run, uint8_t *pos)
+{
+        if(!run->structural)
+                run->structural = pos;
+        switch(*pos) {
+        case '{':
+        case '[':
+                if(run->overflow || push_stack(&run->opens,
+                                (*pos == '[') ? STACK_ARRAY : STACK_OBJECT))
+                        run->overflow = 1;
+                break;
+        case '}':
+        case ']':
+                // Types are checked by the parser
+                if(run->overflow || -1 == pop_stack(&run->opens))
+                        run->closes += !run->overflow;
+                break;
+        }
+}
+
+// Phase 1, runs the chunk from both states in one pass
+static void lex_chunk(struct validate_s *s, jsonpg_parser p, struct vchunk_s *c)
+{
+        (void)p;        // lexing needs no parser, only phase 2 does
+        struct lex_run_s *runs = c->runs;
+        for(int i = 0 ; i < LEX_RUNS ; i++) {
+                runs[i].alive = 1;
+                runs[i].closes = 0;
+                runs[i].opens.ptr = 0;
+                runs[i].opens.ptr_min = 0;
+                runs[i].overflow = 0;
+                runs[i].structural = NULL;
+        }
+
+        uint8_t *pos = c->start;
+
+        // A backslash before the chunk, only in a string, escapes the first byte
+        uint8_t *b = pos;
+        while(b > s->input && b[-1] == '\\')
+                b--;
+        if((pos - b) & 1) {
+                runs[LEX_OUT].alive = 0;
+                pos++;
+        }
+
+        int in_string = 0;      // the run from LEX_OUT, the other is opposite
+        while(pos < c->end) {
+                while(pos < c->end && !lex_class[*pos])
+                        pos++;
+                if(pos == c->end)
+                        break;
+
+                struct lex_run_s *out = &runs[in_string ? LEX_STRING : LEX_OUT];
+                switch(*pos) {
+                case '"':
+                        in_string = !in_string;
+                        break;
+                case '\\':
+                        out->alive = 0;
+                        pos++;
+                        break;
+                default:
+                        if(out->alive)
+                                lex_run_byte(out, pos);
+                }
+                pos++;
+        }
+
+        runs[LEX_OUT].state = in_string ? LEX_STRING : LEX_OUT;
+        runs[LEX_STRING].state = in_string ? LEX_OUT : LEX_STRING;
+}
+
+/*
+ * Phase 2, the stack at the start of each chunk from the runs taken
+ * through those before it
+ *
+ * Returns the number of chunks with the stack known
+ */
+static size_t lex_compose(struct validate_s *s, jsonpg_parser p)
+{
+        struct stack_s stack = p->stack;
+        int state = LEX_OUT;
+        size_t i;
+        for(i = 0 ; i < s->count ; i++) {
+                struct vchunk_s *c = &s->chunks[i];
+                memcpy(c->stack.stack, stack.stack, (stack.size + 7) / 8);
+                c->stack.ptr = stack.ptr;
+
+                struct lex_run_s *run = &c->runs[state];
+                if(i)
+                        c->from = run->structural;
+                if(!run->alive || run->overflow
+                                || run->closes > (size_t)(stack.ptr - stack.ptr_min)
+                                || stack.ptr - run->closes + run->opens.ptr > stack.size)
+                        return i + 1;
+
+                stack.ptr -= run->closes;
+                for(uint16_t j = 0 ; j < run->opens.ptr ; j++) {
+                        struct stack_s bit = run->opens;
+                        bit.ptr = j + 1;
+                        push_stack(&stack, peek_stack(&bit));
+                }
+                state = run->state;
+        }
+        return i;
+}
+
+/*
+ * Sets up p to parse on from just after the structural byte at pos
+ * with the stack before it
+ */
+static int validate_resume(jsonpg_parser p, uint8_t *pos, struct stack_s *stack)
+{
+        memcpy(p->stack.stack, stack->stack, (stack->size + 7) / 8);
+        p->stack.ptr = stack->ptr;
+
+        switch(*pos) {
+        case '{':
+        case '[':
+                if(push_stack(&p->stack, (*pos == '[') ? STACK_ARRAY : STACK_OBJECT))
+                        return -1;
+                p->push_state = state_w_value_or_close;
+                break;
+        case '}':
+        case ']':
+                if(pop_stack(&p->stack))
+                        return -1;
+                p->push_state = (p->stack.ptr > 0)
+                        ? state_w_after_value
+                        : state_error;
+                break;
+        case ',':
+                p->push_state = (p->flags & JSONPG_FLAG_TRAILING_COMMAS)
+                        ? state_w_value_or_close
+                        : (peek_stack(&p->stack) == STACK_OBJECT)
+                                ? state_w_key
+                                : state_w_value;
+                break;
+        case ':':
+                p->push_state = state_w_value;
+                break;
+        }
+        p->state = state_whitespace;
+        p->current = pos + 1;
+        return 0;
+}
+
+// Phase 3, parses from the chunk's first structural byte to the next
+static void validate_chunk(struct validate_s *s, jsonpg_parser p, struct vchunk_s *c)
+{
+        jsonpg_parse(p, s->input, s->length, NULL);
+        p->use_index = 0;
+
+        // The first chunk starts at the start
+        if(c != s->chunks && validate_resume(p, c->from, &c->stack)) {
+                // The part before fails here first
+                c->ok = 0;
+                c->result.error.code = JSONPG_ERROR_PARSE;
+                c->result.error.at = c->from - s->input;
+                return;
+        }
+        if(c->to < s->input + s->length) {
+                p->last = c->to;
+                p->seen_eof = 0;
+                p->no_refill = 1;
+        }
+
+        jsonpg_type type;
+        do {
+                type = jsonpg_parse_next(p);
+        } while(type != JSONPG_NONE && type != JSONPG_EOF && type != JSONPG_ERROR);
+        p->no_refill = 0;
+
+        c->ok = (type != JSONPG_ERROR);
+        c->result = p->result;
+        if(!c->ok) {
+                pthread_mutex_lock(&s->lock);
+                if(s->failed > (size_t)(c - s->chunks))
+                        s->failed = c - s->chunks;
+                pthread_mutex_unlock(&s->lock);
+        }
+}
+
+/*
+ * Claims the next chunk, none after a part that failed as only the
+ * first error is reported
+ *
+ * Returns its index or count when there are none left
+ */
+static size_t validate_claim(struct validate_s *s)
+{
+        pthread_mutex_lock(&s->lock);
+        size_t i = s->next++;
+        if(i > s->failed)
+                i = s->count;
+        pthread_mutex_unlock(&s->lock);
+        return (i < s->count) ? i : s->count;
+}
+
+static void *validate_worker(void *arg)
+{
+        struct validate_s *s = arg;
+        jsonpg_parser p = jsonpg_parser_new(&s->config);
+
+        // Without a parser leave the chunks to the others
+        size_t i;
+        while(p && (i = validate_claim(s)) < s->count)
+                s->work(s, p, &s->chunks[i]);
+
+        jsonpg_parser_free(p);
+        return NULL;
+}
+
+// Runs work on every chunk with threads threads, including this one
+static void validate_phase(struct validate_s *s, jsonpg_parser p, int threads,
+                pthread_t *workers,
+                void (*work)(struct validate_s *, jsonpg_parser, struct vchunk_s *))
+{
+        s->next = 0;
+        s->failed = s->count;
+        s->work = work;
+
+        int started;
+        for(started = 1 ; started < threads ; started++)
+                if(pthread_create(&workers[started], NULL, validate_worker, s))
+                        break;
+
+        size_t i;
+        while((i = validate_claim(s)) < s->count)
+                work(s, p, &s->chunks[i]);
+
+        for(int i = 1 ; i < started ; i++)
+                pthread_join(workers[i], NULL);
+}
+
+static jsonpg_type validate(jsonpg_parser p, uint8_t *json, size_t length)
+{
+        jsonpg_type type = jsonpg_parse(p, json, length, NULL);
+        while(type != JSONPG_EOF && type != JSONPG_ERROR)
+                type = jsonpg_parse_next(p);
+        return type;
+}
+
+/*
+ * Validates a document held in memory with threads threads, one per
+ * online CPU if 0
+ *
+ * Uses jsonpg_parse() for input too small to share out or for a parser
+ * with flags other than trailing_commas, is_object or is_array
+ *
+ * Returns JSONPG_EOF if it is valid or JSONPG_ERROR with the error, as
+ * jsonpg_parse() would find it, in jsonpg_result(p)
+ */
+jsonpg_type jsonpg_validate_parallel(
+                jsonpg_parser p,
+                uint8_t *json,
+                size_t length,
+                int threads)
+{
+        if(threads <= 0)
+                threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+        size_t size = length / ((size_t)threads * PARALLEL_CHUNKS);
+        if(size < PARALLEL_CHUNK_MIN)
+                size = PARALLEL_CHUNK_MIN;
+        if(threads <= 1 || length < 2 * size
+                        || (p->flags & config_all & ~JSONPG_FLAG_TRAILING_COMMAS)
+                        || (p->flags & JSONPG_FLAG_DOCUMENT_SEQUENCE))
+                return validate(p, json, length);
+
+        // Phase 2 and 3 need parsers like p, from the start
+        struct validate_s s = {
+                .input = json,
+                .length = length,
+                .config = {
+                        .stack_size = p->stack.size,
+                        .buffer_size = p->buffer_size,
+                        .flags = p->flags
+                },
+                .count = length / size
+        };
+        jsonpg_parse(p, json, length, NULL);
+
+        size_t stack_bytes = (p->stack.size + 7) / 8;
+        s.chunks = al_alloc(p->allocator, s.count * sizeof(struct vchunk_s));
+        uint8_t *stacks = al_alloc(p->allocator,
+                        s.count * (LEX_RUNS + 1) * stack_bytes + 1);
+        pthread_t *workers = al_alloc(p->allocator, threads * sizeof(pthread_t));
+        if(!s.chunks || !stacks || !workers) {
+                al_dealloc(p->allocator, s.chunks);
+                al_dealloc(p->allocator, stacks);
+                al_dealloc(p->allocator, workers);
+                return alloc_error(p);
+        }
+        pthread_mutex_init(&s.lock, NULL);
+
+        uint8_t *bits = stacks;
+        for(size_t i = 0 ; i < s.count ; i++) {
+                struct vchunk_s *c = &s.chunks[i];
+                c->start = json + i * size;
+                c->end = (i + 1 < s.count) ? c->start + size : json + length;
+                c->from = NULL;
+                c->ok = 1;
+                for(int j = 0 ; j < LEX_RUNS ; j++, bits += stack_bytes) {
+                        c->runs[j].opens.stack = bits;
+                        c->runs[j].opens.size = p->stack.size;
+                }
+                c->stack.stack = bits;
+                c->stack.size = p->stack.size;
+                c->stack.ptr_min = p->stack.ptr_min;
+                bits += stack_bytes;
+        }
+        s.chunks[0].from = json;
+
+        validate_phase(&s, p, threads, workers, lex_chunk);
+        size_t known = lex_compose(&s, p);
+
+        // Chunks without a structural byte are parsed with those before
+        size_t parts = 0;
+        for(size_t i = 0 ; i < known ; i++) {
+                if(!s.chunks[i].from)
+                        continue;
+                if(parts)
+                        s.chunks[parts - 1].to = s.chunks[i].from + 1;
+                s.chunks[parts] = s.chunks[i];
+                s.chunks[parts].to = json + length;
+                parts++;
+        }
+        size_t count = s.count;
+        s.count = parts;
+        validate_phase(&s, p, threads, workers, validate_chunk);
+
+        jsonpg_type type = JSONPG_EOF;
+        for(size_t i = 0 ; i < s.count ; i++) {
+                if(!s.chunks[i].ok) {
+                        p->result = s.chunks[i].result;
+                        type = JSONPG_ERROR;
+                        break;
+                }
+        }
+        // Phase 2 stopped early but every part passed, not expected
+        if(type == JSONPG_EOF && known < count)
+                type = validate(p, json, length);
+
+        pthread_mutex_destroy(&s.lock);
+        al_dealloc(p->allocator, workers);
+        al_dealloc(p->allocator, stacks);
+        al_dealloc(p->allocator, s.chunks);
+        return type;
+}